@@ -0,0 +1,156 @@
+/**
+ * @file SortedArraysBench.cpp
+ * @author Santhosh Ranganathan
+ * @brief Microbenchmarks for the SortedArrays class.
+ *
+ * @details This file times the operations of the SortedArrays class on arrays
+ * shaped like the array containers of a Bitmap, which hold at most 4096
+ * values, for size ratios from 1:1 to 1:4096. Intersection is timed by
+ * merging, with SSE4.2 string instructions and by galloping, and union and
+ * difference are timed by merging with the standard library, each along with
+ * the algorithm chosen by SortedArrays, so that the ratio above which
+ * galloping is used can be checked on a machine. Built with "make bench" and
+ * run as ./bench.out.
+ */
+
+#include "../src/SortedArrays.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TaggableFS;
+
+/** Number of values in the larger array of each benchmark, the most an array container holds. */
+#define TFS_BENCH_LARGE_SIZE 4096
+
+/** Minimum time in nanoseconds each algorithm is run for at each ratio. */
+#define TFS_BENCH_MIN_TIME 200000000
+
+/**
+ * Makes a sorted array of unique random 16-bit values.
+ *
+ * @param size number of values.
+ * @param generator random number generator.
+ * @return Sorted array.
+ */
+std::vector<uint16_t> makeArray(std::size_t size, std::mt19937 &generator)
+{
+    std::vector<uint16_t> all(65536);
+    for (std::size_t i = 0; i < all.size(); i++)
+    {
+        all[i] = i;
+    }
+    std::shuffle(all.begin(), all.end(), generator);
+    std::vector<uint16_t> values(all.begin(), all.begin() + size);
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+/**
+ * Times an operation until the minimum time has passed.
+ *
+ * @param operation operation to be timed, returning the size of the result.
+ * @param size size of the result, set from the last run.
+ * @return Average time of an operation in nanoseconds.
+ */
+template <typename Operation>
+double timeOperation(Operation operation, std::size_t &size)
+{
+    uint64_t runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds elapsed(0);
+    do
+    {
+        for (int i = 0; i < 16; i++, runs++)
+        {
+            size = operation();
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed.count() < TFS_BENCH_MIN_TIME);
+    return double(elapsed.count()) / runs;
+}
+
+/**
+ * Runs the benchmarks and prints the average time of each algorithm at each size ratio.
+ *
+ * @return 0 if all algorithms agreed on the results, else 1.
+ */
+int main()
+{
+    std::mt19937 generator(42);
+    std::vector<uint16_t> large = makeArray(TFS_BENCH_LARGE_SIZE, generator);
+    std::vector<uint16_t> result(2 * TFS_BENCH_LARGE_SIZE + 8);
+    const std::size_t ratios[] = {1, 4, 16, 64, 256, 1024, 4096};
+    const char *names[] = {"merge", "sse4.2", "gallop"};
+    int returnValue = 0;
+    std::printf("intersect\n%-8s %8s %8s %12s %12s %12s %12s\n", "ratio", "small", "matches",
+        "merge ns", "sse4.2 ns", "gallop ns", "chosen ns");
+    for (std::size_t ratio : ratios)
+    {
+        std::vector<uint16_t> small = makeArray(TFS_BENCH_LARGE_SIZE / ratio, generator);
+        double times[3] = {0, 0, 0};
+        std::size_t sizes[3] = {0, 0, 0};
+        for (int algorithm = 0; algorithm < 3; algorithm++)
+        {
+            SortedArrays::Algorithm chosen = SortedArrays::Algorithm(algorithm);
+            if (SortedArrays::isSupported(chosen) == false)
+            {
+                std::fprintf(stderr, "%s isn't supported, timing merge instead\n",
+                    names[algorithm]);
+            }
+            times[algorithm] = timeOperation([&]() {
+                return SortedArrays::intersect(chosen, small.data(), small.size(),
+                    large.data(), large.size(), result.data());
+            }, sizes[algorithm]);
+        }
+        std::size_t size = 0;
+        double chosenTime = timeOperation([&]() {
+            return SortedArrays::intersect(small.data(), small.size(), large.data(),
+                large.size(), result.data());
+        }, size);
+        if (sizes[0] != size || sizes[1] != size || sizes[2] != size)
+        {
+            std::fprintf(stderr, "intersections differ at 1:%zu\n", ratio);
+            returnValue = 1;
+        }
+        std::printf("1:%-6zu %8zu %8zu %12.0f %12.0f %12.0f %12.0f\n", ratio, small.size(), size,
+            times[0], times[1], times[2], chosenTime);
+    }
+    // union and both differences, small minus large and large minus small
+    const char *operations[] = {"unite", "subtract small", "subtract large"};
+    for (int operation = 0; operation < 3; operation++)
+    {
+        std::printf("%s\n%-8s %8s %8s %12s %12s\n", operations[operation], "ratio", "small",
+            "results", "merge ns", "chosen ns");
+        for (std::size_t ratio : ratios)
+        {
+            std::vector<uint16_t> small = makeArray(TFS_BENCH_LARGE_SIZE / ratio, generator);
+            const std::vector<uint16_t> &a = (operation == 2) ? large : small;
+            const std::vector<uint16_t> &b = (operation == 2) ? small : large;
+            std::size_t mergeSize = 0, size = 0;
+            double mergeTime = timeOperation([&]() {
+                return std::size_t(((operation == 0)
+                    ? std::set_union(a.begin(), a.end(), b.begin(), b.end(), result.begin())
+                    : std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
+                        result.begin())) - result.begin());
+            }, mergeSize);
+            double chosenTime = timeOperation([&]() {
+                return (operation == 0)
+                    ? SortedArrays::unite(a.data(), a.size(), b.data(), b.size(), result.data())
+                    : SortedArrays::subtract(a.data(), a.size(), b.data(), b.size(),
+                        result.data());
+            }, size);
+            if (mergeSize != size)
+            {
+                std::fprintf(stderr, "%s results differ at 1:%zu\n", operations[operation],
+                    ratio);
+                returnValue = 1;
+            }
+            std::printf("1:%-6zu %8zu %8zu %12.0f %12.0f\n", ratio, small.size(), size,
+                mergeTime, chosenTime);
+        }
+    }
+    return returnValue;
+}
@@ -8,6 +8,11 @@ echo
 echo -e '\e[35mOptions\e[0m'
 echo -e '   --log           enable logging'
 echo -e '   --tag-view      open filesystem in read-only tag view mode'
+echo -e '   --memory-budget MEGABYTES'
+echo -e '                   keep catalog on disk within the given memory budget'
+echo -e '   --hash ALGORITHM'
+echo -e '                   hash naming files of a new root (md5, sha256, blake2b, blake2s)'
+echo -e '   --chunking      store large files in content-defined chunks'
 echo
 echo -e '\e[35mRunning make\e[0m'
 make tfs.out
@@ -17,10 +22,8 @@ echo 'mkdir TFSmount TFSroot'
 mkdir TFSmount TFSroot
 echo
 echo -e '\e[35mRunning TaggableFS\e[0m'
-first=${1:-}
-second=${2:-}
-echo "./tfs.out --init TFSmount TFSroot $first $second"
-./tfs.out --init TFSmount TFSroot $first $second
+echo "./tfs.out --init TFSmount TFSroot $@"
+./tfs.out --init TFSmount TFSroot "$@"
 echo
 echo 'If successful, use TFSmount folder to access the mounted filesystem.'
 read -n 1 -s -r -p 'Press any key to shutdown TaggableFS...'
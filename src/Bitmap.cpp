@@ -0,0 +1,925 @@
+/**
+ * @file Bitmap.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the Bitmap class.
+ *
+ * @details This file contains the method definitions for the Bitmap class.
+ * Based on the description of Roaring bitmaps at https://roaringbitmap.org/.
+ */
+
+#include "Bitmap.hpp"
+#include "SortedArrays.hpp"
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+/** Maximum number of values in a container stored as a sorted array. */
+#define TFS_BITMAP_ARRAY_MAX 4096
+
+/** Number of 64-bit words in a container stored as a bitset. */
+#define TFS_BITMAP_WORDS 1024
+
+namespace TaggableFS
+{
+
+/**
+ * Finds the position of the container with the given key or where it would be inserted.
+ *
+ * @param key upper 16 bits of the values stored in the container.
+ * @return Index of the first container whose key is not less than the given key.
+ */
+std::size_t Bitmap::findContainer(uint16_t key) const
+{
+    auto result = std::lower_bound(containers.begin(), containers.end(), key,
+        [](const Container &container, uint16_t key) { return container.key < key; });
+    return result - containers.begin();
+}
+
+/**
+ * Checks if the given container stores its values as a bitset.
+ *
+ * @param container container to be checked.
+ * @return Boolean indicating if the container is a bitset or a sorted array.
+ */
+bool Bitmap::isBitset(const Container &container)
+{
+    return !container.words.empty();
+}
+
+/**
+ * Converts the given container from a sorted array to a bitset.
+ *
+ * @param container container to be converted.
+ */
+void Bitmap::toBitset(Container &container)
+{
+    container.words.assign(TFS_BITMAP_WORDS, 0);
+    for (auto low : container.values)
+    {
+        container.words[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    std::vector<uint16_t>().swap(container.values);
+}
+
+/**
+ * Converts the given container from a bitset to a sorted array.
+ *
+ * @param container container to be converted.
+ */
+void Bitmap::toArray(Container &container)
+{
+    container.values.clear();
+    container.values.reserve(container.cardinality);
+    for (uint32_t i = 0; i < TFS_BITMAP_WORDS; i++)
+    {
+        uint64_t word = container.words[i];
+        while (word != 0)
+        {
+            container.values.push_back((i << 6) | __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    std::vector<uint64_t>().swap(container.words);
+}
+
+/**
+ * Converts the given container to the representation suited to its cardinality.
+ *
+ * @param container container to be converted if needed.
+ */
+void Bitmap::optimize(Container &container)
+{
+    if (isBitset(container) && container.cardinality <= TFS_BITMAP_ARRAY_MAX)
+    {
+        toArray(container);
+    }
+    else if (!isBitset(container) && container.cardinality > TFS_BITMAP_ARRAY_MAX)
+    {
+        toBitset(container);
+    }
+}
+
+/**
+ * Checks if the given container stores the given lower 16 bits.
+ *
+ * @param container container to be checked.
+ * @param low lower 16 bits of the value.
+ * @return Boolean indicating if the value is stored in the container.
+ */
+bool Bitmap::containerContains(const Container &container, uint16_t low)
+{
+    if (isBitset(container))
+    {
+        return (container.words[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(container.values.begin(), container.values.end(), low);
+}
+
+/**
+ * Intersects two containers with the same key.
+ *
+ * @param a first container.
+ * @param b second container.
+ * @return Container storing the values found in both containers.
+ */
+Bitmap::Container Bitmap::intersectContainers(const Container &a, const Container &b)
+{
+    Container result = {a.key, 0, {}, {}};
+    if (isBitset(a) && isBitset(b))
+    {
+        result.words.resize(TFS_BITMAP_WORDS);
+        for (auto i = 0; i < TFS_BITMAP_WORDS; i++)
+        {
+            result.words[i] = a.words[i] & b.words[i];
+            result.cardinality += __builtin_popcountll(result.words[i]);
+        }
+        optimize(result);
+    }
+    else if (isBitset(a) || isBitset(b))
+    {
+        const Container &array = isBitset(a) ? b : a;
+        const Container &bitset = isBitset(a) ? a : b;
+        for (auto low : array.values)
+        {
+            if (containerContains(bitset, low))
+            {
+                result.values.push_back(low);
+            }
+        }
+        result.cardinality = result.values.size();
+    }
+    else
+    {
+        result.values.resize(std::min(a.values.size(), b.values.size()) + 8);
+        result.values.resize(SortedArrays::intersect(a.values.data(), a.values.size(),
+            b.values.data(), b.values.size(), result.values.data()));
+        result.values.shrink_to_fit(); // room for the larger result and 8 values is released
+        result.cardinality = result.values.size();
+    }
+    return result;
+}
+
+/**
+ * Counts the values found in both of two containers with the same key without storing them.
+ *
+ * @param a first container.
+ * @param b second container.
+ * @return Number of values found in both containers.
+ */
+uint32_t Bitmap::countIntersection(const Container &a, const Container &b)
+{
+    uint32_t count = 0;
+    if (isBitset(a) && isBitset(b))
+    {
+        for (auto i = 0; i < TFS_BITMAP_WORDS; i++)
+        {
+            count += __builtin_popcountll(a.words[i] & b.words[i]);
+        }
+    }
+    else if (isBitset(a) || isBitset(b))
+    {
+        const Container &array = isBitset(a) ? b : a;
+        const Container &bitset = isBitset(a) ? a : b;
+        for (auto low : array.values)
+        {
+            count += containerContains(bitset, low);
+        }
+    }
+    else
+    {
+        count = SortedArrays::countIntersection(a.values.data(), a.values.size(),
+            b.values.data(), b.values.size());
+    }
+    return count;
+}
+
+/**
+ * Unites two containers with the same key.
+ *
+ * @param a first container.
+ * @param b second container.
+ * @return Container storing the values found in either container.
+ */
+Bitmap::Container Bitmap::uniteContainers(const Container &a, const Container &b)
+{
+    Container result = {a.key, 0, {}, {}};
+    if (isBitset(a) && isBitset(b))
+    {
+        result.words.resize(TFS_BITMAP_WORDS);
+        for (auto i = 0; i < TFS_BITMAP_WORDS; i++)
+        {
+            result.words[i] = a.words[i] | b.words[i];
+            result.cardinality += __builtin_popcountll(result.words[i]);
+        }
+    }
+    else if (isBitset(a) || isBitset(b))
+    {
+        const Container &array = isBitset(a) ? b : a;
+        result = isBitset(a) ? a : b;
+        for (auto low : array.values)
+        {
+            uint64_t bit = uint64_t(1) << (low & 63);
+            if ((result.words[low >> 6] & bit) == 0)
+            {
+                result.words[low >> 6] |= bit;
+                result.cardinality++;
+            }
+        }
+    }
+    else
+    {
+        result.values.resize(a.values.size() + b.values.size() + 8);
+        result.values.resize(SortedArrays::unite(a.values.data(), a.values.size(),
+            b.values.data(), b.values.size(), result.values.data()));
+        result.values.shrink_to_fit();
+        result.cardinality = result.values.size();
+        optimize(result);
+    }
+    return result;
+}
+
+/**
+ * Subtracts the second container from the first container with the same key.
+ *
+ * @param a container from which values are removed.
+ * @param b container storing values to be removed.
+ * @return Container storing the values found in the first but not the second container.
+ */
+Bitmap::Container Bitmap::subtractContainers(const Container &a, const Container &b)
+{
+    Container result = {a.key, 0, {}, {}};
+    if (isBitset(a))
+    {
+        result = a;
+        if (isBitset(b))
+        {
+            result.cardinality = 0;
+            for (auto i = 0; i < TFS_BITMAP_WORDS; i++)
+            {
+                result.words[i] &= ~b.words[i];
+                result.cardinality += __builtin_popcountll(result.words[i]);
+            }
+        }
+        else
+        {
+            for (auto low : b.values)
+            {
+                uint64_t bit = uint64_t(1) << (low & 63);
+                if ((result.words[low >> 6] & bit) != 0)
+                {
+                    result.words[low >> 6] &= ~bit;
+                    result.cardinality--;
+                }
+            }
+        }
+        optimize(result);
+    }
+    else if (isBitset(b))
+    {
+        for (auto low : a.values)
+        {
+            if (!containerContains(b, low))
+            {
+                result.values.push_back(low);
+            }
+        }
+        result.cardinality = result.values.size();
+    }
+    else
+    {
+        result.values.resize(a.values.size() + 8);
+        result.values.resize(SortedArrays::subtract(a.values.data(), a.values.size(),
+            b.values.data(), b.values.size(), result.values.data()));
+        result.values.shrink_to_fit();
+        result.cardinality = result.values.size();
+    }
+    return result;
+}
+
+/**
+ * Adds the given value to the bitmap.
+ *
+ * @param value value to be added.
+ * @return Boolean indicating if the value was added or already present.
+ */
+bool Bitmap::add(uint32_t value)
+{
+    uint16_t key = value >> 16;
+    uint16_t low = value & 0xFFFF;
+    std::size_t i = findContainer(key);
+    if (i == containers.size() || containers[i].key != key)
+    {
+        containers.insert(containers.begin() + i, Container{key, 0, {}, {}});
+    }
+    Container &container = containers[i];
+    if (isBitset(container))
+    {
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if ((container.words[low >> 6] & bit) != 0)
+        {
+            return false;
+        }
+        container.words[low >> 6] |= bit;
+    }
+    else
+    {
+        auto result = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (result != container.values.end() && *result == low)
+        {
+            return false;
+        }
+        container.values.insert(result, low);
+    }
+    container.cardinality++;
+    optimize(container);
+    return true;
+}
+
+/**
+ * Removes the given value from the bitmap.
+ *
+ * @param value value to be removed.
+ * @return Boolean indicating if the value was removed or not present.
+ */
+bool Bitmap::remove(uint32_t value)
+{
+    uint16_t key = value >> 16;
+    uint16_t low = value & 0xFFFF;
+    std::size_t i = findContainer(key);
+    if (i == containers.size() || containers[i].key != key)
+    {
+        return false;
+    }
+    Container &container = containers[i];
+    if (isBitset(container))
+    {
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if ((container.words[low >> 6] & bit) == 0)
+        {
+            return false;
+        }
+        container.words[low >> 6] &= ~bit;
+    }
+    else
+    {
+        auto result = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (result == container.values.end() || *result != low)
+        {
+            return false;
+        }
+        container.values.erase(result);
+    }
+    container.cardinality--;
+    if (container.cardinality == 0)
+    {
+        containers.erase(containers.begin() + i);
+    }
+    else
+    {
+        optimize(container);
+    }
+    return true;
+}
+
+/**
+ * Checks if the given value is present in the bitmap.
+ *
+ * @param value value to be checked.
+ * @return Boolean indicating if the value is present.
+ */
+bool Bitmap::contains(uint32_t value) const
+{
+    uint16_t key = value >> 16;
+    std::size_t i = findContainer(key);
+    if (i == containers.size() || containers[i].key != key)
+    {
+        return false;
+    }
+    return containerContains(containers[i], value & 0xFFFF);
+}
+
+/**
+ * Checks if the bitmap is empty.
+ *
+ * @return Boolean indicating if the bitmap has no values.
+ */
+bool Bitmap::isEmpty() const
+{
+    return containers.empty();
+}
+
+/**
+ * Counts the values in the bitmap.
+ *
+ * @return Number of values in the bitmap.
+ */
+uint64_t Bitmap::cardinality() const
+{
+    uint64_t count = 0;
+    for (auto &container : containers)
+    {
+        count += container.cardinality;
+    }
+    return count;
+}
+
+/**
+ * Removes all values from the bitmap.
+ */
+void Bitmap::clear()
+{
+    containers.clear();
+}
+
+/**
+ * Gets the approximate number of bytes of memory used by the bitmap.
+ *
+ * @return Number of bytes used.
+ */
+std::size_t Bitmap::memoryUsage() const
+{
+    std::size_t bytes = sizeof(Bitmap) + containers.capacity() * sizeof(Container);
+    for (auto &container : containers)
+    {
+        bytes += container.values.capacity() * sizeof(uint16_t)
+            + container.words.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+/**
+ * Lists the values in the bitmap.
+ *
+ * @return Vector containing the values in ascending order.
+ */
+std::vector<uint32_t> Bitmap::toVector() const
+{
+    std::vector<uint32_t> values;
+    values.reserve(cardinality());
+    for (auto &container : containers)
+    {
+        uint32_t high = uint32_t(container.key) << 16;
+        if (isBitset(container))
+        {
+            for (uint32_t i = 0; i < TFS_BITMAP_WORDS; i++)
+            {
+                uint64_t word = container.words[i];
+                while (word != 0)
+                {
+                    values.push_back(high | (i << 6) | __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        }
+        else
+        {
+            for (auto low : container.values)
+            {
+                values.push_back(high | low);
+            }
+        }
+    }
+    return values;
+}
+
+/**
+ * Lists a page of the values in the bitmap without listing the values before it.
+ *
+ * @param first smallest value which may be listed.
+ * @param skip number of values not less than first to be skipped.
+ * @param limit maximum number of values to be listed.
+ * @return Vector containing the values in ascending order.
+ */
+std::vector<uint32_t> Bitmap::toVector(uint64_t first, uint64_t skip, std::size_t limit) const
+{
+    std::vector<uint32_t> values;
+    if (first > UINT32_MAX)
+    {
+        return values;
+    }
+    uint16_t firstKey = first >> 16;
+    for (std::size_t c = findContainer(firstKey); c < containers.size() && values.size() < limit;
+        c++)
+    {
+        const Container &container = containers[c];
+        uint32_t high = uint32_t(container.key) << 16;
+        uint32_t start = (container.key == firstKey) ? (first & 0xFFFF) : 0;
+        if (start == 0 && skip >= container.cardinality) // skip whole container
+        {
+            skip -= container.cardinality;
+            continue;
+        }
+        if (isBitset(container))
+        {
+            for (uint32_t i = start >> 6; i < TFS_BITMAP_WORDS && values.size() < limit; i++)
+            {
+                uint64_t word = container.words[i];
+                if (i == (start >> 6))
+                {
+                    word &= ~uint64_t(0) << (start & 63);
+                }
+                for (; word != 0 && values.size() < limit; word &= word - 1)
+                {
+                    if (skip > 0)
+                    {
+                        skip--;
+                        continue;
+                    }
+                    values.push_back(high | (i << 6) | __builtin_ctzll(word));
+                }
+            }
+        }
+        else
+        {
+            auto low = std::lower_bound(container.values.begin(), container.values.end(), start);
+            for (; low != container.values.end() && values.size() < limit; low++)
+            {
+                if (skip > 0)
+                {
+                    skip--;
+                    continue;
+                }
+                values.push_back(high | *low);
+            }
+        }
+    }
+    return values;
+}
+
+/**
+ * Serializes the bitmap into a string of bytes in host byte order to be stored in the
+ * database. Each container is stored as its key, cardinality, a byte indicating if it is
+ * a bitset and then its array or bitset.
+ *
+ * @return String containing the serialized bitmap.
+ */
+std::string Bitmap::serialize() const
+{
+    std::string data;
+    uint32_t numberOfContainers = containers.size();
+    data.append(reinterpret_cast<const char *>(&numberOfContainers), sizeof numberOfContainers);
+    for (auto &container : containers)
+    {
+        char bitset = isBitset(container) ? 1 : 0;
+        data.append(reinterpret_cast<const char *>(&container.key), sizeof container.key);
+        data.append(reinterpret_cast<const char *>(&container.cardinality),
+            sizeof container.cardinality);
+        data.append(1, bitset);
+        if (bitset == 1)
+        {
+            data.append(reinterpret_cast<const char *>(container.words.data()),
+                container.words.size() * sizeof(uint64_t));
+        }
+        else
+        {
+            data.append(reinterpret_cast<const char *>(container.values.data()),
+                container.values.size() * sizeof(uint16_t));
+        }
+    }
+    return data;
+}
+
+/**
+ * Replaces the contents of the bitmap with the bitmap serialized in the given string.
+ *
+ * @param data string containing the serialized bitmap.
+ * @return Boolean indicating if the string contained a valid bitmap, else bitmap is empty.
+ */
+bool Bitmap::deserialize(const std::string &data)
+{
+    containers.clear();
+    if (data.empty())
+    {
+        return true;
+    }
+    std::size_t position = 0;
+    auto read = [&](void *destination, std::size_t size)
+    {
+        if (position + size > data.size())
+        {
+            return false;
+        }
+        memcpy(destination, data.data() + position, size);
+        position += size;
+        return true;
+    };
+    uint32_t numberOfContainers = 0;
+    if (!read(&numberOfContainers, sizeof numberOfContainers))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < numberOfContainers; i++)
+    {
+        Container container = {0, 0, {}, {}};
+        char bitset = 0;
+        bool valid = read(&container.key, sizeof container.key)
+            && read(&container.cardinality, sizeof container.cardinality)
+            && read(&bitset, 1);
+        if (valid && bitset == 1)
+        {
+            container.words.resize(TFS_BITMAP_WORDS);
+            valid = read(container.words.data(), TFS_BITMAP_WORDS * sizeof(uint64_t));
+        }
+        else if (valid)
+        {
+            container.values.resize(container.cardinality);
+            valid = container.cardinality <= TFS_BITMAP_ARRAY_MAX
+                && read(container.values.data(), container.cardinality * sizeof(uint16_t));
+        }
+        if (!valid || container.cardinality == 0
+            || (!containers.empty() && containers.back().key >= container.key))
+        {
+            containers.clear();
+            return false;
+        }
+        containers.push_back(std::move(container));
+    }
+    return position == data.size();
+}
+
+/**
+ * Gets the number of containers of the bitmap, which bounds how finely it can be split.
+ *
+ * @return Number of containers.
+ */
+std::size_t Bitmap::numberOfContainers() const
+{
+    return containers.size();
+}
+
+/**
+ * Splits the range of keys into ranges holding similar numbers of the bitmap's containers.
+ *
+ * @param numberOfParts number of ranges wanted.
+ * @return Keys at which each range starts followed by the end of the last range, fewer ranges
+ * if the bitmap has fewer containers.
+ */
+std::vector<uint32_t> Bitmap::splitKeys(std::size_t numberOfParts) const
+{
+    numberOfParts = std::max(std::size_t(1), std::min(numberOfParts, containers.size()));
+    std::vector<uint32_t> keys = {0};
+    for (std::size_t i = 1; i < numberOfParts; i++)
+    {
+        keys.push_back(containers[i * containers.size() / numberOfParts].key);
+    }
+    keys.push_back(0x10000);
+    return keys;
+}
+
+/**
+ * Intersects two bitmaps (AND).
+ *
+ * @param a first bitmap.
+ * @param b second bitmap.
+ * @return Bitmap containing the values found in both bitmaps.
+ */
+Bitmap Bitmap::intersect(const Bitmap &a, const Bitmap &b)
+{
+    Bitmap result;
+    auto i = a.containers.begin(), j = b.containers.begin();
+    while (i != a.containers.end() && j != b.containers.end())
+    {
+        if (i->key < j->key)
+        {
+            i++;
+        }
+        else if (j->key < i->key)
+        {
+            j++;
+        }
+        else
+        {
+            Container container = intersectContainers(*i, *j);
+            if (container.cardinality != 0)
+            {
+                result.containers.push_back(std::move(container));
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+/**
+ * Counts the values found in both of two bitmaps without building their intersection.
+ *
+ * @param a first bitmap.
+ * @param b second bitmap.
+ * @return Number of values found in both bitmaps.
+ */
+uint64_t Bitmap::intersectionCardinality(const Bitmap &a, const Bitmap &b)
+{
+    uint64_t count = 0;
+    auto i = a.containers.begin(), j = b.containers.begin();
+    while (i != a.containers.end() && j != b.containers.end())
+    {
+        if (i->key < j->key)
+        {
+            i++;
+        }
+        else if (j->key < i->key)
+        {
+            j++;
+        }
+        else
+        {
+            count += countIntersection(*i, *j);
+            i++;
+            j++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Unites two bitmaps (OR).
+ *
+ * @param a first bitmap.
+ * @param b second bitmap.
+ * @return Bitmap containing the values found in either bitmap.
+ */
+Bitmap Bitmap::unite(const Bitmap &a, const Bitmap &b)
+{
+    Bitmap result;
+    result.containers.reserve(a.containers.size() + b.containers.size());
+    auto i = a.containers.begin(), j = b.containers.begin();
+    while (i != a.containers.end() || j != b.containers.end())
+    {
+        if (j == b.containers.end() || (i != a.containers.end() && i->key < j->key))
+        {
+            result.containers.push_back(*i++);
+        }
+        else if (i == a.containers.end() || j->key < i->key)
+        {
+            result.containers.push_back(*j++);
+        }
+        else
+        {
+            result.containers.push_back(uniteContainers(*i++, *j++));
+        }
+    }
+    return result;
+}
+
+/**
+ * Subtracts the second bitmap from the first bitmap (AND NOT).
+ *
+ * @param a bitmap from which values are removed.
+ * @param b bitmap containing values to be removed.
+ * @return Bitmap containing the values found in the first but not the second bitmap.
+ */
+Bitmap Bitmap::subtract(const Bitmap &a, const Bitmap &b)
+{
+    Bitmap result;
+    auto j = b.containers.begin();
+    for (auto &container : a.containers)
+    {
+        while (j != b.containers.end() && j->key < container.key)
+        {
+            j++;
+        }
+        if (j == b.containers.end() || j->key != container.key)
+        {
+            result.containers.push_back(container);
+            continue;
+        }
+        Container difference = subtractContainers(container, *j);
+        if (difference.cardinality != 0)
+        {
+            result.containers.push_back(std::move(difference));
+        }
+    }
+    return result;
+}
+
+/**
+ * Unites many bitmaps at once (OR). Containers with the same key are merged into a single
+ * bitset instead of uniting the bitmaps pairwise. Only containers whose keys lie in the given
+ * range are united so that ranges can be united separately.
+ *
+ * @param bitmaps bitmaps to be united.
+ * @param firstKey first key of the containers to be united.
+ * @param endKey key after the last key of the containers to be united.
+ * @return Bitmap containing the values found in any of the bitmaps within the range.
+ */
+Bitmap Bitmap::uniteAll(const std::vector<const Bitmap *> &bitmaps, uint32_t firstKey,
+    uint32_t endKey)
+{
+    std::vector<const Container *> containers;
+    for (auto bitmap : bitmaps)
+    {
+        for (auto i = bitmap->findContainer(firstKey); i < bitmap->containers.size()
+            && bitmap->containers[i].key < endKey; i++)
+        {
+            containers.push_back(&bitmap->containers[i]);
+        }
+    }
+    std::stable_sort(containers.begin(), containers.end(),
+        [](const Container *a, const Container *b) { return a->key < b->key; });
+    Bitmap result;
+    for (std::size_t i = 0; i < containers.size(); )
+    {
+        std::size_t end = i + 1;
+        while (end < containers.size() && containers[end]->key == containers[i]->key)
+        {
+            end++;
+        }
+        if (end - i == 1)
+        {
+            result.containers.push_back(*containers[i]);
+        }
+        else
+        {
+            Container merged = {containers[i]->key, 0, {}, std::vector<uint64_t>(TFS_BITMAP_WORDS)};
+            for (; i < end; i++)
+            {
+                if (isBitset(*containers[i]))
+                {
+                    for (auto j = 0; j < TFS_BITMAP_WORDS; j++)
+                    {
+                        merged.words[j] |= containers[i]->words[j];
+                    }
+                }
+                else
+                {
+                    for (auto low : containers[i]->values)
+                    {
+                        merged.words[low >> 6] |= uint64_t(1) << (low & 63);
+                    }
+                }
+            }
+            for (auto word : merged.words)
+            {
+                merged.cardinality += __builtin_popcountll(word);
+            }
+            optimize(merged);
+            result.containers.push_back(std::move(merged));
+        }
+        i = end;
+    }
+    return result;
+}
+
+/**
+ * Intersects many bitmaps at once (AND). Each container of the first bitmap is intersected
+ * with the containers with the same key in the other bitmaps until it becomes empty, so
+ * bitmaps should be ordered from the smallest. Only containers whose keys lie in the given
+ * range are intersected so that ranges can be intersected separately.
+ *
+ * @param bitmaps bitmaps to be intersected.
+ * @param firstKey first key of the containers to be intersected.
+ * @param endKey key after the last key of the containers to be intersected.
+ * @return Bitmap containing the values found in all of the bitmaps within the range.
+ */
+Bitmap Bitmap::intersectAll(const std::vector<const Bitmap *> &bitmaps, uint32_t firstKey,
+    uint32_t endKey)
+{
+    Bitmap result;
+    if (bitmaps.empty())
+    {
+        return result;
+    }
+    const Bitmap &first = *bitmaps[0];
+    for (auto i = first.findContainer(firstKey); i < first.containers.size()
+        && first.containers[i].key < endKey; i++)
+    {
+        Container container = first.containers[i];
+        for (std::size_t j = 1; j < bitmaps.size() && container.cardinality != 0; j++)
+        {
+            std::size_t position = bitmaps[j]->findContainer(container.key);
+            if (position == bitmaps[j]->containers.size()
+                || bitmaps[j]->containers[position].key != container.key)
+            {
+                container.cardinality = 0;
+                break;
+            }
+            container = intersectContainers(container, bitmaps[j]->containers[position]);
+        }
+        if (container.cardinality != 0)
+        {
+            result.containers.push_back(std::move(container));
+        }
+    }
+    return result;
+}
+
+/**
+ * Joins bitmaps holding disjoint ranges of keys into one bitmap, emptying them.
+ *
+ * @param parts bitmaps ordered by their ranges of keys.
+ * @return Bitmap containing the values found in any of the parts.
+ */
+Bitmap Bitmap::concatenate(std::vector<Bitmap> &parts)
+{
+    Bitmap result;
+    for (auto &part : parts)
+    {
+        std::move(part.containers.begin(), part.containers.end(),
+            std::back_inserter(result.containers));
+        part.containers.clear();
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+ * @file Bitmap.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the Bitmap class.
+ *
+ * @details This file contains the class definition for the Bitmap class.
+ * The Bitmap class is a compressed bitmap of 32-bit integers based on the
+ * Roaring bitmap format. It is used to store the IDs of the files tagged with
+ * each tag so that files with any or all of a set of tags can be found with
+ * set operations instead of comparing lists of IDs as strings.
+ */
+
+#ifndef TFS_BITMAP_HPP
+#define TFS_BITMAP_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TaggableFS
+{
+
+/**
+ * This class stores a set of 32-bit integers as a compressed bitmap. The values are grouped
+ * by their upper 16 bits into containers which store the lower 16 bits either as a sorted
+ * array when sparse or as a bitset when dense.
+ */
+class Bitmap
+{
+private:
+    /**
+     * A plain old data type storing the values of the bitmap sharing the same upper 16 bits.
+     */
+    struct Container
+    {
+        /** Upper 16 bits shared by the values stored in the container. */
+        uint16_t key;
+        /** Number of values stored in the container. */
+        uint32_t cardinality;
+        /** Sorted lower 16 bits of the values if stored as an array. */
+        std::vector<uint16_t> values;
+        /** Bits set for the lower 16 bits of the values if stored as a bitset. */
+        std::vector<uint64_t> words;
+    };
+
+    /** Containers sorted by their keys, none of them empty. */
+    std::vector<Container> containers;
+
+    std::size_t findContainer(uint16_t key) const;
+    static bool isBitset(const Container &container);
+    static void toBitset(Container &container);
+    static void toArray(Container &container);
+    static void optimize(Container &container);
+    static bool containerContains(const Container &container, uint16_t low);
+    static Container intersectContainers(const Container &a, const Container &b);
+    static uint32_t countIntersection(const Container &a, const Container &b);
+    static Container uniteContainers(const Container &a, const Container &b);
+    static Container subtractContainers(const Container &a, const Container &b);
+
+public:
+    bool add(uint32_t value);
+    bool remove(uint32_t value);
+    bool contains(uint32_t value) const;
+    bool isEmpty() const;
+    uint64_t cardinality() const;
+    std::size_t memoryUsage() const;
+    void clear();
+    std::vector<uint32_t> toVector() const;
+    std::vector<uint32_t> toVector(uint64_t first, uint64_t skip, std::size_t limit) const;
+    std::string serialize() const;
+    bool deserialize(const std::string &data);
+    std::size_t numberOfContainers() const;
+    std::vector<uint32_t> splitKeys(std::size_t numberOfParts) const;
+
+    static Bitmap intersect(const Bitmap &a, const Bitmap &b);
+    static Bitmap unite(const Bitmap &a, const Bitmap &b);
+    static Bitmap subtract(const Bitmap &a, const Bitmap &b);
+    static Bitmap uniteAll(const std::vector<const Bitmap *> &bitmaps, uint32_t firstKey = 0,
+        uint32_t endKey = 0x10000);
+    static Bitmap intersectAll(const std::vector<const Bitmap *> &bitmaps,
+        uint32_t firstKey = 0, uint32_t endKey = 0x10000);
+    static Bitmap concatenate(std::vector<Bitmap> &parts);
+    static uint64_t intersectionCardinality(const Bitmap &a, const Bitmap &b);
+};
+
+}
+
+#endif
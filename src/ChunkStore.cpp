@@ -0,0 +1,447 @@
+/**
+ * @file ChunkStore.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the ChunkStore class.
+ *
+ * @details This file contains the method definitions for the ChunkStore class.
+ */
+
+#include "ChunkStore.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+
+/** Size in bytes of the reads when a file is split into chunks. */
+#define TFS_CHUNK_BUFFER_SIZE (4 * TFS_CHUNK_MAX_SIZE)
+
+namespace TaggableFS
+{
+
+/**
+ * Constructor for the ChunkStore class.
+ *
+ * @param rootDirectory folder where files are stored.
+ */
+ChunkStore::ChunkStore(std::string rootDirectory) : rootDirectory(rootDirectory)
+{
+}
+
+/**
+ * Gets the table of random values rolled into the fingerprint for each byte. The values are
+ * generated with SplitMix64 from a fixed seed so that boundaries stay the same across runs.
+ *
+ * @return Table of 256 values indexed by byte.
+ */
+const uint64_t *ChunkStore::getGearTable()
+{
+    static const std::array<uint64_t, 256> table = []()
+    {
+        std::array<uint64_t, 256> values;
+        uint64_t state = 0x5441474741424C45; // "TAGGABLE"
+        for (auto &value : values)
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+/**
+ * Finds the end of the chunk starting at the given data with FastCDC. Bytes before the
+ * minimum size are skipped, a stricter mask is used before the average size and a looser one
+ * after it so that the sizes of chunks are normalized around the average.
+ *
+ * @param data data starting with the chunk.
+ * @param size size of the data in bytes, at least the maximum size of a chunk unless the data
+ * ends the file.
+ * @return Size of the chunk in bytes.
+ */
+std::size_t ChunkStore::findBoundary(const unsigned char *data, std::size_t size)
+{
+    if (size <= TFS_CHUNK_MIN_SIZE)
+    {
+        return size;
+    }
+    // the average size is 2^16 bytes, the masks check 2 bits more and 2 bits less than that
+    // from the top of the fingerprint which depend on the last 64 bytes
+    const uint64_t strictMask = ~uint64_t(0) << (64 - 18);
+    const uint64_t looseMask = ~uint64_t(0) << (64 - 14);
+    const uint64_t *gearTable = getGearTable();
+    std::size_t normalSize = std::min<std::size_t>(size, TFS_CHUNK_AVERAGE_SIZE);
+    std::size_t maxSize = std::min<std::size_t>(size, TFS_CHUNK_MAX_SIZE);
+    uint64_t fingerprint = 0;
+    std::size_t i = TFS_CHUNK_MIN_SIZE;
+    for (; i < normalSize; i++)
+    {
+        fingerprint = (fingerprint << 1) + gearTable[data[i]];
+        if ((fingerprint & strictMask) == 0)
+        {
+            return i + 1;
+        }
+    }
+    for (; i < maxSize; i++)
+    {
+        fingerprint = (fingerprint << 1) + gearTable[data[i]];
+        if ((fingerprint & looseMask) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return maxSize;
+}
+
+/**
+ * Gets the path to the manifest of a chunked file.
+ *
+ * @param blobPath path the file would be stored at if it wasn't chunked.
+ * @return Path to the manifest.
+ */
+std::string ChunkStore::getManifestPath(std::string blobPath)
+{
+    return blobPath + ".manifest";
+}
+
+/**
+ * Gets the path to the stored copy of a chunk.
+ *
+ * @param chunkHash hash value of the chunk.
+ * @param create boolean to create the folders the chunk is stored in if they don't exist.
+ * @return Path to the chunk.
+ */
+std::string ChunkStore::getChunkPath(std::string chunkHash, bool create) const
+{
+    return getShardedPath(rootDirectory + "/chunks", chunkHash, create);
+}
+
+/**
+ * Reads the manifest of a chunked file. The first line holds the size of the file and each
+ * following line the hash value and size of a chunk.
+ *
+ * @param blobPath path the file would be stored at if it wasn't chunked.
+ * @param manifest manifest to be filled in.
+ * @return Boolean indicating if the file is chunked and its manifest was read.
+ */
+bool ChunkStore::readManifest(std::string blobPath, Manifest &manifest)
+{
+    std::ifstream manifestFile(getManifestPath(blobPath));
+    if (!(manifestFile >> manifest.size))
+    {
+        return false;
+    }
+    manifest.chunks.clear();
+    ChunkReference chunk = {"", 0, 0};
+    while (manifestFile >> chunk.hash >> chunk.length)
+    {
+        manifest.chunks.push_back(chunk);
+        chunk.offset += chunk.length;
+    }
+    return chunk.offset == manifest.size;
+}
+
+/**
+ * Reads the size of a chunked file from the first line of its manifest without reading the
+ * chunks listed after it.
+ *
+ * @param blobPath path the file would be stored at if it wasn't chunked.
+ * @param size size of the file to be filled in.
+ * @return Boolean indicating if the size was read.
+ */
+bool ChunkStore::readManifestSize(std::string blobPath, uint64_t &size)
+{
+    int fd = open(getManifestPath(blobPath).c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    char line[32] = {};
+    ssize_t bytesRead = pread(fd, line, sizeof(line) - 1, 0);
+    close(fd);
+    char *end = NULL;
+    size = strtoull(line, &end, 10);
+    return bytesRead > 0 && end != line && *end == '\n';
+}
+
+/**
+ * Gets the attributes of a stored file, chunked or not. The attributes of a chunked file are
+ * those of its manifest with the size of the file.
+ *
+ * @param blobPath path the file is stored at if it isn't chunked.
+ * @param buf struct for lstat() to store values in.
+ * @return Return value from lstat() called on the file or its manifest.
+ */
+int ChunkStore::getAttributes(std::string blobPath, struct stat *buf)
+{
+    if (lstat(blobPath.c_str(), buf) == 0)
+    {
+        return 0;
+    }
+    int error = errno;
+    uint64_t size = 0;
+    if (lstat(getManifestPath(blobPath).c_str(), buf) == 0 && readManifestSize(blobPath, size))
+    {
+        buf->st_size = size;
+        buf->st_blocks = (size + 511) / 512;
+        return 0;
+    }
+    errno = error;
+    return -1;
+}
+
+/**
+ * Stores a chunk unless a chunk with the same hash value is already stored. The chunk is
+ * written under a unique temporary name first so that a partly written chunk is never shared,
+ * even while the daemon and the hashing threads store the same chunk.
+ *
+ * @param chunkHash hash value of the chunk.
+ * @param data data of the chunk.
+ * @param size size of the chunk in bytes.
+ * @return Boolean indicating if the chunk is stored.
+ */
+bool ChunkStore::storeChunk(std::string chunkHash, const unsigned char *data,
+    std::size_t size) const
+{
+    std::string chunkPath = getChunkPath(chunkHash, true);
+    if (access(chunkPath.c_str(), F_OK) == 0)
+    {
+        return true;
+    }
+    std::string tempChunkPath = chunkPath + ".XXXXXX";
+    int fd = mkstemp(&tempChunkPath[0]);
+    if (fd == -1)
+    {
+        return false;
+    }
+    fchmod(fd, 0644);
+    bool isWritten = writeAll(fd, reinterpret_cast<const char *>(data), size);
+    if (close(fd) == -1 || isWritten == false
+        || rename(tempChunkPath.c_str(), chunkPath.c_str()) == -1)
+    {
+        remove(tempChunkPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Splits a file into chunks, stores the chunks not already stored and writes its manifest.
+ *
+ * @param path path to the file to be stored.
+ * @param blobPath path the file would be stored at if it wasn't chunked.
+ * @param hasher hasher used to name the chunks.
+ * @param chunkHashes hash values of the chunks of the file in order to be filled in.
+ * @return Boolean indicating if the file was stored, the file itself is left in place.
+ */
+bool ChunkStore::storeFile(std::string path, std::string blobPath, Hasher &hasher,
+    std::vector<std::string> &chunkHashes) const
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    mkdir((rootDirectory + "/chunks").c_str(), 0755);
+    chunkHashes.clear();
+    std::vector<unsigned char> buffer(TFS_CHUNK_BUFFER_SIZE);
+    std::size_t start = 0, end = 0;
+    uint64_t size = 0;
+    std::string chunkList = "";
+    bool isEndOfFile = false, isStored = true;
+    while (isStored)
+    {
+        // keep at least a chunk of the maximum size buffered so that boundaries are found
+        if (isEndOfFile == false && end - start < TFS_CHUNK_MAX_SIZE)
+        {
+            std::copy(buffer.begin() + start, buffer.begin() + end, buffer.begin());
+            end -= start;
+            start = 0;
+            while (isEndOfFile == false && end < buffer.size())
+            {
+                ssize_t bytesRead = ::read(fd, buffer.data() + end, buffer.size() - end);
+                if (bytesRead == -1)
+                {
+                    isStored = false;
+                    break;
+                }
+                isEndOfFile = (bytesRead == 0);
+                end += bytesRead;
+            }
+        }
+        if (isStored == false || start == end)
+        {
+            break;
+        }
+        std::size_t chunkSize = findBoundary(buffer.data() + start, end - start);
+        hasher.begin();
+        hasher.update(buffer.data() + start, chunkSize);
+        std::string chunkHash = hasher.finish();
+        isStored = storeChunk(chunkHash, buffer.data() + start, chunkSize);
+        chunkHashes.push_back(chunkHash);
+        chunkList += chunkHash + " " + std::to_string(chunkSize) + "\n";
+        size += chunkSize;
+        start += chunkSize;
+    }
+    close(fd);
+    if (isStored == false)
+    {
+        return false;
+    }
+    std::string manifestPath = getManifestPath(blobPath);
+    std::string tempManifestPath = manifestPath + ".WRITE";
+    std::string manifest = std::to_string(size) + "\n" + chunkList;
+    fd = open(tempManifestPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        return false;
+    }
+    bool isWritten = writeAll(fd, manifest.data(), manifest.size());
+    if (close(fd) == -1 || isWritten == false
+        || rename(tempManifestPath.c_str(), manifestPath.c_str()) == -1)
+    {
+        remove(tempManifestPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Prepares to read a chunked file, with its chunks opened as they are read.
+ *
+ * @param manifest manifest of the file.
+ * @param chunks chunks of the file to be read.
+ */
+void ChunkStore::openChunks(const Manifest &manifest, OpenChunks &chunks)
+{
+    chunks.fds.assign(manifest.chunks.size(), -1);
+    chunks.opened.clear();
+}
+
+/**
+ * Closes the open chunks of a chunked file.
+ *
+ * @param chunks chunks of the file.
+ */
+void ChunkStore::closeChunks(OpenChunks &chunks)
+{
+    for (auto fd : chunks.fds)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+        }
+    }
+    chunks.fds.clear();
+    chunks.opened.clear();
+}
+
+/**
+ * Reads data of a chunked file from the chunks covering the requested range. Chunks which
+ * aren't open yet are opened and kept open for later reads.
+ *
+ * @param manifest manifest of the file.
+ * @param chunks chunks of the file prepared by openChunks().
+ * @param buf buffer to store the data in.
+ * @param n read length.
+ * @param offset offset from start of the file.
+ * @return Number of bytes read, -1 with errno set if a chunk couldn't be read.
+ */
+ssize_t ChunkStore::read(const Manifest &manifest, OpenChunks &chunks, char *buf, std::size_t n,
+    off_t offset) const
+{
+    if (offset < 0 || uint64_t(offset) >= manifest.size)
+    {
+        return 0;
+    }
+    // first chunk ending after the offset
+    auto chunk = std::upper_bound(manifest.chunks.begin(), manifest.chunks.end(),
+        uint64_t(offset), [](uint64_t offset, const ChunkReference &chunk)
+        {
+            return offset < chunk.offset + chunk.length;
+        });
+    std::size_t bytesRead = 0;
+    while (bytesRead < n && chunk != manifest.chunks.end())
+    {
+        uint64_t position = offset + bytesRead - chunk->offset;
+        std::size_t length = std::min<uint64_t>(n - bytesRead, chunk->length - position);
+        std::size_t index = chunk - manifest.chunks.begin();
+        if (chunks.fds[index] == -1)
+        {
+            chunks.fds[index] = open(getChunkPath(chunk->hash).c_str(), O_RDONLY);
+            if (chunks.fds[index] == -1 && errno == ENOENT) // not moved into the sharded layout
+            {
+                chunks.fds[index] = open((rootDirectory + "/chunks/" + chunk->hash).c_str(),
+                    O_RDONLY);
+            }
+            if (chunks.fds[index] == -1)
+            {
+                return -1;
+            }
+            chunks.opened.push_back(index);
+            if (chunks.opened.size() > TFS_OPEN_CHUNKS_MAX)
+            {
+                close(chunks.fds[chunks.opened.front()]);
+                chunks.fds[chunks.opened.front()] = -1;
+                chunks.opened.pop_front();
+            }
+        }
+        ssize_t result = pread(chunks.fds[index], buf + bytesRead, length, position);
+        if (result == -1)
+        {
+            return -1;
+        }
+        bytesRead += result;
+        if (std::size_t(result) < length) // chunk shorter than listed in the manifest
+        {
+            break;
+        }
+        ++chunk;
+    }
+    return bytesRead;
+}
+
+/**
+ * Writes the data of a chunked file to a file outside the store, only reading the chunks
+ * covering the given length.
+ *
+ * @param blobPath path the file would be stored at if it wasn't chunked.
+ * @param path path to the file to be written.
+ * @param length number of bytes from the start of the file to be written.
+ * @return Boolean indicating if the data was written.
+ */
+bool ChunkStore::assemble(std::string blobPath, std::string path, uint64_t length) const
+{
+    Manifest manifest;
+    if (readManifest(blobPath, manifest) == false)
+    {
+        return false;
+    }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        return false;
+    }
+    OpenChunks chunks;
+    openChunks(manifest, chunks);
+    std::vector<char> buffer(TFS_CHUNK_MAX_SIZE);
+    bool isWritten = true;
+    length = std::min(length, manifest.size);
+    for (uint64_t offset = 0; isWritten && offset < length; )
+    {
+        std::size_t n = std::min<uint64_t>(buffer.size(), length - offset);
+        ssize_t bytesRead = read(manifest, chunks, buffer.data(), n, offset);
+        isWritten = bytesRead > 0 && writeAll(fd, buffer.data(), bytesRead);
+        offset += (bytesRead > 0) ? bytesRead : 0;
+    }
+    closeChunks(chunks);
+    return close(fd) == 0 && isWritten;
+}
+
+}
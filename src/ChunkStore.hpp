@@ -0,0 +1,114 @@
+/**
+ * @file ChunkStore.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the ChunkStore class.
+ *
+ * @details This file contains the class definition for the ChunkStore class.
+ * The ChunkStore class stores large files as manifests listing chunks of
+ * their data found with content-defined chunking (FastCDC). Boundaries of
+ * chunks depend only on the data around them, so a small edit to a large
+ * file only changes the chunks it touches while the rest are shared with the
+ * older version and with any other file containing the same data. A chunked
+ * file is stored as HASH.manifest instead of HASH in the root directory and
+ * its chunks are fanned out under ROOT_DIRECTORY/chunks like the files.
+ */
+
+#ifndef TFS_CHUNKSTORE_HPP
+#define TFS_CHUNKSTORE_HPP
+
+#include "common.hpp"
+#include "Hasher.hpp"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/** Minimum size in bytes of a chunk unless it ends the file. */
+#define TFS_CHUNK_MIN_SIZE (16 << 10)
+
+/** Size in bytes chunks are normalized around. */
+#define TFS_CHUNK_AVERAGE_SIZE (64 << 10)
+
+/** Maximum size in bytes of a chunk. */
+#define TFS_CHUNK_MAX_SIZE (256 << 10)
+
+/** Minimum size in bytes of files stored in chunks, smaller files are stored whole. */
+#define TFS_CHUNKED_FILE_MIN_SIZE (4 << 20)
+
+/** Maximum number of chunks of a file kept open while it is read. */
+#define TFS_OPEN_CHUNKS_MAX 64
+
+namespace TaggableFS
+{
+
+/**
+ * A data type storing where a chunk is found in a chunked file.
+ */
+struct ChunkReference
+{
+    /** Hash value of the chunk naming its stored copy. */
+    std::string hash;
+    /** Offset of the chunk from the start of the file. */
+    uint64_t offset;
+    /** Size of the chunk in bytes. */
+    uint64_t length;
+};
+
+/**
+ * A data type storing the chunks of a chunked file in order.
+ */
+struct Manifest
+{
+    /** Size of the file in bytes. */
+    uint64_t size;
+    /** Chunks of the file sorted by their offsets. */
+    std::vector<ChunkReference> chunks;
+};
+
+/**
+ * A data type storing the chunks of a chunked file opened as it is read, so that sequential
+ * reads don't open and close a chunk each time.
+ */
+struct OpenChunks
+{
+    /** File descriptors of the chunks in the order of the manifest, -1 if not open. */
+    std::vector<int> fds;
+    /** Chunks opened while reading, oldest first, closed to keep few of them open. */
+    std::deque<std::size_t> opened;
+};
+
+/**
+ * This class splits files into chunks, stores them along with their manifests and reads
+ * chunked files back.
+ */
+class ChunkStore
+{
+private:
+    /** Folder where files are stored, containing the folder of chunks. */
+    std::string rootDirectory;
+
+    static const uint64_t *getGearTable();
+    static std::size_t findBoundary(const unsigned char *data, std::size_t size);
+    static bool readManifestSize(std::string blobPath, uint64_t &size);
+    bool storeChunk(std::string chunkHash, const unsigned char *data, std::size_t size) const;
+
+public:
+    ChunkStore(std::string rootDirectory = "");
+    static std::string getManifestPath(std::string blobPath);
+    static bool readManifest(std::string blobPath, Manifest &manifest);
+    static int getAttributes(std::string blobPath, struct stat *buf);
+    std::string getChunkPath(std::string chunkHash, bool create = false) const;
+    bool storeFile(std::string path, std::string blobPath, Hasher &hasher,
+        std::vector<std::string> &chunkHashes) const;
+    static void openChunks(const Manifest &manifest, OpenChunks &chunks);
+    static void closeChunks(OpenChunks &chunks);
+    ssize_t read(const Manifest &manifest, OpenChunks &chunks, char *buf, std::size_t n,
+        off_t offset) const;
+    bool assemble(std::string blobPath, std::string path, uint64_t length = UINT64_MAX) const;
+};
+
+}
+
+#endif
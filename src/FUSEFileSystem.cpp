@@ -14,6 +14,9 @@ namespace TaggableFS
 
 bool FUSEFileSystem::instancedFUSEFileSystem = false;
 bool FUSEFileSystem::loggingEnabled = false;
+std::string FUSEFileSystem::hashAlgorithm = "md5";
+ChunkStore FUSEFileSystem::chunkStore;
+std::unordered_map<std::string, std::vector<OpenFile *>> FUSEFileSystem::writers;
 
 /** Function binding to FUSEFileSystem instance's queryTFS method for use in FUSE operations. */
 std::function<std::vector<std::string> (std::string query)> queryTFS;
@@ -22,12 +25,17 @@ std::function<std::vector<std::string> (std::string query)> queryTFS;
  * Constructor for the FUSEFileSystem class.
  *
  * @param mountPoint path at which the FUSE filesystem is to be mounted.
+ * @param rootDirectory root directory where files are stored.
  * @param programName name of the original program to be passed to fuse_main().
  * @param enableLogging boolean to enable or disable logging.
+ * @param hashAlgorithm hash algorithm of the root directory.
  */
-FUSEFileSystem::FUSEFileSystem(std::string mountPoint, std::string programName, bool enableLogging)
+FUSEFileSystem::FUSEFileSystem(std::string mountPoint, std::string rootDirectory,
+    std::string programName, bool enableLogging, std::string hashAlgorithm)
     : mountPoint(mountPoint), programName(programName)
 {
+    FUSEFileSystem::hashAlgorithm = hashAlgorithm;
+    FUSEFileSystem::chunkStore = ChunkStore(rootDirectory);
     // loggingEnabled = enableLogging; // only enable if debugging FUSE operations.
     if (instancedFUSEFileSystem == true)
     {
@@ -173,6 +181,17 @@ bool checkIfDirectory(std::string path)
     return (results[0] == "TM_TRUE");
 }
 
+/**
+ * Gets the state of an opened file stored in its file handle by TFSopen().
+ *
+ * @param fi information of the file passed from TFSopen().
+ * @return State of the opened file.
+ */
+OpenFile *getOpenFile(struct fuse_file_info *fi)
+{
+    return reinterpret_cast<OpenFile *>(fi->fh);
+}
+
 /**
  * A helper function to log for debugging purposes.
  *
@@ -191,7 +210,8 @@ void log(std::string text)
  *
  * @param path relative path to file/folder in the mounted filesystem.
  * @param buf struct for lstat() to store values in.
- * @return Return value from lstat(), 0 if folder along with values filled in buf.
+ * @return Return value from lstat() called on the file or the manifest of a chunked file, 0 if
+ *          folder along with values filled in buf.
  *          If both failed, the error code for no such entity (ENOENT).
  */
 int TFSgetattr(const char *path, struct stat *buf)
@@ -208,7 +228,7 @@ int TFSgetattr(const char *path, struct stat *buf)
     std::string realPath = getRealPath(path);
     if (getFilename(realPath) != "")
     {
-        int returnValue = lstat(realPath.c_str(), buf);
+        int returnValue = ChunkStore::getAttributes(realPath, buf);
         if (returnValue == -1)
         {
             log("ERROR: _TFSgetattr_ lstat() failed, errno = " + std::to_string(errno));
@@ -244,7 +264,7 @@ int TFStruncate(const char *file, off_t length)
  * open() filesystem operation implementation for TaggableFS.
  *
  * @param file relative path to file in the mounted filesystem.
- * @param fi information of the file opened including the file descriptor.
+ * @param fi information of the file opened including the state of the opened file.
  * @return Return value from open() called on the actual file.
  */
 int TFSopen(const char *file, struct fuse_file_info *fi)
@@ -252,16 +272,40 @@ int TFSopen(const char *file, struct fuse_file_info *fi)
     log("_TFSopen_");
     std::string pathToFile = getRealPath(file);
     int fd = -1;
+    Manifest manifest;
+    bool isChunked = false;
     if (pathToFile != "")
     {
         fd = open(pathToFile.c_str(), fi->flags, 0777);
-        fi->fh = fd;
+        if (fd == -1 && errno == ENOENT)
+        {
+            // chunks are kept until release even if the file is overwritten or deleted
+            queryTFS("FD_PIN_CHUNKS " + getFilename(pathToFile));
+            isChunked = ChunkStore::readManifest(pathToFile, manifest);
+            if (isChunked == false)
+            {
+                queryTFS("FD_UNPIN_CHUNKS " + getFilename(pathToFile));
+                errno = ENOENT;
+            }
+        }
     }
-    if (fd == -1)
+    if (fd == -1 && isChunked == false)
     {
         log("ERROR: _TFSopen_ open() failed, errno = " + std::to_string(errno));
         return -errno;
     }
+    OpenFile *openFile = new OpenFile;
+    openFile->fd = fd;
+    openFile->isChunked = isChunked;
+    openFile->manifest = std::move(manifest);
+    ChunkStore::openChunks(openFile->manifest, openFile->chunks);
+    openFile->chunkedHash = isChunked ? getFilename(pathToFile) : "";
+    openFile->isWriting = false;
+    openFile->isSequential = true;
+    openFile->hashedLength = 0;
+    openFile->hasher.setAlgorithm(FUSEFileSystem::hashAlgorithm);
+    openFile->hasher.begin();
+    fi->fh = reinterpret_cast<uint64_t>(openFile);
     return 0;
 }
 
@@ -273,12 +317,16 @@ int TFSopen(const char *file, struct fuse_file_info *fi)
  * @param nbytes read length.
  * @param offset offset from start of the file.
  * @param fi information of the file passed from TFSopen().
- * @return Return value from pread() called on the actual file.
+ * @return Return value from pread() called on the actual file or its chunks.
  */
 int TFSread(const char *file, char *buf, size_t nbytes, off_t offset, struct fuse_file_info *fi)
 {
     log("_TFSread_");
-    int returnValue = pread(fi->fh, buf, nbytes, offset);
+    OpenFile *openFile = getOpenFile(fi);
+    int returnValue = (openFile->fd == -1)
+        ? FUSEFileSystem::chunkStore.read(openFile->manifest, openFile->chunks, buf, nbytes,
+            offset)
+        : pread(openFile->fd, buf, nbytes, offset);
     if (returnValue == -1)
     {
         log("ERROR: _TFSread_ pread() failed, errno = " + std::to_string(errno));
@@ -288,7 +336,9 @@ int TFSread(const char *file, char *buf, size_t nbytes, off_t offset, struct fus
 }
 
 /**
- * write() filesystem operation implementation for TaggableFS.
+ * write() filesystem operation implementation for TaggableFS. The first write switches the
+ * opened file to a temporary copy. Data written in order from the start of the file is added
+ * to its hash value so that the daemon doesn't have to read the file again on release.
  *
  * @param file relative path to file in the mounted filesystem.
  * @param buf buffer for pwrite() to read data from to write to file.
@@ -300,36 +350,68 @@ int TFSread(const char *file, char *buf, size_t nbytes, off_t offset, struct fus
 int TFSwrite(const char *file, const char *buf, size_t n, off_t offset, struct fuse_file_info *fi)
 {
     log("_TFSwrite_");
-    if (close(fi->fh) == -1)
+    OpenFile *openFile = getOpenFile(fi);
+    if (openFile->isWriting == false)
     {
-        log("ERROR: _TFSwrite_ close() failed, errno = " + std::to_string(errno));
-        return -errno;
+        if (openFile->fd != -1 && close(openFile->fd) == -1)
+        {
+            log("ERROR: _TFSwrite_ close() failed, errno = " + std::to_string(errno));
+            return -errno;
+        }
+        openFile->fd = -1;
+        ChunkStore::closeChunks(openFile->chunks); // read from the temporary copy from now on
+        std::string pathToFile = getRealPath(file, true) + ".WRITE";
+        if (getFilename(pathToFile) == ".WRITE")
+        {
+            log("ERROR: _TFSwrite_ getRealPath() failed");
+            return -1;
+        }
+        openFile->fd = open(pathToFile.c_str(), O_CREAT | fi->flags, 0777);
+        if (openFile->fd == -1)
+        {
+            log("ERROR: _TFSwrite_ open() failed, errno = " + std::to_string(errno));
+            return -errno;
+        }
+        openFile->isWriting = true;
+        openFile->writePath = pathToFile;
+        // data already in the temporary copy eg. from another handle wasn't hashed
+        struct stat attributes;
+        openFile->isSequential = (fstat(openFile->fd, &attributes) == 0
+            && attributes.st_size == 0);
+        // no handle knows the whole contents once several write to the same temporary copy
+        std::vector<OpenFile *> &writers = FUSEFileSystem::writers[pathToFile];
+        writers.push_back(openFile);
+        if (writers.size() > 1)
+        {
+            for (auto writer : writers)
+            {
+                writer->isSequential = false;
+            }
+        }
     }
-    std::string pathToFile = getRealPath(file, true) + ".WRITE";
-    if (getFilename(pathToFile) == ".WRITE")
+    int returnValue = pwrite(openFile->fd, buf, n, offset);
+    if (returnValue == -1)
     {
-        log("ERROR: _TFSwrite_ getRealPath() failed");
-        return -1;
+        log("ERROR: _TFSwrite_ pwrite() failed, errno = " + std::to_string(errno));
+        return -errno;
     }
-    int fd = open(pathToFile.c_str(), O_CREAT | fi->flags, 0777);
-    fi->fh = fd;
-    if (fd == -1)
+    if (openFile->isSequential && offset == openFile->hashedLength)
     {
-        log("ERROR: _TFSwrite_ open() failed, errno = " + std::to_string(errno));
-        return -errno;
+        openFile->hasher.update(buf, returnValue);
+        openFile->hashedLength += returnValue;
     }
-    int returnValue = pwrite(fi->fh, buf, n, offset);
-    if (returnValue == -1)
+    else
     {
-        log("ERROR: _TFSwrite_ pwrite() failed, errno = " + std::to_string(errno));
-        return -errno;
+        openFile->isSequential = false; // hashed again by the daemon on release
     }
     return returnValue;
 }
 
 /**
  * release() filesystem operation implementation for TaggableFS. FD_UPDATE query sent to update
- * hash value if changed.
+ * hash value if the file was written to, along with the hash value if the whole file was
+ * written in order. Files only read or opened for writing without being written to are left
+ * as they are without asking the daemon.
  *
  * @param file relative path to file in the mounted filesystem.
  * @param fi information of the file passed from TFSopen()/TFSwrite().
@@ -338,12 +420,45 @@ int TFSwrite(const char *file, const char *buf, size_t n, off_t offset, struct f
 int TFSrelease(const char *file, struct fuse_file_info *fi)
 {
     log("_TFSrelease_");
-    int returnValue = close(fi->fh);
-    queryTFS("FD_UPDATE " + std::string(file));
+    OpenFile *openFile = getOpenFile(fi);
+    std::string hash = "";
+    struct stat attributes;
+    if (openFile->isWriting && openFile->isSequential && fstat(openFile->fd, &attributes) == 0
+        && attributes.st_size == openFile->hashedLength)
+    {
+        hash = openFile->hasher.finish();
+    }
+    int returnValue = (openFile->fd == -1) ? 0 : close(openFile->fd);
+    int error = errno;
+    ChunkStore::closeChunks(openFile->chunks);
+    if (openFile->chunkedHash != "")
+    {
+        queryTFS("FD_UNPIN_CHUNKS " + openFile->chunkedHash);
+    }
+    bool isWriting = openFile->isWriting;
+    if (isWriting)
+    {
+        std::vector<OpenFile *> &writers = FUSEFileSystem::writers[openFile->writePath];
+        writers.erase(std::find(writers.begin(), writers.end(), openFile));
+        if (writers.empty())
+        {
+            FUSEFileSystem::writers.erase(openFile->writePath);
+        }
+    }
+    delete openFile;
+    // a temporary copy written through another handle is left for that handle's release
+    if (isWriting && hash == "")
+    {
+        queryTFS("FD_UPDATE " + std::string(file));
+    }
+    else if (isWriting)
+    {
+        queryTFS("FD_UPDATE_HASHED " + hash + "," + std::string(file));
+    }
     if (returnValue == -1)
     {
-        log("ERROR: _TFSrelease_ close() failed, errno = " + std::to_string(errno));
-        return -errno;
+        log("ERROR: _TFSrelease_ close() failed, errno = " + std::to_string(error));
+        return -error;
     }
     return returnValue;
 }
@@ -372,8 +487,9 @@ int TFSmknod(const char *file, mode_t mode, dev_t dev)
     {
         char tempFilename[16];
         sprintf(tempFilename, "TEMP%09d", tempFileNumber++);
-        queryTFS("FD_ADD_TEMP " + std::string(tempFilename) + "," + std::string(file));
-        pathToFile += tempFilename;
+        // the daemon decides where the temporary file is stored
+        pathToFile = queryTFS("FD_ADD_TEMP " + std::string(tempFilename) + ","
+            + std::string(file))[0];
     }
     if (S_ISREG(mode))
     {
@@ -546,6 +662,10 @@ int TFSutime(const char *file, struct utimbuf *ubuf)
         return -1;
     }
     int returnValue = utime(pathToFile.c_str(), ubuf);
+    if (returnValue == -1 && errno == ENOENT) // chunked files take times of their manifests
+    {
+        returnValue = utime(ChunkStore::getManifestPath(pathToFile).c_str(), ubuf);
+    }
     if (returnValue == -1)
     {
         log("ERROR: _TFSutime_ utime() failed, errno = " + std::to_string(errno));
@@ -13,9 +13,12 @@
 #define TFS_FUSEFILESYSTEM_HPP
 
 #include "common.hpp"
+#include "Hasher.hpp"
+#include "ChunkStore.hpp"
 #include <unistd.h>
 #include <dirent.h>
 #include <functional>
+#include <unordered_map>
 
 /** FUSE version used. */
 #define FUSE_USE_VERSION    26
@@ -24,6 +27,36 @@
 namespace TaggableFS
 {
 
+/**
+ * A data type storing the state of a file opened in the mounted filesystem, passed from
+ * TFSopen() to the other file operations through the file handle.
+ */
+struct OpenFile
+{
+    /** File descriptor of the stored file or of its temporary copy once written to, -1 if the
+     * stored file is chunked and not written to. */
+    int fd;
+    /** Boolean to indicate if the stored file is chunked and read through its manifest. */
+    bool isChunked;
+    /** Manifest of the stored file if it is chunked. */
+    Manifest manifest;
+    /** Chunks of the stored file opened as it is read if it is chunked. */
+    OpenChunks chunks;
+    /** Hash value of the stored file if it is chunked, whose chunks the daemon keeps until the
+     * file is released. */
+    std::string chunkedHash;
+    /** Boolean to indicate if the temporary copy is being written. */
+    bool isWriting;
+    /** Path to the temporary copy once written to. */
+    std::string writePath;
+    /** Boolean to indicate if all data was written in order from the start of the file. */
+    bool isSequential;
+    /** Number of bytes written in order from the start of the file. */
+    off_t hashedLength;
+    /** Hash value of the bytes written in order from the start of the file. */
+    Hasher hasher;
+};
+
 /**
  * This class handles initialization and shutdown of the FUSE filesystem and communication
  * with the TaggableFS daemon for various filesystem operations.
@@ -57,12 +90,23 @@ public:
     /** Check to see if logging is enabled. */
     static bool loggingEnabled;
 
-    FUSEFileSystem(std::string mountPoint, std::string programName, bool enableLogging);
+    /** Hash algorithm of the root directory used to hash data as it is written. */
+    static std::string hashAlgorithm;
+
+    /** Store of the chunks of chunked files in the root directory. */
+    static ChunkStore chunkStore;
+
+    /** Handles which wrote to each temporary copy, by its path, and are not yet released. */
+    static std::unordered_map<std::string, std::vector<OpenFile *>> writers;
+
+    FUSEFileSystem(std::string mountPoint, std::string rootDirectory, std::string programName,
+        bool enableLogging, std::string hashAlgorithm);
 };
 
 void log(std::string text);
 std::string getRealPath(std::string mountedPath, bool modify = false);
 bool checkIfDirectory(std::string path);
+OpenFile *getOpenFile(struct fuse_file_info *fi);
 
 int TFSgetattr(const char *path, struct stat *buf);
 int TFStruncate(const char *file, off_t length);
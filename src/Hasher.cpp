@@ -0,0 +1,187 @@
+/**
+ * @file Hasher.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the Hasher class.
+ *
+ * @details This file contains the method definitions for the Hasher class.
+ */
+
+#include "Hasher.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+
+/** Size in bytes of the reads when a file is hashed. */
+#define TFS_HASH_BUFFER_SIZE (128 << 10)
+
+namespace TaggableFS
+{
+
+/**
+ * Constructor for the Hasher class. MD5 is used until another algorithm is set as it was the
+ * only algorithm before others could be chosen.
+ */
+Hasher::Hasher() : digest(NULL), context(EVP_MD_CTX_new())
+{
+    setAlgorithm("md5");
+}
+
+/**
+ * Destructor for the Hasher class.
+ */
+Hasher::~Hasher()
+{
+    EVP_MD_CTX_free(context);
+}
+
+/**
+ * Gets the OpenSSL digest of the given algorithm.
+ *
+ * @param algorithm name of the algorithm.
+ * @return Digest of the algorithm, NULL if not supported.
+ */
+const EVP_MD *Hasher::getDigest(std::string algorithm)
+{
+    if (algorithm == "md5")
+    {
+        return EVP_md5();
+    }
+    if (algorithm == "sha256")
+    {
+        return EVP_sha256();
+    }
+    if (algorithm == "blake2b")
+    {
+        return EVP_blake2b512();
+    }
+    if (algorithm == "blake2s")
+    {
+        return EVP_blake2s256();
+    }
+    return NULL;
+}
+
+/**
+ * Gets the names of the supported algorithms.
+ *
+ * @return Names of the algorithms.
+ */
+std::vector<std::string> Hasher::getAlgorithms()
+{
+    return {"md5", "sha256", "blake2b", "blake2s"};
+}
+
+/**
+ * Checks if the given algorithm is supported.
+ *
+ * @param algorithm name of the algorithm.
+ * @return Boolean indicating if the algorithm is supported.
+ */
+bool Hasher::isSupported(std::string algorithm)
+{
+    return getDigest(algorithm) != NULL;
+}
+
+/**
+ * Sets the algorithm used to calculate hash values.
+ *
+ * @param algorithm name of the algorithm.
+ * @return Boolean indicating if the algorithm is supported.
+ */
+bool Hasher::setAlgorithm(std::string algorithm)
+{
+    const EVP_MD *digest = getDigest(algorithm);
+    if (digest == NULL)
+    {
+        return false;
+    }
+    this->algorithm = algorithm;
+    this->digest = digest;
+    begin();
+    emptyHash = finish();
+    return true;
+}
+
+/**
+ * Gets the name of the algorithm used to calculate hash values.
+ *
+ * @return Name of the algorithm.
+ */
+std::string Hasher::getAlgorithm() const
+{
+    return algorithm;
+}
+
+/**
+ * Gets the hash value of empty data, which is the name of newly created files.
+ *
+ * @return Hash value of empty data.
+ */
+const std::string &Hasher::getEmptyHash() const
+{
+    return emptyHash;
+}
+
+/**
+ * Begins calculating a new hash value.
+ */
+void Hasher::begin()
+{
+    EVP_DigestInit_ex(context, digest, NULL);
+}
+
+/**
+ * Adds the next part of the data to the hash value being calculated.
+ *
+ * @param data data to be added.
+ * @param size size of the data in bytes.
+ */
+void Hasher::update(const void *data, std::size_t size)
+{
+    EVP_DigestUpdate(context, data, size);
+}
+
+/**
+ * Finishes calculating the hash value.
+ *
+ * @return Hash value as an uppercase hexadecimal string.
+ */
+std::string Hasher::finish()
+{
+    unsigned char value[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context, value, &length);
+    const std::string hexSymbols = "0123456789ABCDEF";
+    std::string hash(2 * length, '0');
+    for (unsigned int i = 0; i < length; i++)
+    {
+        hash[2 * i] = hexSymbols[value[i] >> 4];
+        hash[2 * i + 1] = hexSymbols[value[i] & 0xF];
+    }
+    return hash;
+}
+
+/**
+ * Calculates the hash value of the file stored in the given path.
+ *
+ * @param path path to the file to be hashed.
+ * @return Hash value as an uppercase hexadecimal string.
+ */
+std::string Hasher::hashFile(std::string path)
+{
+    std::vector<char> buffer(TFS_HASH_BUFFER_SIZE);
+    begin();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        ssize_t bytesRead = 0;
+        while ((bytesRead = read(fd, buffer.data(), buffer.size())) > 0)
+        {
+            update(buffer.data(), bytesRead);
+        }
+        close(fd);
+    }
+    return finish();
+}
+
+}
@@ -0,0 +1,64 @@
+/**
+ * @file Hasher.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the Hasher class.
+ *
+ * @details This file contains the class definition for the Hasher class.
+ * The Hasher class calculates the hash values used to name the files stored
+ * in the root directory with one of several algorithms. The algorithm is
+ * chosen when a root directory is initialized and recorded in its catalog so
+ * that roots whose files are named with MD5 hashes keep working while new
+ * roots use SHA-256 or another of the algorithms.
+ */
+
+#ifndef TFS_HASHER_HPP
+#define TFS_HASHER_HPP
+
+#include <openssl/evp.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace TaggableFS
+{
+
+/**
+ * This class calculates hash values of data given in parts or of whole files as uppercase
+ * hexadecimal strings.
+ */
+class Hasher
+{
+private:
+    /** Name of the algorithm. */
+    std::string algorithm;
+
+    /** OpenSSL digest of the algorithm. */
+    const EVP_MD *digest;
+
+    /** OpenSSL context of the hash value being calculated. */
+    EVP_MD_CTX *context;
+
+    /** Hash value of empty data. */
+    std::string emptyHash;
+
+    static const EVP_MD *getDigest(std::string algorithm);
+
+public:
+    Hasher();
+    ~Hasher();
+    Hasher(const Hasher &) = delete;
+    Hasher &operator=(const Hasher &) = delete;
+    static std::vector<std::string> getAlgorithms();
+    static bool isSupported(std::string algorithm);
+    bool setAlgorithm(std::string algorithm);
+    std::string getAlgorithm() const;
+    const std::string &getEmptyHash() const;
+    void begin();
+    void update(const void *data, std::size_t size);
+    std::string finish();
+    std::string hashFile(std::string path);
+};
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * @file HashingPool.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the HashingPool class.
+ *
+ * @details This file contains the method definitions for the HashingPool class.
+ */
+
+#include "HashingPool.hpp"
+#include "Hasher.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Size in bytes of the reads when a file is hashed. */
+#define TFS_HASH_BUFFER_SIZE (128 << 10)
+
+namespace TaggableFS
+{
+
+/**
+ * Constructor for the HashingPool class. Threads are only started by start() so that the pool
+ * can be created before the daemon forks.
+ */
+HashingPool::HashingPool() : numberOfRunningJobs(0), chunkStore(NULL), isStopping(false)
+{
+}
+
+/**
+ * Destructor for the HashingPool class. Stops and joins the threads.
+ */
+HashingPool::~HashingPool()
+{
+    stop();
+}
+
+/**
+ * Starts the threads of the pool.
+ *
+ * @param numberOfThreads number of threads to be started.
+ * @param algorithm name of the hash algorithm to be used.
+ * @param chunkStore store large files are split into chunks in, NULL if chunking is disabled.
+ * @param hashed callback given the name and hash value of each file, empty if the file couldn't
+ *        be read, returning false if it is to be called again later.
+ */
+void HashingPool::start(std::size_t numberOfThreads, std::string algorithm,
+    const ChunkStore *chunkStore, std::function<bool(std::string, std::string)> hashed)
+{
+    this->algorithm = algorithm;
+    this->chunkStore = chunkStore;
+    this->hashed = hashed;
+    for (std::size_t i = 0; i < numberOfThreads; i++)
+    {
+        threads.emplace_back(&HashingPool::work, this);
+    }
+}
+
+/**
+ * Stops and joins the threads, abandoning files not yet hashed.
+ */
+void HashingPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+        queuedFiles.clear();
+    }
+    fileQueued.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+}
+
+/**
+ * Queues a file to be hashed.
+ *
+ * @param path path to the file.
+ * @param name name the file is stored under until its hash value is known.
+ */
+void HashingPool::hash(std::string path, std::string name)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedFiles.emplace_back(path, name);
+    }
+    fileQueued.notify_one();
+}
+
+/**
+ * Gets the number of files queued or being hashed.
+ *
+ * @return Number of files.
+ */
+std::size_t HashingPool::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queuedFiles.size() + numberOfRunningJobs;
+}
+
+/**
+ * Hashes queued files until the pool stops.
+ */
+void HashingPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        fileQueued.wait(lock, [&]() { return isStopping || !queuedFiles.empty(); });
+        if (isStopping)
+        {
+            return;
+        }
+        std::pair<std::string, std::string> file = queuedFiles.front();
+        queuedFiles.pop_front();
+        numberOfRunningJobs++;
+        lock.unlock();
+        std::string hash = hashFile(file.first);
+        if (hash != "" && chunkStore != NULL)
+        {
+            chunkFile(file.first);
+        }
+        while (!isStopping && !hashed(file.second, hash))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        lock.lock();
+        numberOfRunningJobs--;
+    }
+}
+
+/**
+ * Calculates the hash value of the file stored in the given path, giving up if the pool stops.
+ *
+ * @param path path to the file to be hashed.
+ * @return Hash value as an uppercase hexadecimal string, empty if the file couldn't be read.
+ */
+std::string HashingPool::hashFile(std::string path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return "";
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    Hasher hasher;
+    hasher.setAlgorithm(algorithm);
+    hasher.begin();
+    std::vector<char> buffer(TFS_HASH_BUFFER_SIZE);
+    ssize_t bytesRead = 0;
+    while (!isStopping && (bytesRead = read(fd, buffer.data(), buffer.size())) > 0)
+    {
+        hasher.update(buffer.data(), bytesRead);
+    }
+    close(fd);
+    return (bytesRead == 0) ? hasher.finish() : "";
+}
+
+/**
+ * Splits a hashed file into chunks if it is large enough to be chunked. The chunks are stored
+ * and the manifest listing them is written next to the file for the daemon to take over along
+ * with the references to the chunks.
+ *
+ * @param path path to the file to be split into chunks.
+ */
+void HashingPool::chunkFile(std::string path)
+{
+    struct stat attributes;
+    if (isStopping || lstat(path.c_str(), &attributes) != 0
+        || attributes.st_size < TFS_CHUNKED_FILE_MIN_SIZE)
+    {
+        return;
+    }
+    Hasher hasher;
+    hasher.setAlgorithm(algorithm);
+    std::vector<std::string> chunkHashes;
+    chunkStore->storeFile(path, path + TFS_PENDING_CHUNKED_SUFFIX, hasher, chunkHashes);
+}
+
+}
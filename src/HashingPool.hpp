@@ -0,0 +1,87 @@
+/**
+ * @file HashingPool.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the HashingPool class.
+ *
+ * @details This file contains the class definition for the HashingPool class.
+ * The HashingPool class hashes large written files on a fixed number of
+ * background threads so that the TaggableFS daemon can keep answering other
+ * queries while they are read. If chunking is enabled the threads also split
+ * the files into chunks. The daemon is told the hash value of each file once
+ * it is known and moves the file under it on its own thread, since only that
+ * thread uses the database.
+ */
+
+#ifndef TFS_HASHINGPOOL_HPP
+#define TFS_HASHINGPOOL_HPP
+
+#include "ChunkStore.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Suffix of the path a file split into chunks by the pool is stored at in chunks, with its
+ * manifest found as for other chunked files, until the daemon stores it under its hash value. */
+#define TFS_PENDING_CHUNKED_SUFFIX ".chunked"
+
+namespace TaggableFS
+{
+
+/**
+ * This class hashes files queued by the daemon on a pool of threads and reports their hash
+ * values through a callback called on the thread which hashed them.
+ */
+class HashingPool
+{
+private:
+    /** Threads of the pool. */
+    std::vector<std::thread> threads;
+
+    /** Mutex guarding the queue of files. */
+    std::mutex mutex;
+
+    /** Condition variable signalled when a file is queued or the pool stops. */
+    std::condition_variable fileQueued;
+
+    /** Paths to the files waiting to be hashed paired with the names they are stored under. */
+    std::deque<std::pair<std::string, std::string>> queuedFiles;
+
+    /** Number of files being hashed. */
+    std::size_t numberOfRunningJobs;
+
+    /** Name of the hash algorithm used. */
+    std::string algorithm;
+
+    /** Store the hashed files are split into chunks in, NULL if chunking is disabled. */
+    const ChunkStore *chunkStore;
+
+    /** Callback given the name and hash value of each file, returns false to be retried. */
+    std::function<bool(std::string, std::string)> hashed;
+
+    /** Boolean set when the pool is being stopped, checked between reads of a file. */
+    std::atomic<bool> isStopping;
+
+    void work();
+    std::string hashFile(std::string path);
+    void chunkFile(std::string path);
+
+public:
+    HashingPool();
+    ~HashingPool();
+    void start(std::size_t numberOfThreads, std::string algorithm, const ChunkStore *chunkStore,
+        std::function<bool(std::string, std::string)> hashed);
+    void stop();
+    void hash(std::string path, std::string name);
+    std::size_t size();
+};
+
+}
+
+#endif
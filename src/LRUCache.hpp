@@ -0,0 +1,183 @@
+/**
+ * @file LRUCache.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the LRUCache class template.
+ *
+ * @details This file contains the class template definition for the LRUCache
+ * class template. The LRUCache class template stores values up to a total
+ * cost eg. their size in bytes and evicts the least recently used values
+ * when the total cost exceeds its capacity. It is used by the TaggableFS
+ * daemon to keep the results of tag queries so that repeated queries don't
+ * have to be evaluated again.
+ */
+
+#ifndef TFS_LRUCACHE_HPP
+#define TFS_LRUCACHE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace TaggableFS
+{
+
+/**
+ * This class template stores values by key and evicts the least recently used values once the
+ * total cost of the stored values exceeds the capacity.
+ */
+template <typename Key, typename Value>
+class LRUCache
+{
+private:
+    /**
+     * A data type storing a cached value along with its key and cost.
+     */
+    struct Entry
+    {
+        /** Key of the value. */
+        Key key;
+        /** Cached value. */
+        Value value;
+        /** Cost of the value counted against the capacity. */
+        std::size_t cost;
+    };
+
+    /** Entries ordered from the most to the least recently used. */
+    std::list<Entry> entries;
+
+    /** Positions of the entries keyed by their keys. */
+    std::unordered_map<Key, typename std::list<Entry>::iterator> positions;
+
+    /** Maximum total cost of the stored values. */
+    std::size_t capacity;
+
+    /** Total cost of the stored values. */
+    std::size_t totalCost;
+
+public:
+    /**
+     * Constructor for the LRUCache class template.
+     *
+     * @param capacity maximum total cost of the stored values.
+     */
+    explicit LRUCache(std::size_t capacity = 0)
+        : capacity(capacity), totalCost(0)
+    {
+    }
+
+    /**
+     * Finds the value stored with the given key and marks it as the most recently used.
+     *
+     * @param key key of the value.
+     * @return Pointer to the value valid until the cache is next modified, NULL if not found.
+     */
+    Value *get(const Key &key)
+    {
+        auto position = positions.find(key);
+        if (position == positions.end())
+        {
+            return NULL;
+        }
+        entries.splice(entries.begin(), entries, position->second);
+        return &position->second->value;
+    }
+
+    /**
+     * Stores the given value with the given key replacing any value stored with it and evicts
+     * the least recently used values if the capacity is exceeded. Values costing more than the
+     * capacity are not stored.
+     *
+     * @param key key of the value.
+     * @param value value to be stored.
+     * @param cost cost of the value counted against the capacity.
+     */
+    void put(const Key &key, Value value, std::size_t cost)
+    {
+        remove(key);
+        if (cost > capacity)
+        {
+            return;
+        }
+        entries.push_front(Entry{key, std::move(value), cost});
+        positions[key] = entries.begin();
+        totalCost += cost;
+        while (totalCost > capacity)
+        {
+            remove(entries.back().key);
+        }
+    }
+
+    /**
+     * Removes the value stored with the given key if any.
+     *
+     * @param key key of the value.
+     */
+    void remove(const Key &key)
+    {
+        auto position = positions.find(key);
+        if (position != positions.end())
+        {
+            totalCost -= position->second->cost;
+            entries.erase(position->second);
+            positions.erase(position);
+        }
+    }
+
+    /**
+     * Removes all stored values.
+     */
+    void clear()
+    {
+        entries.clear();
+        positions.clear();
+        totalCost = 0;
+    }
+
+    /**
+     * Changes the maximum total cost of the stored values, evicting values if needed.
+     *
+     * @param newCapacity maximum total cost of the stored values.
+     */
+    void setCapacity(std::size_t newCapacity)
+    {
+        capacity = newCapacity;
+        while (totalCost > capacity)
+        {
+            remove(entries.back().key);
+        }
+    }
+
+    /**
+     * Gets the number of stored values.
+     *
+     * @return Number of stored values.
+     */
+    std::size_t size() const
+    {
+        return entries.size();
+    }
+
+    /**
+     * Gets the total cost of the stored values.
+     *
+     * @return Total cost of the stored values.
+     */
+    std::size_t cost() const
+    {
+        return totalCost;
+    }
+
+    /**
+     * Gets the maximum total cost of the stored values.
+     *
+     * @return Capacity of the cache.
+     */
+    std::size_t getCapacity() const
+    {
+        return capacity;
+    }
+};
+
+}
+
+#endif
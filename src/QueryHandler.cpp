@@ -21,6 +21,9 @@ enum QueryHandlerCommands
     QH_HELP,
     QH_LOG,
     QH_TAG_VIEW,
+    QH_MEMORY_BUDGET,
+    QH_HASH,
+    QH_CHUNKING,
     QH_INIT,
     QH_EXIT,
     QH_TAG,
@@ -29,9 +32,22 @@ enum QueryHandlerCommands
     QH_UNNEST,
     QH_STATS,
     QH_SEARCH,
+    QH_QUERY,
     QH_CREATE_TAG,
     QH_DELETE_TAG,
     QH_GET_TAGS,
+    QH_COMPLETE_TAG,
+    QH_FIND_NAME,
+    QH_SAVE_SEARCH,
+    QH_SAVED_SEARCH,
+    QH_LIST_SEARCHES,
+    QH_DELETE_SEARCH,
+    QH_UNTAGGED,
+    QH_SUGGEST_TAGS,
+    QH_CHANGED_SINCE,
+    QH_TAGGED_SINCE,
+    QH_REMOVED_SINCE,
+    QH_MIGRATE_LAYOUT,
     QH_HELP_END
 };
 
@@ -49,7 +65,25 @@ void displayHelp(QueryHandlerCommands command)
         "  --log\n"
         "        log messages to ROOT_DIRECTORY/metadata/log.txt.\n",
         "  --tag-view\n"
-        "        open filesystem in read-only mode to browse tags.\n",
+        "        open filesystem in read-only mode to browse tags. Directories named\n"
+        "        like /+TAG_1+TAG_2-TAG_3 list the files tagged with TAG_1 and TAG_2\n"
+        "        but not TAG_3. Use %2B and %2D for '+' and '-' in tags. Directories\n"
+        "        named like /=NAME list the files of the saved search NAME and\n"
+        "        /@untagged lists the files without any tags.\n",
+        "  --memory-budget MEGABYTES\n"
+        "        keep the catalog on disk instead of loading it into memory and\n"
+        "        bound the memory used for it to the given budget. The budget\n"
+        "        covers SQLite, cached search results and the in-memory indexes,\n"
+        "        reading file attributes and tag co-occurrences from the catalog.\n"
+        "        --stats warns if the indexes exceed the budget.\n",
+        "  --hash md5|sha256|blake2b|blake2s\n"
+        "        name the files of a new root directory with the given hash\n"
+        "        (default sha256, which is the fastest on CPUs with SHA\n"
+        "        extensions). The hash of an existing root directory is kept.\n",
+        "  --chunking\n"
+        "        store files of 4 MiB or more as lists of content-defined chunks\n"
+        "        shared across files and versions so that small edits to large\n"
+        "        files only store the changed chunks. Stays enabled for the root.\n",
         "  --init MOUNT_POINT ROOT_DIRECTORY\n"
         "        launch daemon and mounts FUSE filesystem to the given mount\n"
         "        point and files are stored in root directory.\n",
@@ -69,15 +103,80 @@ void displayHelp(QueryHandlerCommands command)
         "        unnest the given tag from the given parent tag if both are valid.\n",
         "  --stats\n"
         "        display stats regarding mounted FUSE filesystem.\n",
-        "  --search-tags TAG_1 TAG_2 ... TAG_N [--strict]\n"
+        "  --search-tags TAG_1 TAG_2 ... TAG_N [--strict] [--recursive] [--facets[=N]]\n"
+        "        [PAGE]\n"
         "        search for tagged files with any of the given tags\n"
-        "        or with all of them if --strict option is used.\n",
+        "        or with all of them if --strict option is used. The --recursive\n"
+        "        option also matches files tagged with tags nested under them.\n"
+        "        PAGE options are [--limit N] [--offset N] [--cursor ID] to display\n"
+        "        at most N results, skip N results or continue after the cursor\n"
+        "        displayed at the end of the previous page, and\n"
+        "        [--sort size|mtime|name [--top K]] to display the K largest, most\n"
+        "        recently modified or first by filename results with their size or\n"
+        "        modification time, paged by --offset. Files are displayed as\n"
+        "        their paths in the default view. The --facets option also displays\n"
+        "        the N (default 10) tags other than the given ones most common among\n"
+        "        all results with the number of results having each of them.\n",
+        "  --query EXPRESSION [--explain] [--recursive] [--facets[=N]] [PAGE]\n"
+        "        search for tagged files matching the given expression of tags\n"
+        "        combined with AND, OR, NOT and parentheses eg.\n"
+        "        \"(project-x AND raw) AND NOT archived OR urgent\". Tags with\n"
+        "        spaces can be given in double quotes. The --explain option displays\n"
+        "        the order in which the tags were evaluated and the --recursive\n"
+        "        option expands each tag to include the tags nested under it.\n"
+        "        PAGE and --facets options are the same as for --search-tags.\n",
         "  --create-tag TAG\n"
         "        create tag with no children.\n",
         "  --delete-tag TAG\n"
         "        delete tag if it has no children.\n",
         "  --get-tags FILE_PATH\n"
-        "        display all tags current used to tag the file.\n"
+        "        display all tags current used to tag the file.\n",
+        "  --complete-tag PREFIX [--limit N] [--fuzzy]\n"
+        "        display at most N tags (default 10) starting with the given prefix,\n"
+        "        most used first. The --fuzzy option also matches tags containing\n"
+        "        the characters of the prefix in order ignoring case.\n",
+        "  --find-name PATTERN [--query EXPRESSION] [--recursive] [--facets[=N]]\n"
+        "        [PAGE]\n"
+        "        search for files whose names contain the given pattern ignoring\n"
+        "        case. Patterns with '*' or '?' have to match the whole name. The\n"
+        "        --query option only displays files also matching the expression as\n"
+        "        in --query. PAGE and --facets options are the same as for\n"
+        "        --search-tags.\n",
+        "  --save-search NAME EXPRESSION [--recursive]\n"
+        "        save the given expression as in --query under the given name. Its\n"
+        "        results are kept up to date as files are tagged, untagged, added\n"
+        "        and deleted so that reading them doesn't search again.\n",
+        "  --saved-search NAME [--facets[=N]] [PAGE]\n"
+        "        display the results of the search saved under the given name.\n"
+        "        PAGE and --facets options are the same as for --search-tags.\n",
+        "  --list-searches\n"
+        "        display all saved searches with their number of results.\n",
+        "  --delete-search NAME\n"
+        "        delete the search saved under the given name.\n",
+        "  --untagged [PAGE]\n"
+        "        display files without any tags. PAGE options are the same as for\n"
+        "        --search-tags.\n",
+        "  --suggest-tags FILE_PATH [--limit N]\n"
+        "        display at most N tags (default 10) the file isn't tagged with\n"
+        "        which are most often found together with the tags of the file.\n",
+        "  --changed-since TIME [PAGE]\n"
+        "        display files added, modified or moved at or after the given time\n"
+        "        given in seconds since the epoch or relative to now as a number\n"
+        "        followed by s, m, h, d or w eg. 30m or 2d. PAGE options are the same\n"
+        "        as for --search-tags.\n",
+        "  --tagged-since TIME [PAGE]\n"
+        "        display files tagged or untagged at or after the given time given\n"
+        "        as for --changed-since. PAGE options are the same as for\n"
+        "        --search-tags.\n",
+        "  --removed-since TIME\n"
+        "        display the paths which files and folders were deleted or moved\n"
+        "        away from at or after the given time given as for --changed-since,\n"
+        "        oldest first. Everything under a listed folder was removed with it.\n"
+        "        Moved files are listed under their new paths by --changed-since.\n",
+        "  --migrate-layout\n"
+        "        move the files of a root directory created before the sharded\n"
+        "        layout out of its single folder into two levels of folders named\n"
+        "        by the end of their hash values. New root directories are sharded.\n"
     };
 
     int start = command;
@@ -94,13 +193,190 @@ void displayHelp(QueryHandlerCommands command)
     }
 }
 
+/**
+ * Removes the given flag from the arguments if present.
+ *
+ * @param arguments arguments of the command.
+ * @param flag flag to be found eg. --strict.
+ * @return Boolean indicating if the flag was present.
+ */
+bool extractFlag(std::vector<std::string> &arguments, std::string flag)
+{
+    auto position = std::find(arguments.begin(), arguments.end(), flag);
+    if (position == arguments.end())
+    {
+        return false;
+    }
+    arguments.erase(position);
+    return true;
+}
+
+/**
+ * Removes the given option and its numeric value from the arguments if present.
+ *
+ * @param arguments arguments of the command.
+ * @param option option to be found eg. --limit.
+ * @param value variable where the value of the option is stored if present.
+ * @return Boolean indicating if the option was absent or had a valid value.
+ */
+bool extractNumber(std::vector<std::string> &arguments, std::string option, uint64_t &value)
+{
+    auto position = std::find(arguments.begin(), arguments.end(), option);
+    if (position == arguments.end())
+    {
+        return true;
+    }
+    if (position + 1 == arguments.end() || !isdigit((position + 1)->c_str()[0]))
+    {
+        return false;
+    }
+    char *end = NULL;
+    value = strtoull((position + 1)->c_str(), &end, 10);
+    if (end == NULL || *end != '\0')
+    {
+        return false;
+    }
+    arguments.erase(position, position + 2);
+    return true;
+}
+
+/**
+ * Removes the given option from the arguments if present. A value is only taken from the same
+ * argument eg. --facets=5 so that a following argument such as a tag named 2024 isn't taken
+ * as the value.
+ *
+ * @param arguments arguments of the command.
+ * @param option option to be found eg. --facets.
+ * @param value variable where the value of the option is stored if present.
+ * @param defaultValue value stored if the option is present without a value.
+ * @return Boolean indicating if the option was absent or had a valid value if any.
+ */
+bool extractOptionalNumber(std::vector<std::string> &arguments, std::string option,
+    uint64_t &value, uint64_t defaultValue)
+{
+    std::string prefix = option + "=";
+    auto position = std::find_if(arguments.begin(), arguments.end(),
+        [&](const std::string &argument) {
+            return argument == option || argument.compare(0, prefix.length(), prefix) == 0;
+        });
+    if (position == arguments.end())
+    {
+        return true;
+    }
+    value = defaultValue;
+    if (position->length() != option.length())
+    {
+        const char *number = position->c_str() + prefix.length();
+        char *end = NULL;
+        value = strtoull(number, &end, 10);
+        if (!isdigit(number[0]) || end == NULL || *end != '\0')
+        {
+            return false;
+        }
+    }
+    arguments.erase(position);
+    return true;
+}
+
+/**
+ * Removes the given option and its value from the arguments if present.
+ *
+ * @param arguments arguments of the command.
+ * @param option option to be found eg. --query.
+ * @param value variable where the value of the option is stored if present.
+ * @return Boolean indicating if the option was absent or had a value.
+ */
+bool extractString(std::vector<std::string> &arguments, std::string option, std::string &value)
+{
+    auto position = std::find(arguments.begin(), arguments.end(), option);
+    if (position == arguments.end())
+    {
+        return true;
+    }
+    if (position + 1 == arguments.end())
+    {
+        return false;
+    }
+    value = *(position + 1);
+    arguments.erase(position, position + 2);
+    return true;
+}
+
+/**
+ * Parses a time given in seconds since the epoch or relative to now eg. 30m or 2d.
+ *
+ * @param text time to be parsed.
+ * @param time variable where the time in seconds since the epoch is stored if valid.
+ * @return Boolean indicating if the time was valid.
+ */
+bool parseTime(std::string text, int64_t &time)
+{
+    if (text.empty() || !isdigit(text[0]))
+    {
+        return false;
+    }
+    char *end = NULL;
+    int64_t value = strtoll(text.c_str(), &end, 10);
+    if (*end == '\0')
+    {
+        time = value;
+        return true;
+    }
+    const std::string units = "smhdw";
+    const int64_t seconds[] = {1, 60, 60 * 60, 24 * 60 * 60, 7 * 24 * 60 * 60};
+    std::size_t unit = units.find(*end);
+    if (unit == std::string::npos || *(end + 1) != '\0')
+    {
+        return false;
+    }
+    time = ::time(NULL) - value * seconds[unit];
+    return true;
+}
+
+/**
+ * Removes the options selecting the page of search results to be displayed and their order
+ * from the arguments.
+ *
+ * @param arguments arguments of the command.
+ * @param options search options where the values of the options are stored.
+ * @return Boolean indicating if the options were valid.
+ */
+bool extractPageOptions(std::vector<std::string> &arguments, SearchOptions &options)
+{
+    std::string sort = "";
+    uint64_t top = 0;
+    if (extractNumber(arguments, "--limit", options.limit) == false
+        || extractNumber(arguments, "--offset", options.offset) == false
+        || extractNumber(arguments, "--cursor", options.cursor) == false
+        || extractNumber(arguments, "--top", top) == false
+        || extractString(arguments, "--sort", sort) == false)
+    {
+        return false;
+    }
+    const std::string sortOrders[] = {"", "size", "mtime", "name"};
+    auto position = std::find(std::begin(sortOrders), std::end(sortOrders), sort);
+    if (position == std::end(sortOrders))
+    {
+        return false;
+    }
+    options.sort = SortOrder(position - std::begin(sortOrders));
+    if (top != 0)
+    {
+        options.limit = top;
+    }
+    // sorted results are paged by offset only
+    return options.sort == SORT_NONE || options.cursor == 0;
+}
+
 /**
  * Constructor for the QueryHandler class.
  *
  * @param argc number of command line arguments.
  * @param argv command line arguments.
  */
-QueryHandler::QueryHandler(int argc, char *argv[]) : enableLogging(false), tagView(false)
+QueryHandler::QueryHandler(int argc, char *argv[])
+    : enableLogging(false), tagView(false), memoryBudget(0), hashAlgorithm(""),
+      enableChunking(false)
 {
     args = std::vector<std::string>(argv, argv + argc);
     auto loggingOption = std::find(args.begin(), args.end(), "--log");
@@ -115,6 +391,32 @@ QueryHandler::QueryHandler(int argc, char *argv[]) : enableLogging(false), tagVi
         tagView = true;
         args.erase(tagViewOption);
     }
+    auto chunkingOption = std::find(args.begin(), args.end(), "--chunking");
+    if (chunkingOption != args.end())
+    {
+        enableChunking = true;
+        args.erase(chunkingOption);
+    }
+    auto memoryBudgetOption = std::find(args.begin(), args.end(), "--memory-budget");
+    if (memoryBudgetOption != args.end() && memoryBudgetOption + 1 != args.end())
+    {
+        // left in place if invalid so that the command fails with invalid arguments
+        char *end = NULL;
+        unsigned long budget = strtoul((memoryBudgetOption + 1)->c_str(), &end, 10);
+        if (end != NULL && *end == '\0' && budget > 0)
+        {
+            memoryBudget = budget;
+            args.erase(memoryBudgetOption, memoryBudgetOption + 2);
+        }
+    }
+    auto hashOption = std::find(args.begin(), args.end(), "--hash");
+    if (hashOption != args.end() && hashOption + 1 != args.end()
+        && Hasher::isSupported(*(hashOption + 1)))
+    {
+        // left in place if invalid so that the command fails with invalid arguments
+        hashAlgorithm = *(hashOption + 1);
+        args.erase(hashOption, hashOption + 2);
+    }
 
     initMQ();
 }
@@ -196,7 +498,8 @@ int QueryHandler::initTFS()
     std::string programName = args[0];
 
     std::cout << "Initializing TaggableFS..." << std::endl;
-    TFSManager tfsManager(mountPoint, rootDirectory, programName, enableLogging, tagView);
+    TFSManager tfsManager(mountPoint, rootDirectory, programName, enableLogging, tagView,
+        memoryBudget, hashAlgorithm, enableChunking);
     int returnValue =  tfsManager.init();
     initMQ(); // reinitialize message queues.
     if (returnValue == 0)
@@ -349,12 +652,15 @@ int QueryHandler::execute()
     else if (command == "--search-tags")
     {
         std::vector<std::string> arguments(args.begin() + 2, args.end());
-        auto strictOption = std::find(arguments.begin(), arguments.end(), "--strict");
-        int strict = 0;
-        if (strictOption != arguments.end())
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        options.strict = extractFlag(arguments, "--strict");
+        options.recursive = extractFlag(arguments, "--recursive");
+        if (extractOptionalNumber(arguments, "--facets", options.facets, 10) == false
+            || extractPageOptions(arguments, options) == false)
         {
-            strict = 1;
-            arguments.erase(strictOption);
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_SEARCH);
+            return 1;
         }
         if (arguments.size() == 0)
         {
@@ -362,19 +668,38 @@ int QueryHandler::execute()
             displayHelp(QH_SEARCH);
             return 1;
         }
-        std::string query = "QH_SEARCH " + std::to_string(strict)
+        std::string query = "QH_SEARCH " + serializeSearchOptions(options)
             + "," + serializeStrings(arguments);
-        std::vector<std::string> response = queryTFS(query);
-        std::cout << "SEARCH RESULTS (Strict Search: " << ((strict==0) ? "OFF" : "ON") << "):\n";
-        if (response[0] == "")
+        std::cout << "SEARCH RESULTS (Strict Search: " << (options.strict ? "ON" : "OFF")
+            << ", Recursive: " << (options.recursive ? "ON" : "OFF") << "):\n";
+        return printSearchResults(query, options);
+    }
+    else if (command == "--query")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        options.explain = extractFlag(arguments, "--explain");
+        options.recursive = extractFlag(arguments, "--recursive");
+        if (extractOptionalNumber(arguments, "--facets", options.facets, 10) == false
+            || extractPageOptions(arguments, options) == false
+            || arguments.size() != 1)
         {
-            std::cout << "\e[31mNo files Found\e[0m";
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_QUERY);
+            return 1;
         }
-        for (auto result : response)
+        TagQuery tagQuery;
+        if (tagQuery.parse(arguments[0]) == false)
         {
-            std::cout << result << std::endl;
+            std::cerr << "ERROR: Invalid query. " << tagQuery.getError() << "\n";
+            displayHelp(QH_QUERY);
+            return 1;
         }
-        return 0;
+        std::string query = "QH_QUERY " + serializeSearchOptions(options)
+            + "," + tagQuery.serialize();
+        std::cout << "QUERY RESULTS " << tagQuery.toString()
+            << (options.recursive ? " (Recursive)" : "") << ":\n";
+        return printSearchResults(query, options);
     }
     else if (command == "--create-tag")
     {
@@ -426,6 +751,232 @@ int QueryHandler::execute()
         }
         return 0;
     }
+    else if (command == "--find-name")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        std::string expression = "";
+        options.recursive = extractFlag(arguments, "--recursive");
+        if (extractOptionalNumber(arguments, "--facets", options.facets, 10) == false
+            || extractString(arguments, "--query", expression) == false
+            || extractPageOptions(arguments, options) == false
+            || arguments.size() != 1)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_FIND_NAME);
+            return 1;
+        }
+        std::string query = "QH_FIND_NAME " + serializeSearchOptions(options) + ","
+            + arguments[0];
+        TagQuery tagQuery;
+        if (expression != "")
+        {
+            if (tagQuery.parse(expression) == false)
+            {
+                std::cerr << "ERROR: Invalid query. " << tagQuery.getError() << "\n";
+                displayHelp(QH_FIND_NAME);
+                return 1;
+            }
+            query += "\n" + tagQuery.serialize();
+        }
+        std::cout << "FILES NAMED LIKE \"" << arguments[0] << "\""
+            << (expression != "" ? " MATCHING " + tagQuery.toString() : "")
+            << (options.recursive ? " (Recursive)" : "") << ":\n";
+        return printSearchResults(query, options);
+    }
+    else if (command == "--save-search")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        bool recursive = extractFlag(arguments, "--recursive");
+        if (arguments.size() != 2)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_SAVE_SEARCH);
+            return 1;
+        }
+        TagQuery tagQuery;
+        if (tagQuery.parse(arguments[1]) == false)
+        {
+            std::cerr << "ERROR: Invalid query. " << tagQuery.getError() << "\n";
+            displayHelp(QH_SAVE_SEARCH);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_SAVE_SEARCH "
+            + std::string(recursive ? "1" : "0") + "," + arguments[0] + "\n"
+            + tagQuery.serialize());
+        std::cout << "RESPONSE: " << response[0] << std::endl;
+        return 0;
+    }
+    else if (command == "--saved-search")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        if (extractOptionalNumber(arguments, "--facets", options.facets, 10) == false
+            || extractPageOptions(arguments, options) == false || arguments.size() != 1)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_SAVED_SEARCH);
+            return 1;
+        }
+        std::string query = "QH_SAVED_SEARCH " + serializeSearchOptions(options) + ","
+            + arguments[0];
+        std::cout << "SAVED SEARCH RESULTS " << arguments[0] << ":\n";
+        return printSearchResults(query, options);
+    }
+    else if (command == "--migrate-layout")
+    {
+        if (numberOfArguments != 0)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_MIGRATE_LAYOUT);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_MIGRATE_LAYOUT");
+        std::cout << "RESPONSE: " << response[0] << std::endl;
+        return 0;
+    }
+    else if (command == "--list-searches")
+    {
+        if (numberOfArguments != 0)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_LIST_SEARCHES);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_LIST_SEARCHES");
+        std::cout << "SAVED SEARCHES: " << std::endl;
+        if (response[0] == "")
+        {
+            std::cout << "\e[31mNo Saved Searches Found\e[0m" << std::endl;
+            return 0;
+        }
+        for (auto search : response)
+        {
+            std::cout << search << std::endl;
+        }
+        return 0;
+    }
+    else if (command == "--delete-search")
+    {
+        if (numberOfArguments != 1)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_DELETE_SEARCH);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_DELETE_SEARCH " + args[2]);
+        std::cout << "RESPONSE: " << response[0] << std::endl;
+        return 0;
+    }
+    else if (command == "--untagged")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        if (extractPageOptions(arguments, options) == false || arguments.size() != 0)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_UNTAGGED);
+            return 1;
+        }
+        std::cout << "UNTAGGED FILES:\n";
+        return printSearchResults("QH_UNTAGGED " + serializeSearchOptions(options), options);
+    }
+    else if (command == "--suggest-tags")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        uint64_t limit = 10;
+        if (extractNumber(arguments, "--limit", limit) == false || arguments.size() != 1)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_SUGGEST_TAGS);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_SUGGEST_TAGS " + std::to_string(limit)
+            + "," + arguments[0]);
+        if (response[0] == "Invalid")
+        {
+            std::cerr << "ERROR: Invalid path given.\n";
+            return 1;
+        }
+        std::cout << "SUGGESTED TAGS: " << std::endl;
+        if (response[0] == "")
+        {
+            std::cout << "\e[31mNo Tags Found\e[0m" << std::endl;
+            return 0;
+        }
+        for (auto suggestion : response)
+        {
+            std::cout << suggestion << std::endl;
+        }
+        return 0;
+    }
+    else if (command == "--changed-since" || command == "--tagged-since")
+    {
+        bool isChanged = (command == "--changed-since");
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+        int64_t since = 0;
+        if (extractPageOptions(arguments, options) == false || arguments.size() != 1
+            || parseTime(arguments[0], since) == false)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(isChanged ? QH_CHANGED_SINCE : QH_TAGGED_SINCE);
+            return 1;
+        }
+        std::string query = std::string(isChanged ? "QH_CHANGED_SINCE " : "QH_TAGGED_SINCE ")
+            + serializeSearchOptions(options) + "," + std::to_string(since);
+        std::cout << (isChanged ? "FILES CHANGED" : "FILES TAGGED") << " SINCE " << since
+            << ":\n";
+        return printSearchResults(query, options);
+    }
+    else if (command == "--removed-since")
+    {
+        int64_t since = 0;
+        if (args.size() != 3 || parseTime(args[2], since) == false)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_REMOVED_SINCE);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_REMOVED_SINCE "
+            + std::to_string(since));
+        std::cout << "PATHS REMOVED SINCE " << since << ":\n";
+        if (response[0] == "")
+        {
+            std::cout << "\e[31mNo Paths Found\e[0m" << std::endl;
+            return 0;
+        }
+        for (auto removal : response)
+        {
+            std::cout << removal << std::endl;
+        }
+        return 0;
+    }
+    else if (command == "--complete-tag")
+    {
+        std::vector<std::string> arguments(args.begin() + 2, args.end());
+        uint64_t limit = 10;
+        bool fuzzy = extractFlag(arguments, "--fuzzy");
+        if (extractNumber(arguments, "--limit", limit) == false || arguments.size() != 1)
+        {
+            std::cerr << "ERROR: Invalid arguments.\n";
+            displayHelp(QH_COMPLETE_TAG);
+            return 1;
+        }
+        std::vector<std::string> response = queryTFS("QH_COMPLETE_TAG " + std::to_string(limit)
+            + "," + (fuzzy ? "1" : "0") + "," + arguments[0]);
+        std::cout << "TAG COMPLETIONS: " << std::endl;
+        if (response[0] == "")
+        {
+            std::cout << "\e[31mNo Tags Found\e[0m" << std::endl;
+            return 0;
+        }
+        for (auto completion : response)
+        {
+            std::cout << completion << std::endl;
+        }
+        return 0;
+    }
     std::cerr << "ERROR: Invalid command and arguments. Use --help to see commands.\n";
     return 1;
 }
@@ -437,6 +988,26 @@ int QueryHandler::execute()
  * @return Response from the daemon.
  */
 std::vector<std::string> QueryHandler::queryTFS(std::string query)
+{
+    sendQuery(query);
+    std::vector<std::string> results;
+    std::string part;
+    bool complete;
+    do
+    {
+        complete = receiveResponse(part);
+        results.push_back(part);
+    } while (complete == false);
+
+    return results;
+}
+
+/**
+ * Sends query to the TaggableFS daemon without waiting for the response.
+ *
+ * @param query query to be sent.
+ */
+void QueryHandler::sendQuery(std::string query)
 {
     if (isTFSManagerResponding == false)
     {
@@ -446,17 +1017,69 @@ std::vector<std::string> QueryHandler::queryTFS(std::string query)
 
     serializeMessage(query.c_str(), buffer);
     mq_send(txMQ, buffer, TFS_MQ_MESSAGE_SIZE, 0);
+}
 
-    Message m;
-    std::vector<std::string> results;
-    do
-    {
-        mq_receive(rxMQ, buffer, TFS_MQ_MESSAGE_SIZE, NULL);
-        m = deserializeMessage(buffer);
-        results.push_back(std::string(m.content));
-    } while (m.complete == false);
+/**
+ * Receives the next part of the response from the TaggableFS daemon.
+ *
+ * @param part string where the received part is stored.
+ * @return Boolean indicating if it was the last part of the response.
+ */
+bool QueryHandler::receiveResponse(std::string &part)
+{
+    mq_receive(rxMQ, buffer, TFS_MQ_MESSAGE_SIZE, NULL);
+    Message m = deserializeMessage(buffer);
+    part = std::string(m.content);
+    return m.complete;
+}
 
-    return results;
+/**
+ * Sends search query to the TaggableFS daemon and prints the results as they are received.
+ * Results arrive in batches of lines followed by a summary with the number of results and
+ * the cursor to continue from if more results remain. Facets requested with the search arrive
+ * before the results and are printed after them.
+ *
+ * @param query search query to be sent.
+ * @param options options of the search.
+ * @return 0 after all results are printed.
+ */
+int QueryHandler::printSearchResults(std::string query, const SearchOptions &options)
+{
+    sendQuery(query);
+    std::string part;
+    bool complete = receiveResponse(part);
+    if (options.explain && complete == false)
+    {
+        std::cout << "\e[36mPlan:\e[0m\n" << part; // lines end with newlines
+        complete = receiveResponse(part);
+    }
+    std::string facets = "";
+    if (options.facets != 0 && complete == false)
+    {
+        facets = part;
+        complete = receiveResponse(part);
+    }
+    while (complete == false)
+    {
+        std::cout << part << std::flush;
+        complete = receiveResponse(part);
+    }
+    if (options.facets != 0)
+    {
+        std::cout << "\e[36mOther tags of the results:\e[0m\n"
+            << (facets.empty() ? "None\n" : facets);
+    }
+    std::vector<std::string> summary = splitAtFirstOccurance(part, ',');
+    if (summary[0] == "0")
+    {
+        std::cout << "\e[31mNo files Found\e[0m" << std::endl;
+    }
+    if (summary.size() == 2 && summary[1] != "")
+    {
+        std::cout << "\e[36mMore results available, continue with --cursor " << summary[1]
+            << "\e[0m" << std::endl;
+    }
+    return 0;
 }
 
 }
@@ -14,6 +14,7 @@
 
 #include "common.hpp"
 #include "TFSManager.hpp"
+#include "TagQuery.hpp"
 
 namespace TaggableFS
 {
@@ -49,10 +50,22 @@ private:
     /** Passed on to the TaggableFS daemon to mount the filesystem in tag view mode or not. */
     bool tagView;
 
+    /** Passed on to the TaggableFS daemon to bound catalog memory in MiB, 0 if unbounded. */
+    std::size_t memoryBudget;
+
+    /** Passed on to the TaggableFS daemon to name files in a new root with the given hash. */
+    std::string hashAlgorithm;
+
+    /** Passed on to the TaggableFS daemon to store large files in chunks or not. */
+    bool enableChunking;
+
     void initMQ();
     int initTFS();
     int shutdownTFS();
     std::vector<std::string> queryTFS(std::string query);
+    void sendQuery(std::string query);
+    bool receiveResponse(std::string &part);
+    int printSearchResults(std::string query, const SearchOptions &options);
 
 public:
     QueryHandler(int argc, char *argv[]);
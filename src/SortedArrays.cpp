@@ -0,0 +1,465 @@
+/**
+ * @file SortedArrays.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the SortedArrays class.
+ *
+ * @details This file contains the method definitions for the SortedArrays
+ * class. The vectorized intersection is based on "Fast Sorted-Set
+ * Intersection using SIMD Instructions" by Schlegel et al.
+ */
+
+#include "SortedArrays.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TFS_SORTEDARRAYS_SSE
+#endif
+
+/** Size ratio of two arrays above which the smaller array is searched for in the larger one. */
+#define TFS_GALLOP_RATIO 32
+
+namespace TaggableFS
+{
+
+namespace
+{
+
+/**
+ * Finds the first position at or after the given start holding a value not less than the
+ * target by doubling the step until it is passed and then searching the last step.
+ *
+ * @param values sorted array to be searched.
+ * @param start position from which to search.
+ * @param size number of values in the array.
+ * @param target value to be found.
+ * @return Position of the first value not less than the target, size if there is none.
+ */
+std::size_t gallop(const uint16_t *values, std::size_t start, std::size_t size, uint16_t target)
+{
+    if (start >= size || values[start] >= target)
+    {
+        return start;
+    }
+    std::size_t low = start, step = 1; // values[low] is always less than the target
+    while (low + step < size && values[low + step] < target)
+    {
+        low += step;
+        step <<= 1;
+    }
+    std::size_t high = std::min(low + step, size);
+    return std::lower_bound(values + low + 1, values + high, target) - values;
+}
+
+/**
+ * Intersects two sorted arrays by merging them.
+ *
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found in both are written, NULL to only count them.
+ * @return Number of values found in both arrays.
+ */
+std::size_t scalarIntersect(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    std::size_t i = 0, j = 0, k = 0;
+    while (i < sizeOfA && j < sizeOfB)
+    {
+        if (a[i] < b[j])
+        {
+            i++;
+        }
+        else if (b[j] < a[i])
+        {
+            j++;
+        }
+        else
+        {
+            if (result != NULL)
+            {
+                result[k] = a[i];
+            }
+            k++;
+            i++;
+            j++;
+        }
+    }
+    return k;
+}
+
+/**
+ * Intersects a small sorted array with a much larger one by galloping through the larger one.
+ *
+ * @param small smaller array.
+ * @param sizeOfSmall number of values in the smaller array.
+ * @param large larger array.
+ * @param sizeOfLarge number of values in the larger array.
+ * @param result array where the values found in both are written, NULL to only count them.
+ * @return Number of values found in both arrays.
+ */
+std::size_t gallopIntersect(const uint16_t *small, std::size_t sizeOfSmall,
+    const uint16_t *large, std::size_t sizeOfLarge, uint16_t *result)
+{
+    std::size_t j = 0, k = 0;
+    for (std::size_t i = 0; i < sizeOfSmall; i++)
+    {
+        j = gallop(large, j, sizeOfLarge, small[i]);
+        if (j == sizeOfLarge)
+        {
+            break;
+        }
+        if (large[j] == small[i])
+        {
+            if (result != NULL)
+            {
+                result[k] = small[i];
+            }
+            k++;
+        }
+    }
+    return k;
+}
+
+#ifdef TFS_SORTEDARRAYS_SSE
+
+/**
+ * A data type storing the byte shuffles which move the 16-bit lanes selected by each 8-bit
+ * mask to the front of a 128-bit register.
+ */
+struct PackingShuffles
+{
+    /** Shuffles indexed by mask. */
+    __m128i shuffles[256];
+
+    /**
+     * Constructor for the PackingShuffles struct.
+     */
+    PackingShuffles()
+    {
+        for (int mask = 0; mask < 256; mask++)
+        {
+            uint8_t bytes[16];
+            std::memset(bytes, 0x80, sizeof(bytes)); // zeroes unused lanes
+            int position = 0;
+            for (int lane = 0; lane < 8; lane++)
+            {
+                if ((mask >> lane) & 1)
+                {
+                    bytes[position++] = 2 * lane;
+                    bytes[position++] = 2 * lane + 1;
+                }
+            }
+            std::memcpy(&shuffles[mask], bytes, sizeof(bytes));
+        }
+    }
+};
+
+/**
+ * Gets the byte shuffles used to pack the values selected by a mask, building them once.
+ *
+ * @return Array of 256 shuffles indexed by mask.
+ */
+const __m128i *getPackingShuffles()
+{
+    static const PackingShuffles packing;
+    return packing.shuffles;
+}
+
+/**
+ * Checks if the processor supports the SSE4.2 string instructions.
+ *
+ * @return Boolean indicating if SSE4.2 is supported.
+ */
+bool hasSSE42()
+{
+    static const bool isSupported = __builtin_cpu_supports("sse4.2");
+    return isSupported;
+}
+
+/** Mode of the string comparison marking values of a block found anywhere in another block. */
+#define TFS_SSE_MODE (_SIDD_UWORD_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)
+
+/**
+ * Intersects two sorted arrays comparing blocks of eight values from each at a time and
+ * advancing the block with the smaller last value.
+ *
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found in both are written, NULL to only count them.
+ * @return Number of values found in both arrays.
+ */
+__attribute__((target("sse4.2")))
+std::size_t sseIntersect(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    const __m128i *shuffles = getPackingShuffles();
+    std::size_t i = 0, j = 0, k = 0;
+    while (i + 8 <= sizeOfA && j + 8 <= sizeOfB)
+    {
+        __m128i blockOfA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i blockOfB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        int mask = _mm_cvtsi128_si32(_mm_cmpestrm(blockOfB, 8, blockOfA, 8, TFS_SSE_MODE));
+        if (result != NULL)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(result + k),
+                _mm_shuffle_epi8(blockOfA, shuffles[mask]));
+        }
+        k += __builtin_popcount(mask);
+        uint16_t lastOfA = a[i + 7], lastOfB = b[j + 7];
+        if (lastOfA <= lastOfB)
+        {
+            i += 8;
+        }
+        if (lastOfB <= lastOfA)
+        {
+            j += 8;
+        }
+    }
+    // values of a compared with earlier blocks of b only match values of b after j
+    return k + scalarIntersect(a + i, sizeOfA - i, b + j, sizeOfB - j,
+        (result != NULL) ? result + k : NULL);
+}
+
+/**
+ * Subtracts the second sorted array from the first comparing blocks of eight values from each
+ * at a time. A block of the first array is written once no later block of the second array
+ * can contain its values.
+ *
+ * @param a array from which values are removed.
+ * @param sizeOfA number of values in the first array.
+ * @param b array of values to be removed.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found only in the first array are written.
+ * @return Number of values found only in the first array.
+ */
+__attribute__((target("sse4.2")))
+std::size_t sseSubtract(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    const __m128i *shuffles = getPackingShuffles();
+    std::size_t i = 0, j = 0, k = 0;
+    int found = 0; // values of the current block of a found in b so far
+    while (i + 8 <= sizeOfA && j + 8 <= sizeOfB)
+    {
+        __m128i blockOfA = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i blockOfB = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+        found |= _mm_cvtsi128_si32(_mm_cmpestrm(blockOfB, 8, blockOfA, 8, TFS_SSE_MODE));
+        uint16_t lastOfA = a[i + 7], lastOfB = b[j + 7];
+        if (lastOfA <= lastOfB)
+        {
+            int kept = ~found & 0xFF;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(result + k),
+                _mm_shuffle_epi8(blockOfA, shuffles[kept]));
+            k += __builtin_popcount(kept);
+            found = 0;
+            i += 8;
+        }
+        if (lastOfB <= lastOfA)
+        {
+            j += 8;
+        }
+    }
+    for (std::size_t p = i; p < sizeOfA; p++)
+    {
+        if (p < i + 8 && ((found >> (p - i)) & 1))
+        {
+            continue; // found in an earlier block of b
+        }
+        while (j < sizeOfB && b[j] < a[p])
+        {
+            j++;
+        }
+        if (j == sizeOfB || b[j] != a[p])
+        {
+            result[k++] = a[p];
+        }
+    }
+    return k;
+}
+
+#endif
+
+}
+
+/**
+ * Checks if the given intersection algorithm can be used on this processor.
+ *
+ * @param algorithm algorithm to be checked.
+ * @return Boolean indicating if the algorithm is supported.
+ */
+bool SortedArrays::isSupported(Algorithm algorithm)
+{
+#ifdef TFS_SORTEDARRAYS_SSE
+    return algorithm != SSE42 || hasSSE42();
+#else
+    return algorithm != SSE42;
+#endif
+}
+
+/**
+ * Intersects two sorted arrays with the given algorithm, used to compare the algorithms.
+ *
+ * @param algorithm algorithm to be used, merging if it isn't supported.
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found in both are written, NULL to only count them.
+ * @return Number of values found in both arrays.
+ */
+std::size_t SortedArrays::intersect(Algorithm algorithm, const uint16_t *a, std::size_t sizeOfA,
+    const uint16_t *b, std::size_t sizeOfB, uint16_t *result)
+{
+    if (algorithm == GALLOP)
+    {
+        return (sizeOfA <= sizeOfB) ? gallopIntersect(a, sizeOfA, b, sizeOfB, result)
+            : gallopIntersect(b, sizeOfB, a, sizeOfA, result);
+    }
+#ifdef TFS_SORTEDARRAYS_SSE
+    if (algorithm == SSE42 && hasSSE42())
+    {
+        return sseIntersect(a, sizeOfA, b, sizeOfB, result);
+    }
+#endif
+    return scalarIntersect(a, sizeOfA, b, sizeOfB, result);
+}
+
+/**
+ * Intersects two sorted arrays.
+ *
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found in both are written.
+ * @return Number of values found in both arrays.
+ */
+std::size_t SortedArrays::intersect(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    if (sizeOfA * TFS_GALLOP_RATIO < sizeOfB)
+    {
+        return gallopIntersect(a, sizeOfA, b, sizeOfB, result);
+    }
+    if (sizeOfB * TFS_GALLOP_RATIO < sizeOfA)
+    {
+        return gallopIntersect(b, sizeOfB, a, sizeOfA, result);
+    }
+#ifdef TFS_SORTEDARRAYS_SSE
+    if (hasSSE42())
+    {
+        return sseIntersect(a, sizeOfA, b, sizeOfB, result);
+    }
+#endif
+    return scalarIntersect(a, sizeOfA, b, sizeOfB, result);
+}
+
+/**
+ * Counts the values found in both of two sorted arrays without storing them.
+ *
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @return Number of values found in both arrays.
+ */
+std::size_t SortedArrays::countIntersection(const uint16_t *a, std::size_t sizeOfA,
+    const uint16_t *b, std::size_t sizeOfB)
+{
+    return intersect(a, sizeOfA, b, sizeOfB, NULL);
+}
+
+/**
+ * Unites two sorted arrays. Runs of the larger array between the values of a much smaller
+ * array are copied whole.
+ *
+ * @param a first array.
+ * @param sizeOfA number of values in the first array.
+ * @param b second array.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found in either array are written.
+ * @return Number of values found in either array.
+ */
+std::size_t SortedArrays::unite(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    if (sizeOfA * TFS_GALLOP_RATIO < sizeOfB || sizeOfB * TFS_GALLOP_RATIO < sizeOfA)
+    {
+        const uint16_t *small = (sizeOfA < sizeOfB) ? a : b;
+        const uint16_t *large = (sizeOfA < sizeOfB) ? b : a;
+        std::size_t sizeOfSmall = std::min(sizeOfA, sizeOfB);
+        std::size_t sizeOfLarge = std::max(sizeOfA, sizeOfB);
+        std::size_t j = 0, k = 0;
+        for (std::size_t i = 0; i < sizeOfSmall; i++)
+        {
+            std::size_t next = gallop(large, j, sizeOfLarge, small[i]);
+            std::copy(large + j, large + next, result + k);
+            k += next - j;
+            j = next;
+            result[k++] = small[i];
+            if (j < sizeOfLarge && large[j] == small[i])
+            {
+                j++;
+            }
+        }
+        std::copy(large + j, large + sizeOfLarge, result + k);
+        return k + sizeOfLarge - j;
+    }
+    return std::set_union(a, a + sizeOfA, b, b + sizeOfB, result) - result;
+}
+
+/**
+ * Subtracts the second sorted array from the first.
+ *
+ * @param a array from which values are removed.
+ * @param sizeOfA number of values in the first array.
+ * @param b array of values to be removed.
+ * @param sizeOfB number of values in the second array.
+ * @param result array where the values found only in the first array are written.
+ * @return Number of values found only in the first array.
+ */
+std::size_t SortedArrays::subtract(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+    std::size_t sizeOfB, uint16_t *result)
+{
+    std::size_t k = 0;
+    if (sizeOfA * TFS_GALLOP_RATIO < sizeOfB) // search for each value of a in b
+    {
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < sizeOfA; i++)
+        {
+            j = gallop(b, j, sizeOfB, a[i]);
+            if (j == sizeOfB || b[j] != a[i])
+            {
+                result[k++] = a[i];
+            }
+        }
+        return k;
+    }
+    if (sizeOfB * TFS_GALLOP_RATIO < sizeOfA) // copy the runs of a between values of b
+    {
+        std::size_t i = 0;
+        for (std::size_t j = 0; j < sizeOfB; j++)
+        {
+            std::size_t next = gallop(a, i, sizeOfA, b[j]);
+            std::copy(a + i, a + next, result + k);
+            k += next - i;
+            i = (next < sizeOfA && a[next] == b[j]) ? next + 1 : next;
+        }
+        std::copy(a + i, a + sizeOfA, result + k);
+        return k + sizeOfA - i;
+    }
+#ifdef TFS_SORTEDARRAYS_SSE
+    if (hasSSE42())
+    {
+        return sseSubtract(a, sizeOfA, b, sizeOfB, result);
+    }
+#endif
+    return std::set_difference(a, a + sizeOfA, b, b + sizeOfB, result) - result;
+}
+
+}
@@ -0,0 +1,54 @@
+/**
+ * @file SortedArrays.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the SortedArrays class.
+ *
+ * @details This file contains the class definition for the SortedArrays
+ * class. The SortedArrays class provides set operations over sorted arrays of
+ * 16-bit integers as stored in the array containers of the Bitmap class. Arrays
+ * of similar sizes are compared eight values at a time with SSE4.2 string
+ * instructions when the processor supports them and arrays of very different
+ * sizes are searched with galloping so that searches with both common and rare
+ * tags stay fast.
+ */
+
+#ifndef TFS_SORTEDARRAYS_HPP
+#define TFS_SORTEDARRAYS_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+namespace TaggableFS
+{
+
+/**
+ * This class operates on sorted arrays of unique 16-bit integers. Results are written to the
+ * given output array which needs room for the size of the result plus 8 values.
+ */
+class SortedArrays
+{
+public:
+    /** Algorithms intersecting two arrays, chosen by the sizes of the arrays unless given. */
+    enum Algorithm
+    {
+        MERGE,
+        SSE42,
+        GALLOP
+    };
+
+    static bool isSupported(Algorithm algorithm);
+    static std::size_t intersect(Algorithm algorithm, const uint16_t *a, std::size_t sizeOfA,
+        const uint16_t *b, std::size_t sizeOfB, uint16_t *result);
+    static std::size_t intersect(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+        std::size_t sizeOfB, uint16_t *result);
+    static std::size_t countIntersection(const uint16_t *a, std::size_t sizeOfA,
+        const uint16_t *b, std::size_t sizeOfB);
+    static std::size_t unite(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+        std::size_t sizeOfB, uint16_t *result);
+    static std::size_t subtract(const uint16_t *a, std::size_t sizeOfA, const uint16_t *b,
+        std::size_t sizeOfB, uint16_t *result);
+};
+
+}
+
+#endif
@@ -18,6 +18,55 @@
     sqlite3_bind_parameter_index(stmt, (std::string("@") + #text).c_str()), \
     std::stoi(text))
 
+/** Macro to simplify code to bind a string containing binary data to the given sqlite statement. */
+#define macro_bind_blob(stmt, blob) sqlite3_bind_blob(stmt, \
+    sqlite3_bind_parameter_index(stmt, (std::string("@") + #blob).c_str()), \
+    blob.data(), blob.size(), SQLITE_STATIC)
+
+/** Macro to simplify code to bind a 64-bit integer to the given sqlite statement. */
+#define macro_bind_int64(stmt, value) sqlite3_bind_int64(stmt, \
+    sqlite3_bind_parameter_index(stmt, (std::string("@") + #value).c_str()), value)
+
+/**
+ * Hash algorithm naming the files of new root directories. SHA-256 is hashed in hardware by
+ * CPUs with SHA extensions, making it faster there than MD5 and BLAKE2 in libcrypto.
+ */
+#define TFS_DEFAULT_HASH_ALGORITHM "sha256"
+
+/** Capacity in bytes of the cache of query directory results if memory isn't bounded. */
+#define TFS_QUERY_CACHE_CAPACITY (64 << 20)
+
+/** Number of search results whose filenames are resolved before being sent together. */
+#define TFS_SEARCH_BATCH_SIZE 256
+
+/** Number of search results whose sort keys are read at a time when sorting them. */
+#define TFS_SORT_BATCH_SIZE 4096
+
+/** Number of files whose filenames are read with a single query when listing directories. */
+#define TFS_FILENAME_BATCH_SIZE 4096
+
+/** Number of files or chunks moved between messages while the layout is migrated. */
+#define TFS_MIGRATION_BATCH_SIZE 256
+
+/** Number of containers in the bitmaps of a search above which it is split across threads. */
+#define TFS_PARALLEL_MIN_CONTAINERS 64
+
+/** Name of the directory listing files without any tags under the root in tag view mode. */
+#define TFS_UNTAGGED_DIRECTORY "@untagged"
+
+/** Minimum size in bytes of written files hashed in the background, smaller files are hashed
+ * before their release returns. */
+#define TFS_BACKGROUND_HASH_MIN_SIZE (4 << 20)
+
+/** Number of threads hashing written files in the background. */
+#define TFS_HASHING_THREADS 2
+
+/** Prefix of the names written files are stored under until their hash values are known. */
+#define TFS_PENDING_HASH_PREFIX "PENDING"
+
+/** Size in bytes of the buffers a written file is compared with the stored file in. */
+#define TFS_COMPARE_BUFFER_SIZE (128 << 10)
+
 namespace TaggableFS
 {
 
@@ -32,6 +81,7 @@ enum SQLitePreparedStatementObjects
     GET_FILE_IDS_IN_FOLDER,
     GET_FILENAME_FROM_ID,
     GET_FOLDER_ID,
+    GET_FOLDER_NAME_AND_PARENT,
     GET_HASH,
     IS_FOLDER_EMPTY,
     UPDATE_HASH,
@@ -43,12 +93,9 @@ enum SQLitePreparedStatementObjects
     RENAME_PATH_1,
     RENAME_PATH_2,
     ADD_TEMPORARY_FILE,
-    GET_TAG_ID,
     GET_TAG_NAME_FROM_ID,
     GET_ALL_TAG_IDS,
     GET_PARENT_TAG_IDS,
-    GET_CHILD_TAG_IDS,
-    GET_FILE_IDS_UNDER_TAG_ID,
     GET_TAGGED_FILE_PATH,
     UPDATE_PARENT_TAG_IDS,
     UPDATE_CHILD_TAG_IDS,
@@ -58,13 +105,39 @@ enum SQLitePreparedStatementObjects
     GET_FILE_TAGS,
     RENAME_TAGGED_PATH,
     COUNT_HASH_GT_0,
-    COUNT_HASH_GT_1
+    COUNT_HASH_GT_1,
+    FIND_FILES_BY_NAME,
+    UPDATE_FILE_ATTRIBUTES,
+    SAVE_SEARCH,
+    DELETE_SAVED_SEARCH,
+    UPDATE_SAVED_SEARCH_FILE_IDS,
+    UPDATE_TAGGED_AT,
+    FIND_CHANGED_FILES,
+    FIND_TAGGED_FILES,
+    ADD_CHUNK,
+    UPDATE_CHUNK_REFERENCES,
+    GET_CHUNK_REFERENCES,
+    DELETE_CHUNK,
+    COUNT_CHUNKS,
+    GET_ALL_HASHES,
+    GET_ALL_CHUNKS,
+    GET_FILE_IDS_WITH_HASH,
+    GET_PENDING_HASHES,
+    GET_FILE_IDS_BY_FILENAME,
+    MARK_FOLDER_MOVED,
+    ADD_REMOVED_PATH,
+    FIND_REMOVED_PATHS,
+    UPDATE_TAG_COOCCURRENCE,
+    DELETE_EMPTY_TAG_COOCCURRENCE,
+    DELETE_TAG_COOCCURRENCES,
+    GET_TAG_COOCCURRENCES,
+    GET_TAG_COOCCURRENCE
 };
 
 /**
  * Constant to store the total number of SQLite prepared statement objects.
  */
-const int NUMBER_OF_SQLITE_PSO = 33;
+const int NUMBER_OF_SQLITE_PSO = 57;
 
 /**
  * Array of SQLite prepared statement objects to be used in the program to avoid possible SQL
@@ -90,6 +163,8 @@ void TFSManager::prepareStatements()
         /* GET_FILENAME_FROM_ID */ "SELECT filename FROM files WHERE file_id=@fileID;",
         /* GET_FOLDER_ID */ "SELECT tag_id FROM tags WHERE tag_name=@folderName AND "
             "parent_folder=@parentFolderID;",
+        /* GET_FOLDER_NAME_AND_PARENT */ "SELECT tag_name, parent_folder FROM tags WHERE "
+            "tag_id=@folderID;",
         /* GET_HASH */ "SELECT hash FROM files WHERE filename=@filename AND "
             "parent_folder=@parentFolderID;",
         /* IS_FOLDER_EMPTY */ "SELECT COUNT(*) > 0 FROM files WHERE parent_folder=@folderID;",
@@ -100,31 +175,74 @@ void TFSManager::prepareStatements()
             "( @newFolderName, @parentFolderID );",
         /* DELETE_FOLDER */ "DELETE FROM tags WHERE tag_id=@folderID;",
         /* DELETE_FILE */ "DELETE FROM files WHERE file_id=@fileID;",
-        /* RENAME_PATH_1 */ "UPDATE files SET filename=@newName, parent_folder=@newParentFolderID "
-            "WHERE file_id=@oldFileID;",
+        /* RENAME_PATH_1 */ "UPDATE files SET filename=@newName, parent_folder=@newParentFolderID, "
+            "moved_at=@movedAt WHERE file_id=@oldFileID;",
         /* RENAME_PATH_2 */ "UPDATE tags SET tag_name=@newName, parent_folder=@newParentFolderID "
             "WHERE tag_id=@oldFolderID;",
-        /* ADD_TEMPORARY_FILE */ "INSERT INTO files ( filename, hash, parent_folder ) VALUES "
-            "( @filename, @tempFilename, @parentFolderID );",
-        /* GET_TAG_ID */ "SELECT tag_id FROM tags WHERE tag_name=@tag AND parent_folder='0';",
+        /* ADD_TEMPORARY_FILE */ "INSERT INTO files ( filename, hash, parent_folder, added_at ) "
+            "VALUES ( @filename, @tempFilename, @parentFolderID, @addedAt );",
         /* GET_TAG_NAME_FROM_ID */ "SELECT tag_name FROM tags WHERE tag_id=@tagID;",
         /* GET_ALL_TAG_IDS */ "SELECT tag_id FROM tags WHERE parent_folder='0';",
         /* GET_PARENT_TAG_IDS */ "SELECT parent_tags FROM tags WHERE tag_id=@tagID;",
-        /* GET_CHILD_TAG_IDS */ "SELECT child_tags FROM tags WHERE tag_id=@tagID;",
-        /* GET_FILE_IDS_UNDER_TAG_ID */ "SELECT files_ids FROM tags WHERE tag_id=@tagID;",
         /* GET_TAGGED_FILE_PATH */ "SELECT hash FROM files WHERE file_id=@fileID;",
         /* UPDATE_PARENT_TAG_IDS */ "UPDATE tags SET parent_tags=@serializedIDs WHERE "
             "tag_id=@tagID;",
         /* UPDATE_CHILD_TAG_IDS */ "UPDATE tags SET child_tags=@serializedIDs WHERE "
             "tag_id=@tagID;",
         /* CREATE_TAG */ "INSERT INTO tags ( tag_name, parent_folder, parent_tags, child_tags, "
-            "files_ids ) VALUES ( @tag, '0', @parentTags, '', '' );",
+            "files_ids, files_bitmap ) VALUES ( @tag, '0', @parentTags, '', '', X'' );",
         /* DELETE_TAG */ "DELETE FROM tags WHERE tag_id=@tagID;",
-        /* UPDATE_TAG_FILE_IDS */ "UPDATE tags SET files_ids=@serializedIDs WHERE tag_id=@tagID;",
-        /* GET_FILE_TAGS */ "SELECT tag_id, tag_name, files_ids FROM tags WHERE parent_folder='0';",
+        /* UPDATE_TAG_FILE_IDS */ "UPDATE tags SET files_bitmap=@serializedIDs, files_ids='' "
+            "WHERE tag_id=@tagID;",
+        /* GET_FILE_TAGS */ "SELECT tag_id, tag_name FROM tags WHERE parent_folder='0';",
         /* RENAME_TAGGED_PATH */ "UPDATE tags SET tag_name=@newName WHERE tag_id=@oldTagID;",
-        /* COUNT_HASH_GT_0 */ "SELECT COUNT(*) > 0 FROM files WHERE hash=@oldhash;",
-        /* COUNT_HASH_GT_1 */ "SELECT COUNT(*) > 1 FROM files WHERE hash=@hash;"
+        /* COUNT_HASH_GT_0 */ "SELECT COUNT(*) > 0 FROM files WHERE hash=@oldHash;",
+        /* COUNT_HASH_GT_1 */ "SELECT COUNT(*) > 1 FROM files WHERE hash=@hash;",
+        /* FIND_FILES_BY_NAME */ std::string("SELECT rowid, filename FROM ")
+            + (isFilenameIndexed ? "files_fts" : "files") + " WHERE filename LIKE @likePattern;",
+        /* UPDATE_FILE_ATTRIBUTES */ "UPDATE files SET size=@size, mtime=@mtime WHERE "
+            "file_id=@fileID;",
+        /* SAVE_SEARCH */ "INSERT OR REPLACE INTO saved_searches ( name, query, recursive, "
+            "files_bitmap ) VALUES ( @name, @serializedQuery, @isRecursive, @serializedIDs );",
+        /* DELETE_SAVED_SEARCH */ "DELETE FROM saved_searches WHERE name=@name;",
+        /* UPDATE_SAVED_SEARCH_FILE_IDS */ "UPDATE saved_searches SET files_bitmap=@serializedIDs "
+            "WHERE name=@name;",
+        /* UPDATE_TAGGED_AT */ "UPDATE files SET tagged_at=@taggedAt WHERE file_id=@fileID;",
+        /* FIND_CHANGED_FILES */ "SELECT file_id FROM files WHERE added_at>=@since UNION "
+            "SELECT file_id FROM files WHERE mtime>=@since UNION "
+            "SELECT file_id FROM files WHERE moved_at>=@since;",
+        /* FIND_TAGGED_FILES */ "SELECT file_id FROM files WHERE tagged_at>=@since;",
+        /* ADD_CHUNK */ "INSERT OR IGNORE INTO chunks ( hash, refs ) VALUES ( @chunkHash, 0 );",
+        /* UPDATE_CHUNK_REFERENCES */ "UPDATE chunks SET refs=refs+@change WHERE "
+            "hash=@chunkHash;",
+        /* GET_CHUNK_REFERENCES */ "SELECT refs FROM chunks WHERE hash=@chunkHash;",
+        /* DELETE_CHUNK */ "DELETE FROM chunks WHERE hash=@chunkHash;",
+        /* COUNT_CHUNKS */ "SELECT COUNT(*) FROM chunks;",
+        /* GET_ALL_HASHES */ "SELECT DISTINCT hash FROM files;",
+        /* GET_ALL_CHUNKS */ "SELECT hash FROM chunks;",
+        /* GET_FILE_IDS_WITH_HASH */ "SELECT file_id FROM files WHERE hash=@hash;",
+        /* GET_PENDING_HASHES */ "SELECT DISTINCT hash FROM files WHERE hash LIKE '"
+            TFS_PENDING_HASH_PREFIX "%';",
+        /* GET_FILE_IDS_BY_FILENAME */ "SELECT file_id FROM files WHERE filename=@filename;",
+        /* MARK_FOLDER_MOVED */ "WITH RECURSIVE moved ( folder_id ) AS ( SELECT @oldFolderID "
+            "UNION SELECT tag_id FROM tags JOIN moved ON parent_folder=folder_id ) "
+            "UPDATE files SET moved_at=@movedAt WHERE parent_folder IN moved;",
+        /* ADD_REMOVED_PATH */ "INSERT INTO removed_paths ( path, removed_at ) VALUES "
+            "( @path, @removedAt );",
+        /* FIND_REMOVED_PATHS */ "SELECT removed_at, path FROM removed_paths WHERE "
+            "removed_at>=@since ORDER BY removed_at, rowid;",
+        /* UPDATE_TAG_COOCCURRENCE */ "INSERT INTO tag_cooccurrences ( tag_id, other_tag_id, "
+            "files ) VALUES ( @tagID, @otherTagID, @change ) ON CONFLICT ( tag_id, other_tag_id ) "
+            "DO UPDATE SET files=files+@change;",
+        /* DELETE_EMPTY_TAG_COOCCURRENCE */ "DELETE FROM tag_cooccurrences WHERE tag_id=@tagID "
+            "AND other_tag_id=@otherTagID AND files<=0;",
+        /* DELETE_TAG_COOCCURRENCES */ "DELETE FROM tag_cooccurrences WHERE tag_id=@tagID OR "
+            "other_tag_id=@tagID;",
+        /* GET_TAG_COOCCURRENCES */ "SELECT other_tag_id, files FROM tag_cooccurrences WHERE "
+            "tag_id=@tagID UNION ALL SELECT tag_id, files FROM tag_cooccurrences WHERE "
+            "other_tag_id=@tagID;",
+        /* GET_TAG_COOCCURRENCE */ "SELECT files FROM tag_cooccurrences WHERE tag_id=@tagID AND "
+            "other_tag_id=@otherTagID;"
     };
 
     for (auto i = 0; i < NUMBER_OF_SQLITE_PSO; i++)
@@ -157,12 +275,25 @@ void TFSManager::finalizeStatements()
  * @param programName name of the program creating the daemon.
  * @param enableLogging boolean to enable/disable logging.
  * @param tagView boolean to enable/disable tag view mode.
+ * @param memoryBudget memory budget for the catalog in MiB, 0 to load it into memory.
+ * @param hashAlgorithm hash algorithm for a new root directory, empty to use the default.
+ * @param enableChunking boolean to store large files in chunks from now on.
  */
 TFSManager::TFSManager(std::string mountPoint, std::string rootDirectory,
-                       std::string programName, bool enableLogging, bool tagView)
+                       std::string programName, bool enableLogging, bool tagView,
+                       std::size_t memoryBudget, std::string hashAlgorithm, bool enableChunking)
         : mountPoint(mountPoint), rootDirectory(rootDirectory), programName(programName),
-          db(NULL), enableLogging(enableLogging), tagView(tagView)
+          db(NULL), enableLogging(enableLogging), tagView(tagView), memoryBudget(memoryBudget),
+          hashAlgorithm(hashAlgorithm), enableChunking(enableChunking), isFilenameIndexed(true),
+          isCooccurrenceCountNeeded(false),
+          chunkStore(rootDirectory), layout("flat"), tagNamesGeneration(0), allFilesGeneration(0),
+          // seeded with the time so that names aren't reused by files left pending by a restart
+          pendingHashNumber(uint64_t(time(NULL)) << 20), searchCacheHits(0), searchCacheMisses(0),
+          numberOfSearches(0), totalTimeToFirstResult(0)
 {
+    // a quarter of the memory budget is given to cached search results and the indexes
+    searchCache.setCapacity((memoryBudget == 0) ? TFS_QUERY_CACHE_CAPACITY
+        : (memoryBudget << 20) / 4);
 }
 
 /**
@@ -210,6 +341,17 @@ void TFSManager::startDaemon()
     initMQ();
     initDB();
     initFUSEFileSystem();
+    // started after forking the FUSE driver, the calling thread counts as one of the threads
+    workerPool.start(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    hashingPool.start(TFS_HASHING_THREADS, hasher.getAlgorithm(),
+        enableChunking ? &chunkStore : NULL, [this](std::string pendingName, std::string newHash)
+        {
+            // own buffer, the daemon's buffer is used by its thread
+            char message[TFS_MQ_MESSAGE_SIZE];
+            serializeMessage(("TM_HASH_DONE " + pendingName + "," + newHash).c_str(), message);
+            return mq_send(txManagerMQ, message, TFS_MQ_MESSAGE_SIZE, 0) == 0;
+        });
+    resumePendingHashes();
     run();
     shutdown();
     exit(EXIT_SUCCESS);
@@ -247,8 +389,10 @@ void TFSManager::initMQ()
     txFUSEMQ = mq_open("/tfs_fusemq", O_WRONLY | O_CREAT | O_EXCL, 0660, &attr);
     txQueryMQ = mq_open("/tfs_querymq", O_WRONLY | O_CREAT | O_EXCL, 0660, &attr);
     rxMQ = mq_open("/tfs_managermq", O_RDONLY | O_CREAT | O_EXCL, 0660, &attr);
+    // non-blocking so that a full queue can't keep the hashing threads from stopping
+    txManagerMQ = mq_open("/tfs_managermq", O_WRONLY | O_NONBLOCK);
     umask(existingMask);
-    if ( txFUSEMQ == -1 || txQueryMQ == -1 || rxMQ == -1 )
+    if ( txFUSEMQ == -1 || txQueryMQ == -1 || rxMQ == -1 || txManagerMQ == -1 )
     {
         log("TFSManager mq_open() failed");
         exit(EXIT_FAILURE);
@@ -263,7 +407,8 @@ void TFSManager::initFUSEFileSystem()
     int pid = fork();
     if (pid == 0)
     {
-        FUSEFileSystem fuseDriver(mountPoint, programName, enableLogging);
+        FUSEFileSystem fuseDriver(mountPoint, rootDirectory, programName, enableLogging,
+            hasher.getAlgorithm());
         exit(EXIT_SUCCESS);
     }
 }
@@ -285,7 +430,12 @@ std::string TFSManager::dbExecuteSV(sqlite3_stmt *stmt)
     // log("TFSManager sqlite3_step() in dbExecuteSV() done, sqlite3_errmsg() -> " +
     //     std::string(sqlite3_errmsg(db)));
     sqlite3_reset(stmt);
-    log(std::string("PSO ") + sqlite3_expanded_sql(stmt) + " -> " + value);
+    if (enableLogging == true) // avoid expanding statements with large bound values
+    {
+        char *sql = sqlite3_expanded_sql(stmt);
+        log(std::string("PSO ") + sql + " -> " + value);
+        sqlite3_free(sql);
+    }
     return value;
 }
 
@@ -306,8 +456,12 @@ std::vector<std::string> TFSManager::dbExecuteMV(sqlite3_stmt *stmt)
     // log("TFSManager sqlite3_step() in dbExecuteMV() done, sqlite3_errmsg() -> " +
     //     std::string(sqlite3_errmsg(db)));
     sqlite3_reset(stmt);
-    log(std::string("PSO ") + sqlite3_expanded_sql(stmt) + " -> 0:" +
-        (values.empty() ? "" : values[0]));
+    if (enableLogging == true)
+    {
+        char *sql = sqlite3_expanded_sql(stmt);
+        log(std::string("PSO ") + sql + " -> 0:" + (values.empty() ? "" : values[0]));
+        sqlite3_free(sql);
+    }
     return values;
 }
 
@@ -334,8 +488,13 @@ std::vector<std::vector<std::string>> TFSManager::dbExecuteMR(sqlite3_stmt *stmt
     // log("TFSManager sqlite3_step() in dbExecuteMR() done, sqlite3_errmsg() -> " +
     //     std::string(sqlite3_errmsg(db)));
     sqlite3_reset(stmt);
-    log(std::string("PSO ") + sqlite3_expanded_sql(stmt) + " -> 0:" +
-        (rows.empty() ? "" : serializeStrings(rows[0], ',')));
+    if (enableLogging == true)
+    {
+        char *sql = sqlite3_expanded_sql(stmt);
+        log(std::string("PSO ") + sql + " -> 0:" +
+            (rows.empty() ? "" : serializeStrings(rows[0], ',')));
+        sqlite3_free(sql);
+    }
     return rows;
 }
 
@@ -406,29 +565,120 @@ void TFSManager::saveDBToStorage()
 }
 
 /**
- * Initializes metadata database by creating database or loading from database file.
+ * Bounds the memory used by a catalog kept on disk. Half of the memory budget is given to
+ * SQLite's page cache and a quarter to memory mapped reads of the database file, leaving the
+ * rest for caches kept by the daemon.
+ */
+void TFSManager::configureCatalogMemory()
+{
+    sqlite3_int64 budget = static_cast<sqlite3_int64>(memoryBudget) * 1024 * 1024;
+    sqlite3_soft_heap_limit64(budget / 2);
+    const std::string statement = "PRAGMA cache_size=-" + std::to_string(budget / 2048) + ";"
+        "PRAGMA mmap_size=" + std::to_string(budget / 4) + ";"
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "PRAGMA temp_store=FILE;";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Estimates the memory used by the indexes kept in memory alongside the catalog: tag bitmaps,
+ * file attributes, tag counts, tag co-occurrences, the tag name index and saved searches. With
+ * a memory budget, file attributes, tag counts and tag co-occurrences are read from the catalog
+ * instead and the rest is taken out of the share of the budget given to cached search results.
+ *
+ * @return Estimated number of bytes used by the indexes.
+ */
+std::size_t TFSManager::getIndexMemoryUsage()
+{
+    std::size_t bytes = allFileIDs.memoryUsage() + untaggedFileIDs.memoryUsage()
+        + fileAttributes.capacity() * sizeof(FileAttributes)
+        + fileTagCounts.capacity() * sizeof(uint32_t);
+    for (auto &membership : tagMemberships)
+    {
+        bytes += membership.first.capacity() + membership.second.memoryUsage();
+    }
+    for (auto &children : tagChildren)
+    {
+        bytes += children.first.capacity();
+        for (auto &childTagID : children.second)
+        {
+            bytes += sizeof(std::string) + childTagID.capacity();
+        }
+    }
+    for (auto &entry : tagNameIndex)
+    {
+        bytes += sizeof(entry) + entry.first.capacity() + entry.second.capacity();
+    }
+    for (auto &counts : tagCooccurrences)
+    {
+        bytes += counts.first.capacity();
+        for (auto &count : counts.second)
+        {
+            bytes += sizeof(count) + count.first.capacity();
+        }
+    }
+    for (auto &savedSearch : savedSearches)
+    {
+        bytes += savedSearch.first.capacity() + savedSearch.second.matches.memoryUsage();
+    }
+    return bytes;
+}
+
+/**
+ * Gives the search cache the share of the memory budget left by the indexes kept in memory, so
+ * that the budget bounds both. Nothing is done without a memory budget.
+ */
+void TFSManager::fitSearchCacheToBudget()
+{
+    if (memoryBudget == 0)
+    {
+        return;
+    }
+    std::size_t share = (memoryBudget << 20) / 4;
+    searchCache.setCapacity(share - std::min(share, getIndexMemoryUsage()));
+}
+
+/**
+ * Initializes metadata database by creating database or loading from database file. If a
+ * memory budget is given, the database file is used in place instead of being loaded into
+ * an in-memory database.
  */
 void TFSManager::initDB()
 {
     sqlite3_initialize();
 
     bool dbExists = (access(dbPath.c_str(), F_OK) == 0);
-    if (sqlite3_open(":memory:", &db) != SQLITE_OK)
+    std::string dbLocation = (memoryBudget == 0) ? ":memory:" : dbPath;
+    if (sqlite3_open(dbLocation.c_str(), &db) != SQLITE_OK)
     {
         log("TFSManager sqlite3_open() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
         exit(EXIT_FAILURE);
     }
+    if (memoryBudget != 0)
+    {
+        configureCatalogMemory();
+    }
     if (!dbExists) // create tables
     {
         const std::string statement = "CREATE TABLE tags ( tag_id INTEGER PRIMARY KEY NOT NULL, "
                 "tag_name text NOT NULL, parent_folder INTEGER NOT NULL, "
-                "parent_tags TEXT, child_tags TEXT, files_ids TEXT, "
+                "parent_tags TEXT, child_tags TEXT, files_ids TEXT, files_bitmap BLOB, "
                 "FOREIGN KEY(parent_folder) REFERENCES tags(tag_id) );"
             "CREATE TABLE files ( file_id INTEGER PRIMARY KEY NOT NULL, "
                 "filename TEXT NOT NULL, hash TEXT NOT NULL, parent_folder INTEGER, "
+                "size INTEGER NOT NULL DEFAULT 0, mtime INTEGER NOT NULL DEFAULT 0, "
+                "added_at INTEGER NOT NULL DEFAULT 0, tagged_at INTEGER NOT NULL DEFAULT 0, "
+                "moved_at INTEGER NOT NULL DEFAULT 0, "
                 "FOREIGN KEY(parent_folder) REFERENCES tags(tag_id) );"
             "INSERT INTO tags ( tag_id, tag_name, parent_folder, parent_tags, "
-                "child_tags, files_ids ) VALUES ( 0, '__TaggableFS__//', '-1', '', '', '' );"
+                "child_tags, files_ids, files_bitmap ) VALUES "
+                "( 0, '__TaggableFS__//', '-1', '', '', '', X'' );"
             "INSERT INTO tags ( tag_id, tag_name, parent_folder, parent_tags, "
                 "child_tags, files_ids ) VALUES ( 1, '/', '-1', '', '', '' );";
         log(statement);
@@ -438,903 +688,2629 @@ void TFSManager::initDB()
             log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
             exit(EXIT_FAILURE);
         }
+        createFilenameIndex();
+        createChangeIndexes();
+        createRemovalTracking();
+        createFilenameLookupIndex();
+        createSavedSearchesTable();
+        createChunksTable();
+        createTagCooccurrencesTable();
+        createSizeIndex();
         // insert initial values for variables
+        createVariablesTable((hashAlgorithm == "") ? TFS_DEFAULT_HASH_ALGORITHM : hashAlgorithm,
+            "sharded");
     }
     else // retreive values
     {
-        loadDBFromStorage();
-        // retrieve variables
+        if (memoryBudget == 0)
+        {
+            loadDBFromStorage();
+        }
+        upgradeDB();
     }
+    loadVariables(); // retrieve variables
     prepareStatements(); // ready SQLite prepared statements
+    loadTags();
+    loadAllFileIDs();
+    countFileTags();
+    if (isCooccurrenceCountNeeded)
+    {
+        countTagCooccurrences();
+    }
+    if (memoryBudget == 0) // else read from the catalog when needed
+    {
+        loadTagCooccurrences();
+    }
+    loadSavedSearches();
+    fitSearchCacheToBudget();
+    if (layout == "migrating") // resume migration interrupted when the daemon stopped
+    {
+        migrateLayout();
+    }
 }
 
 /**
- * Shuts down TaggableFS by unmounting FUSE filesystem, closing and deleting message queues,
- * saving database to file and closing the log file.
+ * Upgrades database created by an older version of TaggableFS by adding missing columns.
  */
-void TFSManager::shutdown()
+void TFSManager::upgradeDB()
 {
-    fuse_unmount(mountPoint.c_str(), NULL);
-
-    mq_close(txFUSEMQ);
-    mq_unlink("/tfs_fusemq");
-    mq_close(txQueryMQ);
-    mq_unlink("/tfs_querymq");
-    mq_close(rxMQ);
-    mq_unlink("/tfs_managermq");
-
-    // store variables
-    finalizeStatements();
-    saveDBToStorage();
-    sqlite3_close(db);
-    sqlite3_shutdown();
+    // file IDs of tags were stored as a serialized string before membership bitmaps
+    if (sqlite3_exec(db, "SELECT files_bitmap FROM tags LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        const std::string statement = "ALTER TABLE tags ADD COLUMN files_bitmap BLOB;";
+        log(statement);
+        if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+            exit(EXIT_FAILURE);
+        }
+    }
+    // sizes and modification times of files weren't stored before --sort
+    if (sqlite3_exec(db, "SELECT size FROM files LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        const std::string statement = "ALTER TABLE files ADD COLUMN size INTEGER NOT NULL "
+            "DEFAULT 0; ALTER TABLE files ADD COLUMN mtime INTEGER NOT NULL DEFAULT 0;";
+        log(statement);
+        if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+            exit(EXIT_FAILURE);
+        }
+        backfillFileAttributes();
+    }
+    // filenames weren't indexed for full-text search before --find-name
+    if (sqlite3_exec(db, "SELECT rowid FROM files_fts LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        createFilenameIndex();
+    }
+    // times files were added and tagged weren't stored before --changed-since
+    if (sqlite3_exec(db, "SELECT added_at FROM files LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        // files are assumed to have been added when they were last modified
+        const std::string statement = "ALTER TABLE files ADD COLUMN added_at INTEGER NOT NULL "
+            "DEFAULT 0; ALTER TABLE files ADD COLUMN tagged_at INTEGER NOT NULL DEFAULT 0; "
+            "UPDATE files SET added_at=mtime;";
+        log(statement);
+        if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+            exit(EXIT_FAILURE);
+        }
+        createChangeIndexes();
+    }
+    // files in tag and query directories were found by reading the name of every file
+    if (sqlite3_exec(db, "SELECT file_id FROM files INDEXED BY files_filename LIMIT 1;", NULL,
+        NULL, NULL) != SQLITE_OK)
+    {
+        createFilenameLookupIndex();
+    }
+    // files were always named with MD5 hashes and stored in a single folder before --hash
+    if (sqlite3_exec(db, "SELECT value FROM variables LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        createVariablesTable("md5", "flat");
+    }
+    // searches couldn't be saved before --save-search
+    if (sqlite3_exec(db, "SELECT name FROM saved_searches LIMIT 1;", NULL, NULL, NULL)
+        != SQLITE_OK)
+    {
+        createSavedSearchesTable();
+    }
+    // files were always stored whole before --chunking
+    if (sqlite3_exec(db, "SELECT hash FROM chunks LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        createChunksTable();
+    }
+    // moves and deletions weren't recorded before --removed-since
+    if (sqlite3_exec(db, "SELECT moved_at FROM files LIMIT 1;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        const std::string statement = "ALTER TABLE files ADD COLUMN moved_at INTEGER NOT NULL "
+            "DEFAULT 0;";
+        log(statement);
+        if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+        {
+            log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+            exit(EXIT_FAILURE);
+        }
+        createRemovalTracking();
+    }
+    // tag co-occurrences were counted from the bitmaps on every start before they were stored
+    if (sqlite3_exec(db, "SELECT files FROM tag_cooccurrences LIMIT 1;", NULL, NULL, NULL)
+        != SQLITE_OK)
+    {
+        createTagCooccurrencesTable();
+        isCooccurrenceCountNeeded = true;
+    }
+    // sizes were only sorted in memory before the catalog could be kept on disk
+    if (sqlite3_exec(db, "SELECT file_id FROM files INDEXED BY files_size LIMIT 1;", NULL, NULL,
+        NULL) != SQLITE_OK)
+    {
+        createSizeIndex();
+    }
+}
 
-    logFile.close();
+/**
+ * Creates an index on the filenames of files so that a file in a tag or query directory is
+ * found among the few files sharing its name instead of among all files of the directory.
+ */
+void TFSManager::createFilenameLookupIndex()
+{
+    const std::string statement = "CREATE INDEX files_filename ON files ( filename );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
- * Calculates hash of the file stored in path.
- *
- * @param path path to the file to be hashed.
- * @return Hash value as a string.
+ * Creates an index on the sizes of files so that the largest files found by a search are found
+ * in the catalog without keeping the sizes of all files in memory.
  */
-std::string TFSManager::calculateHash(std::string path)
+void TFSManager::createSizeIndex()
 {
-    unsigned char md5Value[MD5_DIGEST_LENGTH];
-    unsigned char buf[4096];
-    int fd = open(path.c_str(), O_RDONLY);
-    int bytesRead = 0;
+    const std::string statement = "CREATE INDEX files_size ON files ( size );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+}
 
-    MD5_CTX md5Context;
-    MD5_Init(&md5Context);
-    while ((bytesRead = read(fd, buf, 4096)) > 0)
+/**
+ * Stores the sizes and modification times of all files read from their stored copies in the
+ * root directory.
+ */
+void TFSManager::backfillFileAttributes()
+{
+    sqlite3_stmt *select, *update;
+    if (sqlite3_prepare_v2(db, "SELECT file_id, hash FROM files;", -1, &select, NULL)
+            != SQLITE_OK
+        || sqlite3_prepare_v2(db, "UPDATE files SET size=?, mtime=? WHERE file_id=?;", -1,
+            &update, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+    sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+    while (sqlite3_step(select) == SQLITE_ROW)
     {
-        MD5_Update(&md5Context, buf, bytesRead);
+        std::string hash = reinterpret_cast<const char *>(sqlite3_column_text(select, 1));
+        struct stat attributes;
+        if (ChunkStore::getAttributes(getBlobPath(hash), &attributes) != 0)
+        {
+            continue;
+        }
+        sqlite3_bind_int64(update, 1, attributes.st_size);
+        sqlite3_bind_int64(update, 2, attributes.st_mtime);
+        sqlite3_bind_int64(update, 3, sqlite3_column_int64(select, 0));
+        sqlite3_step(update);
+        sqlite3_reset(update);
     }
-    MD5_Final(md5Value, &md5Context);
+    sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    sqlite3_finalize(select);
+    sqlite3_finalize(update);
+}
 
-    char md5String[2*MD5_DIGEST_LENGTH + 1];
-    std::string hexSymbols = "0123456789ABCDEF";
-    for (auto i = 0, j = 0; i < 2*MD5_DIGEST_LENGTH; i += 2, j++)
+/**
+ * Creates a full-text index of the filenames of all files split into trigrams so that files
+ * can be found by any part of their name. Triggers keep the index in sync with the files
+ * table as files are added, renamed and deleted. SQLite older than 3.34 has no trigram
+ * tokenizer, in which case files are found by name with a scan of the files table instead
+ * and the index is created once SQLite supports it.
+ */
+void TFSManager::createFilenameIndex()
+{
+    const std::string statement = "BEGIN; CREATE VIRTUAL TABLE files_fts USING fts5( filename, "
+            "content='files', content_rowid='file_id', tokenize='trigram' );"
+        "CREATE TRIGGER files_fts_insert AFTER INSERT ON files BEGIN "
+            "INSERT INTO files_fts ( rowid, filename ) VALUES ( new.file_id, new.filename ); "
+            "END;"
+        "CREATE TRIGGER files_fts_delete AFTER DELETE ON files BEGIN "
+            "INSERT INTO files_fts ( files_fts, rowid, filename ) VALUES "
+            "( 'delete', old.file_id, old.filename ); END;"
+        "CREATE TRIGGER files_fts_update AFTER UPDATE OF filename ON files BEGIN "
+            "INSERT INTO files_fts ( files_fts, rowid, filename ) VALUES "
+            "( 'delete', old.file_id, old.filename ); "
+            "INSERT INTO files_fts ( rowid, filename ) VALUES ( new.file_id, new.filename ); "
+            "END;"
+        "INSERT INTO files_fts ( files_fts ) VALUES ( 'rebuild' ); COMMIT;";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        md5String[i] = hexSymbols[md5Value[j] >> 4];
-        md5String[i+1] = hexSymbols[md5Value[j] & 0xF];
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db))
+            + ", finding files by name without an index");
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        isFilenameIndexed = false;
     }
-    md5String[2*MD5_DIGEST_LENGTH] = '\0';
-    return std::string(md5String);
 }
 
 /**
- * Runs TaggableFS until QUIT message is received from either FUSEFileSystem
- * after unmount or QueryHandler.
+ * Creates indexes on the times files were added, modified and tagged so that files changed
+ * since a given time are found without reading the whole files table.
  */
-void TFSManager::run()
+void TFSManager::createChangeIndexes()
 {
-    Message m;
-    do // dispatch messages
+    const std::string statement = "CREATE INDEX files_added_at ON files ( added_at );"
+        "CREATE INDEX files_mtime ON files ( mtime );"
+        "CREATE INDEX files_tagged_at ON files ( tagged_at );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        mq_receive(rxMQ, buffer, TFS_MQ_MESSAGE_SIZE, NULL);
-        m = deserializeMessage(buffer);
-        log("MESSAGE: " + std::string(m.content));
-    } while (dispatch(m));
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
- * Sends message to FUSE operations.
- *
- * @param m message to be sent.
- * @param complete boolean indicating if message is complete or not.
+ * Creates an index on the times files were last moved and the table of paths which files and
+ * folders were deleted or moved away from, so that sync jobs can find both without comparing
+ * the whole tree.
  */
-void TFSManager::messageFUSEFileSystem(std::string m, bool complete)
+void TFSManager::createRemovalTracking()
 {
-    serializeMessage(m.c_str(), buffer, complete);
-    mq_send(txFUSEMQ, buffer, TFS_MQ_MESSAGE_SIZE, 0);
+    const std::string statement = "CREATE INDEX files_moved_at ON files ( moved_at );"
+        "CREATE TABLE removed_paths ( path TEXT NOT NULL, removed_at INTEGER NOT NULL );"
+        "CREATE INDEX removed_paths_removed_at ON removed_paths ( removed_at );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
- * Sends message to QueryHandler.
+ * Records that the given path no longer exists because the file or folder was deleted or moved.
  *
- * @param m message to be sent.
- * @param complete boolean indicating if message is complete or not.
+ * @param path path which was deleted or moved away from.
  */
-void TFSManager::messageQueryHandler(std::string m, bool complete)
+void TFSManager::addRemovedPath(std::string path)
 {
-    serializeMessage(m.c_str(), buffer, complete);
-    mq_send(txQueryMQ, buffer, TFS_MQ_MESSAGE_SIZE, 0);
+    int64_t removedAt = time(NULL);
+    macro_bind_text(stmts[ADD_REMOVED_PATH], path);
+    macro_bind_int64(stmts[ADD_REMOVED_PATH], removedAt);
+    dbExecuteSV(stmts[ADD_REMOVED_PATH]);
 }
 
 /**
- * Dispatches query messages received from both FUSE operations and QueryHandler.
+ * Creates the table storing variables of the root directory such as the hash algorithm used to
+ * name its files.
  *
- * @param m Message struct containing message to be dispatced.
- * @return Boolean indicating if QUIT message was received from FUSEFileSystem or QueryHandler.
+ * @param hashAlgorithm name of the hash algorithm of the root directory.
+ * @param layout layout of the stored files of the root directory.
  */
-bool TFSManager::dispatch(Message m)
+void TFSManager::createVariablesTable(std::string hashAlgorithm, std::string layout)
 {
-    static long loops = 0;
-    loops++;
-    std::vector<std::string> tokens = splitAtFirstOccurance(m.content);
-    std::string query = tokens[0];
-    if (query == "QH_TEST")
+    const std::string statement = "CREATE TABLE variables ( name TEXT PRIMARY KEY NOT NULL, "
+        "value TEXT NOT NULL ); INSERT INTO variables ( name, value ) VALUES "
+        "( 'hash_algorithm', '" + hashAlgorithm + "' ), " // checked by QueryHandler
+        "( 'layout', '" + layout + "' );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        messageQueryHandler("TM_ACK (messages dispatched: " + std::to_string(loops) + ")");
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "QH_EXIT" || query == "FD_EXIT")
+}
+
+/**
+ * Loads the variables of the root directory. The hash algorithm recorded in the catalog is kept
+ * even if another one was requested since the stored files are named with its hash values.
+ * Chunking is recorded the first time it is enabled and stays enabled afterwards.
+ */
+void TFSManager::loadVariables()
+{
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT name, value FROM variables;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
     {
-        return false;
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_TEST" || query == "FD_LOG")
+    std::map<std::string, std::string> variables = {{"hash_algorithm", "md5"}};
+    while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        messageFUSEFileSystem("TM_ACK");
+        variables[reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0))]
+            = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
     }
-    else if (query == "FD_GET_PATH" || query == "FD_GET_PATH_WRITE")
+    sqlite3_finalize(stmt);
+    std::string algorithm = variables["hash_algorithm"];
+    if (hasher.setAlgorithm(algorithm) == false)
     {
-        std::string realPath = "";
-        if (tagView == false)
-        {
-            realPath = getFilePath(tokens[1]);
-        }
-        else if (query != "FD_GET_PATH_WRITE")
-        {
-            realPath = getTaggedFilePath(tokens[1]);
-        }
-        messageFUSEFileSystem(realPath);
+        log("TFSManager unsupported hash algorithm " + algorithm);
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_IF_DIR")
+    if (hashAlgorithm != "" && hashAlgorithm != algorithm)
     {
-        bool isDirectory;
-        if (tagView == true)
-        {
-            isDirectory = (getTagID(tokens[1]) != "");
-        }
-        else
-        {
-            std::vector<std::string> parts = splitPathIntoParts(tokens[1]);
-            isDirectory = (getFolderID(parts) != "");
-        }
-        messageFUSEFileSystem(isDirectory ? "TM_TRUE" : "TM_FALSE");
+        log("TFSManager root directory uses hash algorithm " + algorithm + ", ignoring "
+            + hashAlgorithm);
     }
-    else if (query == "FD_READ_DIR")
+    if (enableChunking && variables["chunking"] != "on")
     {
-        std::vector<std::string> contents;
-        if (tagView == false)
-        {
-            contents = listFolder(tokens[1]);
-        }
-        else
-        {
-            contents = listTagChildren(tokens[1]);
-        }
-        std::size_t size = contents.size();
-        if (size == 0)
-        {
-            messageFUSEFileSystem("");
-        }
-        else
-        {
-            for (std::size_t i = 0; i < size; i++)
-            {
-                bool complete = (i == size - 1);
-                messageFUSEFileSystem(contents[i], complete);
-            }
-        }
+        setVariable("chunking", "on");
     }
-    else if (query == "FD_MKDIR")
-    {
-        int returnValue = 1;
-        if (tagView == false)
-        {
-            returnValue = createFolder(tokens[1]);
-        }
-        else
-        {
-            returnValue = createTag(tokens[1]);
-        }
-        if (returnValue == 0)
-        {
-            messageFUSEFileSystem("TM_ACK");
-        }
-        else // folder/tag wasn't created
-        {
-            messageFUSEFileSystem(std::to_string(returnValue));
-        }
+    enableChunking = enableChunking || variables["chunking"] == "on";
+    // files were stored in a single folder before the sharded layout
+    layout = (variables["layout"] == "") ? "flat" : variables["layout"];
+}
+
+/**
+ * Sets the value of a variable of the root directory.
+ *
+ * @param name name of the variable.
+ * @param value value of the variable.
+ */
+void TFSManager::setVariable(std::string name, std::string value)
+{
+    const std::string statement = "INSERT OR REPLACE INTO variables ( name, value ) VALUES "
+        "( '" + name + "', '" + value + "' );"; // only set to values chosen by the daemon
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_RMDIR")
+}
+
+/**
+ * Creates the table storing the number of references to each stored chunk from the manifests
+ * of chunked files.
+ */
+void TFSManager::createChunksTable()
+{
+    const std::string statement = "CREATE TABLE chunks ( hash TEXT PRIMARY KEY NOT NULL, "
+        "refs INTEGER NOT NULL );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        int returnValue = 1;
-        if (tagView == false)
-        {
-            returnValue = deleteFolder(tokens[1]);
-        }
-        else
-        {
-            returnValue = deleteTag(tokens[1]);
-        }
-        if (returnValue == 0)
-        {
-            messageFUSEFileSystem("TM_ACK");
-        }
-        else // folder/tag doesn't exist or wasn't deleted
-        {
-            messageFUSEFileSystem(std::to_string(returnValue));
-        }
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_UNLINK")
+}
+
+/**
+ * Creates the table storing the number of files tagged with both tags of each pair of tags
+ * with common files, stored once per pair with the smaller tag ID first.
+ */
+void TFSManager::createTagCooccurrencesTable()
+{
+    const std::string statement = "CREATE TABLE tag_cooccurrences ( tag_id INTEGER NOT NULL, "
+        "other_tag_id INTEGER NOT NULL, files INTEGER NOT NULL, "
+        "PRIMARY KEY ( tag_id, other_tag_id ) ) WITHOUT ROWID;"
+        "CREATE INDEX tag_cooccurrences_other_tag_id ON tag_cooccurrences ( other_tag_id );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        int returnValue = 1;
-        if (tagView == false)
-        {
-            returnValue = deleteFile(tokens[1]);
-        }
-        else // untag file, not delete
-        {
-            std::string tagID = getParentTagIDFromPath(tokens[1]);
-            std::string fileID = getTaggedFileID(tagID, getFilename(tokens[1]));
-            returnValue = untagSingleFile(fileID, tagID);
-        }
-        if (returnValue == 0)
-        {
-            messageFUSEFileSystem("TM_ACK");
-        }
-        else // file doesn't exist or wasn't deleted
-        {
-            messageFUSEFileSystem(std::to_string(returnValue));
-        }
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_RENAME")
+}
+
+/**
+ * Creates the table storing saved searches along with the bitmaps of their matching files.
+ */
+void TFSManager::createSavedSearchesTable()
+{
+    const std::string statement = "CREATE TABLE saved_searches ( name TEXT PRIMARY KEY NOT NULL, "
+        "query TEXT NOT NULL, recursive INTEGER NOT NULL, files_bitmap BLOB );";
+    log(statement);
+    if (sqlite3_exec(db, statement.c_str(), NULL, NULL, NULL) != SQLITE_OK)
     {
-        int returnValue = 1;
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        if (tagView == false)
-        {
-            returnValue = renamePath(arguments[0], arguments[1]);
-        }
-        else
-        {
-            returnValue = renameTaggedPath(arguments[0], arguments[1]);
-        }
-        // non-zero return value -> file doesn't exist or wasn't renamed
-        messageFUSEFileSystem((returnValue == 0) ? "TM_ACK" : "TM_FAIL");
+        log("TFSManager sqlite3_exec() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "FD_TRUNCATE")
+}
+
+/**
+ * Loads the bitmaps of file IDs tagged with each tag, the child tags of each tag and the index
+ * of tag names into memory. Tags from an older version storing file IDs as a serialized string
+ * are converted to bitmaps.
+ */
+void TFSManager::loadTags()
+{
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT tag_id, files_bitmap, files_ids, child_tags, tag_name "
+        "FROM tags WHERE parent_folder='0' OR tag_id=0;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
     {
-        int returnValue = 1;
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        if (tagView == false) // tag view mode read only
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> convertedTagIDs;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string tagID = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        Bitmap &fileIDs = tagMemberships[tagID];
+        if (tagID != "0") // root tag isn't found by name
         {
-            off_t length = std::stol(arguments[0]);
-            std::string filePath = arguments[1];
-            returnValue = truncateFile(length, filePath);
+            tagNameIndex.push_back(std::make_pair(
+                reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4)), tagID));
         }
-        if (returnValue == 0)
+        const unsigned char *childTagIDs = sqlite3_column_text(stmt, 3);
+        if (childTagIDs != NULL)
         {
-            messageFUSEFileSystem("TM_ACK");
+            tagChildren[tagID] = deserializeStrings(reinterpret_cast<const char *>(childTagIDs));
         }
-        else // file doesn't exist or wasn't truncated
+        if (sqlite3_column_type(stmt, 1) == SQLITE_NULL) // convert serialized file IDs
         {
-            messageFUSEFileSystem(std::to_string(returnValue));
+            const unsigned char *serializedIDs = sqlite3_column_text(stmt, 2);
+            if (serializedIDs != NULL)
+            {
+                for (auto id : deserializeStrings(reinterpret_cast<const char *>(serializedIDs)))
+                {
+                    fileIDs.add(std::stoul(id));
+                }
+            }
+            convertedTagIDs.push_back(tagID);
         }
-    }
-    else if (query == "FD_UPDATE")
-    {
-        if (tagView == false) // tag view mode read only
+        else if (sqlite3_column_bytes(stmt, 1) > 0)
         {
-            updateFile(tokens[1]);
+            std::string data(static_cast<const char *>(sqlite3_column_blob(stmt, 1)),
+                sqlite3_column_bytes(stmt, 1));
+            if (fileIDs.deserialize(data) == false)
+            {
+                log("TFSManager invalid bitmap of file IDs for tag ID " + tagID);
+            }
         }
-        messageFUSEFileSystem("TM_ACK");
     }
-    else if (query == "FD_ADD_TEMP") // in tag view mode, mknod will fail before sending this
+    sqlite3_finalize(stmt);
+    std::sort(tagNameIndex.begin(), tagNameIndex.end());
+    for (auto tagID : convertedTagIDs)
     {
-        addTemporaryFile(tokens[1]);
-        messageFUSEFileSystem("TM_ACK");
+        updateTagFileIDs(tagID);
     }
-    else if (query == "QH_TAG")
+}
+
+/**
+ * Loads the file IDs and attributes of all files into memory.
+ */
+void TFSManager::loadAllFileIDs()
+{
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT file_id, size, mtime FROM files;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
     {
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        int returnValue = tagFiles(arguments[0], arguments[1]);
-        if (returnValue == 0)
-        {
-            messageQueryHandler("File(s) successfully tagged.");
-        }
-        else if (returnValue == EEXIST)
-        {
-            messageQueryHandler("Failed. Filename conflict with "
-                "files already tagged with the same tag.");
-        }
-        else
-        {
-            messageQueryHandler("Failed. Either file(s) path or tag is invalid.");
-        }
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "QH_UNTAG")
+    while (sqlite3_step(stmt) == SQLITE_ROW)
     {
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        int returnValue = untagFiles(arguments[0], arguments[1]);
-        if (returnValue == 0)
+        uint32_t fileID = sqlite3_column_int64(stmt, 0);
+        allFileIDs.add(fileID);
+        if (memoryBudget != 0) // read from the catalog when needed
         {
-            messageQueryHandler("File(s) successfully untagged.");
+            continue;
         }
-        else
+        if (fileID >= fileAttributes.size())
         {
-            messageQueryHandler("Failed. Either file(s) path or tag is invalid.");
+            fileAttributes.resize(fileID + 1);
         }
+        fileAttributes[fileID] = {uint64_t(sqlite3_column_int64(stmt, 1)),
+            sqlite3_column_int64(stmt, 2)};
     }
-    else if (query == "QH_NEST")
+    sqlite3_finalize(stmt);
+}
+
+/**
+ * Counts the tags of each file from the bitmaps of tagged files and finds the files without
+ * any tags. With a memory budget, the tags aren't counted and the files without any tags are
+ * found by uniting the bitmaps of tagged files instead.
+ */
+void TFSManager::countFileTags()
+{
+    if (memoryBudget != 0)
     {
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        int returnValue = nestTag(getTagID(arguments[0]), getTagID(arguments[1]));
-        if (returnValue == 0)
+        std::vector<const Bitmap *> bitmaps;
+        for (auto &membership : tagMemberships)
         {
-            messageQueryHandler("Tag successfully nested.");
+            bitmaps.push_back(&membership.second);
         }
-        else if (returnValue == 1)
+        untaggedFileIDs = Bitmap::subtract(allFileIDs, Bitmap::uniteAll(bitmaps));
+        return;
+    }
+    fileTagCounts.assign(fileAttributes.size(), 0);
+    for (auto &membership : tagMemberships)
+    {
+        for (auto fileID : membership.second.toVector())
         {
-            messageQueryHandler("Cyclic check error.");
+            if (fileID >= fileTagCounts.size())
+            {
+                fileTagCounts.resize(fileID + 1, 0);
+            }
+            fileTagCounts[fileID]++;
         }
-        else
+    }
+    untaggedFileIDs.clear();
+    for (auto fileID : allFileIDs.toVector())
+    {
+        if (fileTagCounts[fileID] == 0)
         {
-            messageQueryHandler("Failed. Either tag is invalid.");
+            untaggedFileIDs.add(fileID);
         }
     }
-    else if (query == "QH_UNNEST")
+}
+
+/**
+ * Counts the files tagged with both tags of each pair of tags from the bitmaps of tagged files
+ * and stores the counts in the catalog, once for a catalog from before they were stored. The
+ * tags of the files are gathered one container of 65536 file IDs at a time so that they are
+ * never held for all files at once.
+ */
+void TFSManager::countTagCooccurrences()
+{
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> counts; // tag IDs, smaller one first
+    std::vector<uint32_t> keys = allFileIDs.splitKeys(allFileIDs.numberOfContainers());
+    for (std::size_t i = 0; i + 1 < keys.size(); i++)
     {
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        int returnValue = unnestTag(getTagID(arguments[0]), getTagID(arguments[1]));
-        if (returnValue == 0)
+        std::unordered_map<uint32_t, std::vector<uint64_t>> fileTagIDs;
+        for (auto &membership : tagMemberships)
         {
-            messageQueryHandler("Tag successfully unnested.");
+            uint64_t tagID = std::stoull(membership.first);
+            Bitmap fileIDs = Bitmap::uniteAll({&membership.second}, keys[i], keys[i + 1]);
+            for (auto fileID : fileIDs.toVector())
+            {
+                fileTagIDs[fileID].push_back(tagID);
+            }
         }
-        else
+        for (auto &entry : fileTagIDs)
         {
-            messageQueryHandler("Failed. Either tag is invalid.");
+            std::vector<uint64_t> &tagIDs = entry.second;
+            for (std::size_t j = 0; j < tagIDs.size(); j++)
+            {
+                for (std::size_t k = j + 1; k < tagIDs.size(); k++)
+                {
+                    counts[std::minmax(tagIDs[j], tagIDs[k])]++;
+                }
+            }
         }
     }
-    else if (query == "QH_STATS")
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "INSERT INTO tag_cooccurrences ( tag_id, other_tag_id, files ) "
+        "VALUES ( ?, ?, ? );", -1, &stmt, NULL) != SQLITE_OK)
     {
-        int numberOfFiles = std::stoi(dbExecuteSV(stmts[QH_STATS_1]));
-        int numberOfTags = std::stoi(dbExecuteSV(stmts[QH_STATS_2]));
-        std::string stats = "Files: " + std::to_string(numberOfFiles)
-            + ", Tags: " + std::to_string(numberOfTags);
-        messageQueryHandler(stats);
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
     }
-    else if (query == "QH_SEARCH")
+    sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+    for (auto &count : counts)
     {
-        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
-        std::vector<std::string> tags = deserializeStrings(arguments[1]);
-        std::vector<std::string> ids;
-        if (arguments[0] == "1")
-        {
-            ids = findFileIDsWithTags(tags);
-        }
-        else
-        {
-            ids = findFileIDsWithAnyOfTags(tags);
-        }
-        std::size_t size = ids.size();
-        if (size == 0)
+        sqlite3_bind_int64(stmt, 1, count.first.first);
+        sqlite3_bind_int64(stmt, 2, count.first.second);
+        sqlite3_bind_int64(stmt, 3, count.second);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    sqlite3_finalize(stmt);
+    isCooccurrenceCountNeeded = false;
+}
+
+/**
+ * Loads the number of files tagged with both tags of each pair of tags from the catalog.
+ */
+void TFSManager::loadTagCooccurrences()
+{
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT tag_id, other_tag_id, files FROM tag_cooccurrences;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+    tagCooccurrences.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string tagID = std::to_string(sqlite3_column_int64(stmt, 0));
+        std::string otherTagID = std::to_string(sqlite3_column_int64(stmt, 1));
+        uint64_t files = sqlite3_column_int64(stmt, 2);
+        tagCooccurrences[tagID][otherTagID] = files;
+        tagCooccurrences[otherTagID][tagID] = files;
+    }
+    sqlite3_finalize(stmt);
+}
+
+/**
+ * Loads the saved searches along with their matching files into memory. Searches whose stored
+ * matches can't be read are evaluated again.
+ */
+void TFSManager::loadSavedSearches()
+{
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT name, query, recursive, files_bitmap "
+        "FROM saved_searches;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> invalidNames;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        std::string name = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        SavedSearch search;
+        if (search.tagQuery.parsePostfix(
+            reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1))) == false)
         {
-            messageQueryHandler("");
+            log("TFSManager invalid query for saved search " + name);
+            continue;
         }
-        else
+        search.recursive = (sqlite3_column_int(stmt, 2) != 0);
+        indexSavedSearch(search);
+        if (sqlite3_column_bytes(stmt, 3) > 0)
         {
-            for (std::size_t i = 0; i < size; i++)
+            std::string data(static_cast<const char *>(sqlite3_column_blob(stmt, 3)),
+                sqlite3_column_bytes(stmt, 3));
+            if (search.matches.deserialize(data) == false)
             {
-                bool complete = (i == size - 1);
-                messageQueryHandler(getFilenameFromID(ids[i]), complete);
+                log("TFSManager invalid bitmap of file IDs for saved search " + name);
+                invalidNames.push_back(name);
             }
         }
+        savedSearches[name] = std::move(search);
     }
-    else if (query == "QH_CREATE_TAG")
+    sqlite3_finalize(stmt);
+    for (auto name : invalidNames)
     {
-        int returnValue = createTag(tokens[1]);
-        if (returnValue == 0)
-        {
-            messageQueryHandler("Tag successfully created.");
-        }
-        else if (returnValue == EEXIST)
-        {
-            messageQueryHandler("Failed. Tag already exists.");
-        }
-        else
-        {
-            messageQueryHandler("Failed. Given tag is invalid.");
-        }
+        SavedSearch &search = savedSearches[name];
+        std::vector<std::string> plan;
+        search.matches = evaluateQuery(search.tagQuery.getRoot(), search.recursive, plan);
+        updateSavedSearchFileIDs(name);
     }
-    else if (query == "QH_DELETE_TAG")
-    {
-        int returnValue = deleteTag(tokens[1]);
-        if (returnValue == 0)
-        {
-            messageQueryHandler("Tag successfully deleted.");
-        }
-        else if (returnValue == ENOTEMPTY)
-        {
-            messageQueryHandler("Failed. Tag is not empty and has tags and/or "
-                "files nested under it.");
-        }
-        else
+}
+
+/**
+ * Shuts down TaggableFS by unmounting FUSE filesystem, closing and deleting message queues,
+ * saving database to file and closing the log file.
+ */
+void TFSManager::shutdown()
+{
+    fuse_unmount(mountPoint.c_str(), NULL);
+    hashingPool.stop(); // files left pending are hashed again on the next start
+    for (auto &replaced : replacedHashes)
+    {
+        removeUnusedBlob(replaced.second);
+    }
+
+    mq_close(txFUSEMQ);
+    mq_unlink("/tfs_fusemq");
+    mq_close(txQueryMQ);
+    mq_unlink("/tfs_querymq");
+    mq_close(rxMQ);
+    mq_close(txManagerMQ);
+    mq_unlink("/tfs_managermq");
+
+    // store variables
+    finalizeStatements();
+    if (memoryBudget == 0) // bounded catalog is already on disk
+    {
+        saveDBToStorage();
+    }
+    sqlite3_close(db);
+    sqlite3_shutdown();
+
+    logFile.close();
+}
+
+/**
+ * Calculates hash of the file stored in path with the hash algorithm of the root directory.
+ *
+ * @param path path to the file to be hashed.
+ * @return Hash value as a string.
+ */
+std::string TFSManager::calculateHash(std::string path)
+{
+    return hasher.hashFile(path);
+}
+
+/**
+ * Checks if a written file has the same contents as the stored file it was written over, so
+ * that rewriting a file with the same data doesn't need it to be hashed. Files of different
+ * sizes aren't read, and files stored in chunks are never compared.
+ *
+ * @param path path to the written file.
+ * @param blobPath path to the stored file.
+ * @return Boolean to indicate if both files have the same contents.
+ */
+bool TFSManager::isSameContents(std::string path, std::string blobPath)
+{
+    struct stat attributes, blobAttributes;
+    if (lstat(path.c_str(), &attributes) != 0 || lstat(blobPath.c_str(), &blobAttributes) != 0
+        || !S_ISREG(blobAttributes.st_mode) || attributes.st_size != blobAttributes.st_size)
+    {
+        return false;
+    }
+    int fd = open(path.c_str(), O_RDONLY);
+    int blobFD = open(blobPath.c_str(), O_RDONLY);
+    bool isSame = (fd != -1 && blobFD != -1);
+    std::vector<char> buffer(TFS_COMPARE_BUFFER_SIZE), blobBuffer(TFS_COMPARE_BUFFER_SIZE);
+    while (isSame)
+    {
+        ssize_t bytesRead = read(fd, buffer.data(), buffer.size());
+        ssize_t blobBytesRead = read(blobFD, blobBuffer.data(), blobBuffer.size());
+        isSame = (bytesRead == blobBytesRead && bytesRead != -1
+            && memcmp(buffer.data(), blobBuffer.data(), bytesRead) == 0);
+        if (bytesRead <= 0)
         {
-            messageQueryHandler("Failed. Given tag is invalid.");
+            break;
         }
     }
-    else if (query == "QH_GET_TAGS")
+    for (int descriptor : {fd, blobFD})
     {
-        std::vector<std::string> parts = splitPathIntoParts(tokens[1]);
-        std::string filename = popBackAndRemove(parts);
-        std::string folderID = getFolderID(parts);
-        if (folderID == "")
+        if (descriptor != -1)
         {
-            messageQueryHandler("Invalid");
+            close(descriptor);
         }
-        else
+    }
+    return isSame;
+}
+
+/**
+ * Runs TaggableFS until QUIT message is received from either FUSEFileSystem
+ * after unmount or QueryHandler.
+ */
+void TFSManager::run()
+{
+    Message m;
+    mq_attr attributes;
+    do // dispatch messages
+    {
+        // the layout is migrated in batches while no messages are waiting
+        while (layout == "migrating" && mq_getattr(rxMQ, &attributes) == 0
+            && attributes.mq_curmsgs == 0)
         {
-            std::string fileID = getFileID(filename, folderID);
-            if (fileID == "")
-            {
-                messageQueryHandler("Invalid");
-            }
-            else
-            {
-                std::vector<std::string> tags = getFileTags(fileID);
-                messageQueryHandler(serializeStrings(tags));
-            }
+            migrateLayoutBatch();
         }
-    }
-    return true;
+        mq_receive(rxMQ, buffer, TFS_MQ_MESSAGE_SIZE, NULL);
+        m = deserializeMessage(buffer);
+        log("MESSAGE: " + std::string(m.content));
+    } while (dispatch(m));
 }
 
-/**************************************************************************************************
- * Folder methods
- *************************************************************************************************/
+/**
+ * Sends message to FUSE operations.
+ *
+ * @param m message to be sent.
+ * @param complete boolean indicating if message is complete or not.
+ */
+void TFSManager::messageFUSEFileSystem(std::string m, bool complete)
+{
+    serializeMessage(m.c_str(), buffer, complete);
+    mq_send(txFUSEMQ, buffer, TFS_MQ_MESSAGE_SIZE, 0);
+}
 
 /**
- * Gets file ID from filename and parent folder's tag ID.
+ * Sends message to QueryHandler.
  *
- * @param filename filename whose file ID is to be found.
- * @param parentFolderID parent folder's tag ID.
- * @return File ID from the database as a string.
+ * @param m message to be sent.
+ * @param complete boolean indicating if message is complete or not.
  */
-std::string TFSManager::getFileID(std::string filename, std::string parentFolderID)
+void TFSManager::messageQueryHandler(std::string m, bool complete)
 {
-    macro_bind_text(stmts[GET_FILE_ID], filename);
-    macro_bind_int(stmts[GET_FILE_ID], parentFolderID);
-    return dbExecuteSV(stmts[GET_FILE_ID]);
+    serializeMessage(m.c_str(), buffer, complete);
+    mq_send(txQueryMQ, buffer, TFS_MQ_MESSAGE_SIZE, 0);
 }
 
 /**
- * Gets the file IDs for all files inside a folder.
+ * Formats a time as a local date and time.
  *
- * @param parentFolderID parent folder's tag ID.
- * @return String vector containing file IDs inside the parent folder.
+ * @param time seconds since the epoch.
+ * @return Date and time as YYYY-MM-DD HH:MM:SS.
  */
-std::vector<std::string> TFSManager::getFileIDsInFolder(std::string parentFolderID)
+std::string formatTime(int64_t time)
 {
-    macro_bind_int(stmts[GET_FILE_IDS_IN_FOLDER], parentFolderID);
-    return dbExecuteMV(stmts[GET_FILE_IDS_IN_FOLDER]);
+    std::time_t seconds = time;
+    std::tm local;
+    localtime_r(&seconds, &local);
+    std::ostringstream formatted;
+    formatted << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+    return formatted.str();
 }
 
 /**
- * Gets filename associated with the given file ID.
+ * Streams the paths of a page of the files found by a search to QueryHandler. Paths
+ * are resolved a batch at a time and sent as soon as a message is full or the batch is done,
+ * followed by a summary containing the number of results sent and the cursor to continue
+ * from if more results remain. Sorted results are sent with the attribute they are sorted by
+ * and have no cursor.
  *
- * @param fileID file ID whose filename is to be found.
- * @return Filename as a string.
+ * @param matches file IDs of the files found.
+ * @param options options of the search specifying the page to be sent.
+ * @param start time at which the search was received.
  */
-std::string TFSManager::getFilenameFromID(std::string fileID)
+void TFSManager::sendSearchResults(const Bitmap &matches, const SearchOptions &options,
+    std::chrono::steady_clock::time_point start)
 {
-    macro_bind_int(stmts[GET_FILENAME_FROM_ID], fileID);
-    return dbExecuteSV(stmts[GET_FILENAME_FROM_ID]);
+    const std::size_t capacity = sizeof(Message::content) - 1;
+    bool isSorted = (options.sort != SORT_NONE);
+    std::vector<uint32_t> sortedIDs;
+    if (isSorted)
+    {
+        sortedIDs = sortFileIDs(matches, options);
+    }
+    uint64_t remaining = isSorted ? sortedIDs.size()
+        : (options.limit == 0) ? matches.cardinality() : options.limit;
+    uint64_t next = options.cursor + 1, skip = options.offset, numberOfResults = 0, lastID = 0;
+    bool isFirstMessage = true;
+    std::string message = "";
+    std::unordered_map<std::string, std::string> folderPaths;
+    auto flush = [&]()
+    {
+        if (message.empty())
+        {
+            return;
+        }
+        messageQueryHandler(message, false);
+        message = "";
+        if (isFirstMessage)
+        {
+            totalTimeToFirstResult += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            isFirstMessage = false;
+        }
+    };
+    while (remaining > 0)
+    {
+        std::size_t batchSize = std::min(remaining, uint64_t(TFS_SEARCH_BATCH_SIZE));
+        std::vector<uint32_t> ids;
+        if (isSorted)
+        {
+            auto first = sortedIDs.begin() + numberOfResults;
+            ids.assign(first, first + batchSize);
+        }
+        else
+        {
+            ids = matches.toVector(next, skip, batchSize);
+        }
+        if (ids.empty())
+        {
+            break;
+        }
+        skip = 0;
+        next = uint64_t(ids.back()) + 1;
+        remaining -= ids.size();
+        std::vector<std::string> paths = getFilePathsFromIDs(ids, folderPaths);
+        std::unordered_map<uint32_t, FileAttributes> attributes;
+        if (options.sort == SORT_SIZE || options.sort == SORT_MTIME)
+        {
+            attributes = getFileAttributes(ids);
+        }
+        for (std::size_t i = 0; i < ids.size(); i++)
+        {
+            std::string line = paths[i];
+            auto found = attributes.find(ids[i]);
+            if (found != attributes.end())
+            {
+                line += " (" + ((options.sort == SORT_SIZE)
+                    ? std::to_string(found->second.size) + " bytes"
+                    : formatTime(found->second.mtime)) + ")";
+            }
+            line += "\n";
+            if (message.length() + line.length() > capacity)
+            {
+                flush();
+            }
+            message += line;
+        }
+        numberOfResults += ids.size();
+        lastID = ids.back();
+        flush();
+    }
+    if (isFirstMessage) // no results
+    {
+        totalTimeToFirstResult += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    numberOfSearches++;
+    bool hasMore = (!isSorted && numberOfResults != 0 && !matches.toVector(next, 0, 1).empty());
+    messageQueryHandler(std::to_string(numberOfResults) + ","
+        + (hasMore ? std::to_string(lastID) : ""));
 }
 
 /**
- * Gets folder's tag ID from folder's name and the parent folder's tag ID.
+ * Sends the tags most commonly found on the given files along with the number of files having
+ * each of them to QueryHandler. If each file has one of the searched tags, only the tags found
+ * together with them are counted and the files of a single searched tag are counted straight
+ * from the numbers of files tagged with both tags. Otherwise each tag is intersected with the
+ * files.
  *
- * @param folderName folder name whose tag ID is to be found.
- * @param parentFolderID parent folder's tag ID.
- * @return Folder's tag ID as a string.
+ * @param matches file IDs of the files found.
+ * @param excludedTagIDs tag IDs of the tags searched for, which aren't sent.
+ * @param numberOfFacets maximum number of tags to be sent.
  */
-std::string TFSManager::getFolderID(std::string folderName, std::string parentFolderID)
+void TFSManager::sendFacets(const Bitmap &matches, const std::set<std::string> &excludedTagIDs,
+    uint64_t numberOfFacets)
 {
-    macro_bind_text(stmts[GET_FOLDER_ID], folderName);
-    macro_bind_int(stmts[GET_FOLDER_ID], parentFolderID);
-    return dbExecuteSV(stmts[GET_FOLDER_ID]);
+    typedef std::pair<uint64_t, std::string> Facet; // number of files and tag name
+    std::vector<Facet> facets;
+    Bitmap searchedFileIDs;
+    for (auto &tagID : excludedTagIDs)
+    {
+        auto membership = tagMemberships.find(tagID);
+        if (membership != tagMemberships.end())
+        {
+            searchedFileIDs = Bitmap::unite(searchedFileIDs, membership->second);
+        }
+    }
+    // false if files were found through NOT, nested tags or by name alone
+    bool isCovered = !matches.isEmpty()
+        && Bitmap::subtract(matches, searchedFileIDs).isEmpty();
+    if (isCovered && excludedTagIDs.size() == 1
+        && matches.cardinality() == searchedFileIDs.cardinality())
+    {
+        // the files are exactly those of the searched tag
+        for (auto &count : getTagCooccurrences(*excludedTagIDs.begin()))
+        {
+            facets.push_back(Facet(count.second, getTagNameFromID(count.first)));
+        }
+    }
+    else if (isCovered)
+    {
+        std::set<std::string> candidateTagIDs;
+        for (auto &tagID : excludedTagIDs)
+        {
+            for (auto &count : getTagCooccurrences(tagID))
+            {
+                if (excludedTagIDs.count(count.first) == 0)
+                {
+                    candidateTagIDs.insert(count.first);
+                }
+            }
+        }
+        for (auto &tagID : candidateTagIDs)
+        {
+            auto membership = tagMemberships.find(tagID);
+            uint64_t count = (membership == tagMemberships.end()) ? 0
+                : Bitmap::intersectionCardinality(matches, membership->second);
+            if (count != 0)
+            {
+                facets.push_back(Facet(count, getTagNameFromID(tagID)));
+            }
+        }
+    }
+    else if (!matches.isEmpty())
+    {
+        for (auto &entry : tagNameIndex)
+        {
+            if (excludedTagIDs.count(entry.second) != 0)
+            {
+                continue;
+            }
+            auto membership = tagMemberships.find(entry.second);
+            uint64_t count = (membership == tagMemberships.end()) ? 0
+                : Bitmap::intersectionCardinality(matches, membership->second);
+            if (count != 0)
+            {
+                facets.push_back(Facet(count, entry.first));
+            }
+        }
+    }
+    std::size_t size = std::min(std::size_t(numberOfFacets), facets.size());
+    std::partial_sort(facets.begin(), facets.begin() + size, facets.end(),
+        [](const Facet &a, const Facet &b) {
+            return (a.first != b.first) ? a.first > b.first : a.second < b.second;
+        });
+    const std::size_t capacity = sizeof(Message::content) - 1;
+    std::string message = "";
+    for (std::size_t i = 0; i < size; i++)
+    {
+        std::string line = facets[i].second + " (" + std::to_string(facets[i].first)
+            + " files)\n";
+        if (message.length() + line.length() > capacity)
+        {
+            break;
+        }
+        message += line;
+    }
+    messageQueryHandler(message, false);
+}
+
+/**
+ * Dispatches query messages received from both FUSE operations and QueryHandler.
+ *
+ * @param m Message struct containing message to be dispatced.
+ * @return Boolean indicating if QUIT message was received from FUSEFileSystem or QueryHandler.
+ */
+bool TFSManager::dispatch(Message m)
+{
+    static long loops = 0;
+    loops++;
+    std::vector<std::string> tokens = splitAtFirstOccurance(m.content);
+    std::string query = tokens[0];
+    if (query == "QH_TEST")
+    {
+        messageQueryHandler("TM_ACK (messages dispatched: " + std::to_string(loops) + ")");
+    }
+    else if (query == "QH_EXIT" || query == "FD_EXIT")
+    {
+        return false;
+    }
+    else if (query == "FD_TEST" || query == "FD_LOG")
+    {
+        messageFUSEFileSystem("TM_ACK");
+    }
+    else if (query == "FD_GET_PATH" || query == "FD_GET_PATH_WRITE")
+    {
+        std::string realPath = "";
+        if (tagView == false)
+        {
+            realPath = getFilePath(tokens[1]);
+        }
+        else if (query != "FD_GET_PATH_WRITE")
+        {
+            realPath = getTaggedFilePath(tokens[1]);
+        }
+        messageFUSEFileSystem(realPath);
+    }
+    else if (query == "FD_IF_DIR")
+    {
+        bool isDirectory;
+        if (tagView == true)
+        {
+            isDirectory = (getTagID(tokens[1]) != ""
+                || getQueryDirectoryFileIDs(tokens[1]) != NULL);
+        }
+        else
+        {
+            std::vector<std::string> parts = splitPathIntoParts(tokens[1]);
+            isDirectory = (getFolderID(parts) != "");
+        }
+        messageFUSEFileSystem(isDirectory ? "TM_TRUE" : "TM_FALSE");
+    }
+    else if (query == "FD_READ_DIR")
+    {
+        std::vector<std::string> contents;
+        if (tagView == false)
+        {
+            contents = listFolder(tokens[1]);
+        }
+        else
+        {
+            contents = listTagChildren(tokens[1]);
+        }
+        std::size_t size = contents.size();
+        if (size == 0)
+        {
+            messageFUSEFileSystem("");
+        }
+        else
+        {
+            for (std::size_t i = 0; i < size; i++)
+            {
+                bool complete = (i == size - 1);
+                messageFUSEFileSystem(contents[i], complete);
+            }
+        }
+    }
+    else if (query == "FD_MKDIR")
+    {
+        int returnValue = 1;
+        if (tagView == false)
+        {
+            returnValue = createFolder(tokens[1]);
+        }
+        else
+        {
+            returnValue = createTag(tokens[1]);
+        }
+        if (returnValue == 0)
+        {
+            messageFUSEFileSystem("TM_ACK");
+        }
+        else // folder/tag wasn't created
+        {
+            messageFUSEFileSystem(std::to_string(returnValue));
+        }
+    }
+    else if (query == "FD_RMDIR")
+    {
+        int returnValue = 1;
+        if (tagView == false)
+        {
+            returnValue = deleteFolder(tokens[1]);
+        }
+        else
+        {
+            returnValue = deleteTag(tokens[1]);
+        }
+        if (returnValue == 0)
+        {
+            messageFUSEFileSystem("TM_ACK");
+        }
+        else // folder/tag doesn't exist or wasn't deleted
+        {
+            messageFUSEFileSystem(std::to_string(returnValue));
+        }
+    }
+    else if (query == "FD_UNLINK")
+    {
+        int returnValue = 1;
+        if (tagView == false)
+        {
+            returnValue = deleteFile(tokens[1]);
+        }
+        else // untag file, not delete
+        {
+            std::string tagID = getParentTagIDFromPath(tokens[1]);
+            std::string fileID = getTaggedFileID(tagID, getFilename(tokens[1]));
+            returnValue = untagSingleFile(fileID, tagID);
+        }
+        if (returnValue == 0)
+        {
+            messageFUSEFileSystem("TM_ACK");
+        }
+        else // file doesn't exist or wasn't deleted
+        {
+            messageFUSEFileSystem(std::to_string(returnValue));
+        }
+    }
+    else if (query == "FD_RENAME")
+    {
+        int returnValue = 1;
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        if (tagView == false)
+        {
+            returnValue = renamePath(arguments[0], arguments[1]);
+        }
+        else
+        {
+            returnValue = renameTaggedPath(arguments[0], arguments[1]);
+        }
+        // non-zero return value -> file doesn't exist or wasn't renamed
+        messageFUSEFileSystem((returnValue == 0) ? "TM_ACK" : "TM_FAIL");
+    }
+    else if (query == "FD_TRUNCATE")
+    {
+        int returnValue = 1;
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        if (tagView == false) // tag view mode read only
+        {
+            off_t length = std::stol(arguments[0]);
+            std::string filePath = arguments[1];
+            returnValue = truncateFile(length, filePath);
+        }
+        if (returnValue == 0)
+        {
+            messageFUSEFileSystem("TM_ACK");
+        }
+        else // file doesn't exist or wasn't truncated
+        {
+            messageFUSEFileSystem(std::to_string(returnValue));
+        }
+    }
+    else if (query == "FD_UPDATE")
+    {
+        if (tagView == false) // tag view mode read only
+        {
+            updateFile(tokens[1]);
+        }
+        messageFUSEFileSystem("TM_ACK");
+    }
+    else if (query == "FD_UPDATE_HASHED") // hashed by the driver as it was written
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        if (tagView == false)
+        {
+            updateFile(arguments[1], arguments[0]);
+        }
+        messageFUSEFileSystem("TM_ACK");
+    }
+    else if (query == "FD_PIN_CHUNKS")
+    {
+        chunkPins[tokens[1]]++;
+        messageFUSEFileSystem("TM_ACK");
+    }
+    else if (query == "FD_UNPIN_CHUNKS")
+    {
+        unpinChunks(tokens[1]);
+        messageFUSEFileSystem("TM_ACK");
+    }
+    else if (query == "TM_HASH_DONE") // sent by the hashing threads, no reply
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        finishPendingHash(arguments[0], arguments[1]);
+    }
+    else if (query == "FD_ADD_TEMP") // in tag view mode, mknod will fail before sending this
+    {
+        messageFUSEFileSystem(addTemporaryFile(tokens[1]));
+    }
+    else if (query == "QH_TAG")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        int returnValue = tagFiles(arguments[0], arguments[1]);
+        if (returnValue == 0)
+        {
+            messageQueryHandler("File(s) successfully tagged.");
+        }
+        else if (returnValue == EEXIST)
+        {
+            messageQueryHandler("Failed. Filename conflict with "
+                "files already tagged with the same tag.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Either file(s) path or tag is invalid.");
+        }
+    }
+    else if (query == "QH_UNTAG")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        int returnValue = untagFiles(arguments[0], arguments[1]);
+        if (returnValue == 0)
+        {
+            messageQueryHandler("File(s) successfully untagged.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Either file(s) path or tag is invalid.");
+        }
+    }
+    else if (query == "QH_NEST")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        int returnValue = nestTag(getTagID(arguments[0]), getTagID(arguments[1]));
+        if (returnValue == 0)
+        {
+            messageQueryHandler("Tag successfully nested.");
+        }
+        else if (returnValue == 1)
+        {
+            messageQueryHandler("Cyclic check error.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Either tag is invalid.");
+        }
+    }
+    else if (query == "QH_UNNEST")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        int returnValue = unnestTag(getTagID(arguments[0]), getTagID(arguments[1]));
+        if (returnValue == 0)
+        {
+            messageQueryHandler("Tag successfully unnested.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Either tag is invalid.");
+        }
+    }
+    else if (query == "QH_MIGRATE_LAYOUT")
+    {
+        if (layout == "sharded")
+        {
+            messageQueryHandler("Root directory already uses the sharded layout.");
+        }
+        else if (layout == "migrating")
+        {
+            messageQueryHandler("Root directory is already being migrated, "
+                + std::to_string(migratingHashes.size() + migratingChunkHashes.size())
+                + " files and chunks left.");
+        }
+        else
+        {
+            uint64_t numberOfFiles = migrateLayout();
+            messageQueryHandler("Moving " + std::to_string(numberOfFiles) + " files and chunks "
+                + "into the sharded layout in the background, see --stats for progress.");
+        }
+    }
+    else if (query == "QH_STATS")
+    {
+        int numberOfFiles = std::stoi(dbExecuteSV(stmts[QH_STATS_1]));
+        int numberOfTags = std::stoi(dbExecuteSV(stmts[QH_STATS_2]));
+        sqlite3_int64 catalogBytes = 0, catalogHighwater = 0;
+        sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &catalogBytes, &catalogHighwater, 0);
+        std::size_t indexBytes = getIndexMemoryUsage();
+        std::string stats = "Files: " + std::to_string(numberOfFiles)
+            + ", Tags: " + std::to_string(numberOfTags)
+            + ", Hash: " + hasher.getAlgorithm()
+            + ", Chunking: " + (enableChunking ? "on (" + dbExecuteSV(stmts[COUNT_CHUNKS])
+                + " chunks)" : "off")
+            + ", Layout: " + layout + ((layout == "migrating") ? " ("
+                + std::to_string(migratingHashes.size() + migratingChunkHashes.size())
+                + " left)" : "")
+            + ", Pending hashes: " + std::to_string(hashingPool.size())
+            + ", Catalog (SQLite): " + std::to_string(catalogBytes) + " bytes resident"
+            + ((memoryBudget == 0) ? " (in memory)"
+                : " (budget: " + std::to_string(memoryBudget) + " MiB)")
+            + ", Indexes: " + std::to_string(indexBytes) + " bytes resident"
+            + ((memoryBudget == 0) ? "" : (indexBytes > (memoryBudget << 20))
+                ? " (WARNING: exceeds the memory budget)" : " (within budget)")
+            + ", Searches: " + std::to_string(numberOfSearches);
+        if (numberOfSearches != 0)
+        {
+            stats += " (average time to first result: "
+                + std::to_string(totalTimeToFirstResult / numberOfSearches) + " us)";
+        }
+        stats += ", Search cache: " + std::to_string(searchCacheHits) + " hits, "
+            + std::to_string(searchCacheMisses) + " misses, "
+            + std::to_string(searchCache.size()) + " results ("
+            + std::to_string(searchCache.cost()) + " bytes)";
+        messageQueryHandler(stats);
+    }
+    else if (query == "QH_SEARCH")
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        std::vector<std::string> tags = deserializeStrings(arguments[1]);
+        SearchOptions options = deserializeSearchOptions(arguments[0]);
+        const Bitmap *matches = searchTags(tags, options);
+        if (options.facets != 0)
+        {
+            std::set<std::string> tagIDs;
+            for (auto tag : tags)
+            {
+                tagIDs.insert(getTagID(tag));
+            }
+            sendFacets(*matches, tagIDs, options.facets);
+        }
+        sendSearchResults(*matches, options, start);
+    }
+    else if (query == "QH_QUERY")
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        SearchOptions options = deserializeSearchOptions(arguments[0]);
+        TagQuery tagQuery;
+        const Bitmap *matches = &uncachedSearch;
+        std::vector<std::string> plan;
+        if (arguments.size() == 2 && tagQuery.parsePostfix(arguments[1]) == true)
+        {
+            matches = searchQuery(tagQuery, options.recursive, plan);
+            auto time = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+            plan.push_back("Evaluated in " + std::to_string(time.count()) + " us");
+        }
+        else
+        {
+            uncachedSearch.clear();
+            plan.push_back("Invalid query");
+        }
+        if (options.explain)
+        {
+            messageQueryHandler(serializeStrings(plan, '\n'), false);
+        }
+        if (options.facets != 0)
+        {
+            std::set<std::string> tagIDs;
+            bool usesAllFiles = false;
+            getQueryTagIDs(tagQuery.getRoot(), false, tagIDs, usesAllFiles);
+            sendFacets(*matches, tagIDs, options.facets);
+        }
+        sendSearchResults(*matches, options, start);
+    }
+    else if (query == "QH_FIND_NAME")
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        SearchOptions options = deserializeSearchOptions(arguments[0]);
+        std::vector<std::string> parts = splitAtFirstOccurance(arguments[1], '\n');
+        Bitmap matches = findFileIDsByName(parts[0]);
+        std::set<std::string> tagIDs;
+        if (parts.size() == 2) // limited to files matching a tag query
+        {
+            TagQuery tagQuery;
+            std::vector<std::string> plan;
+            if (tagQuery.parsePostfix(parts[1]) == true)
+            {
+                matches = Bitmap::intersect(matches,
+                    *searchQuery(tagQuery, options.recursive, plan));
+                bool usesAllFiles = false;
+                getQueryTagIDs(tagQuery.getRoot(), false, tagIDs, usesAllFiles);
+            }
+            else
+            {
+                matches.clear();
+            }
+        }
+        if (options.facets != 0)
+        {
+            sendFacets(matches, tagIDs, options.facets);
+        }
+        sendSearchResults(matches, options, start);
+    }
+    else if (query == "QH_UNTAGGED")
+    {
+        auto start = std::chrono::steady_clock::now();
+        sendSearchResults(untaggedFileIDs, deserializeSearchOptions(tokens[1]), start);
+    }
+    else if (query == "QH_CHANGED_SINCE" || query == "QH_TAGGED_SINCE")
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        SearchOptions options = deserializeSearchOptions(arguments[0]);
+        int64_t since = std::stoll(arguments[1]);
+        sqlite3_stmt *stmt = stmts[(query == "QH_CHANGED_SINCE") ? FIND_CHANGED_FILES
+            : FIND_TAGGED_FILES];
+        macro_bind_int64(stmt, since);
+        Bitmap matches;
+        for (auto fileID : dbExecuteMV(stmt))
+        {
+            matches.add(std::stoul(fileID));
+        }
+        sendSearchResults(matches, options, start);
+    }
+    else if (query == "QH_REMOVED_SINCE")
+    {
+        int64_t since = std::stoll(tokens[1]);
+        macro_bind_int64(stmts[FIND_REMOVED_PATHS], since);
+        std::vector<std::vector<std::string>> results = dbExecuteMR(stmts[FIND_REMOVED_PATHS]);
+        if (results.empty())
+        {
+            messageQueryHandler("");
+        }
+        for (std::size_t i = 0; i < results.size(); i++)
+        {
+            messageQueryHandler(results[i][0] + " " + results[i][1], i == results.size() - 1);
+        }
+    }
+    else if (query == "QH_SAVE_SEARCH")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        std::vector<std::string> parts = splitAtFirstOccurance(arguments[1], '\n');
+        int returnValue = (parts.size() == 2) ? saveSearch(parts[0], parts[1], arguments[0] == "1")
+            : 1;
+        if (returnValue == 0)
+        {
+            messageQueryHandler("Search successfully saved ("
+                + std::to_string(savedSearches[parts[0]].matches.cardinality()) + " files).");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Given name or query is invalid.");
+        }
+    }
+    else if (query == "QH_DELETE_SEARCH")
+    {
+        if (deleteSavedSearch(tokens[1]) == 0)
+        {
+            messageQueryHandler("Saved search successfully deleted.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. No search saved with the given name.");
+        }
+    }
+    else if (query == "QH_LIST_SEARCHES")
+    {
+        if (savedSearches.empty())
+        {
+            messageQueryHandler("");
+        }
+        std::size_t i = 0;
+        for (auto &entry : savedSearches)
+        {
+            bool complete = (++i == savedSearches.size());
+            messageQueryHandler(entry.first + ": " + entry.second.tagQuery.toString()
+                + (entry.second.recursive ? " (Recursive)" : "") + " ("
+                + std::to_string(entry.second.matches.cardinality()) + " files)", complete);
+        }
+    }
+    else if (query == "QH_SAVED_SEARCH")
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        SearchOptions options = deserializeSearchOptions(arguments[0]);
+        auto result = savedSearches.find((arguments.size() == 2) ? arguments[1] : "");
+        const Bitmap *matches = &uncachedSearch;
+        std::set<std::string> tagIDs;
+        if (result != savedSearches.end())
+        {
+            matches = &result->second.matches;
+            bool usesAllFiles = false;
+            getQueryTagIDs(result->second.tagQuery.getRoot(), false, tagIDs, usesAllFiles);
+        }
+        else
+        {
+            uncachedSearch.clear();
+        }
+        if (options.facets != 0)
+        {
+            sendFacets(*matches, tagIDs, options.facets);
+        }
+        sendSearchResults(*matches, options, start);
+    }
+    else if (query == "QH_CREATE_TAG")
+    {
+        int returnValue = createTag(tokens[1]);
+        if (returnValue == 0)
+        {
+            messageQueryHandler("Tag successfully created.");
+        }
+        else if (returnValue == EEXIST)
+        {
+            messageQueryHandler("Failed. Tag already exists.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Given tag is invalid.");
+        }
+    }
+    else if (query == "QH_DELETE_TAG")
+    {
+        int returnValue = deleteTag(tokens[1]);
+        if (returnValue == 0)
+        {
+            messageQueryHandler("Tag successfully deleted.");
+        }
+        else if (returnValue == ENOTEMPTY)
+        {
+            messageQueryHandler("Failed. Tag is not empty and has tags and/or "
+                "files nested under it.");
+        }
+        else
+        {
+            messageQueryHandler("Failed. Given tag is invalid.");
+        }
+    }
+    else if (query == "QH_COMPLETE_TAG")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        std::vector<std::string> options = splitAtFirstOccurance(arguments[1], ',');
+        std::size_t limit = std::stoul(arguments[0]);
+        std::string prefix = (options.size() == 2) ? options[1] : "";
+        auto completions = completeTag(prefix, limit, options[0] == "1");
+        std::size_t size = completions.size();
+        if (size == 0)
+        {
+            messageQueryHandler("");
+        }
+        for (std::size_t i = 0; i < size; i++)
+        {
+            bool complete = (i == size - 1);
+            messageQueryHandler(completions[i].first + " (" + std::to_string(completions[i].second)
+                + " files)", complete);
+        }
+    }
+    else if (query == "QH_SUGGEST_TAGS")
+    {
+        std::vector<std::string> arguments = splitAtFirstOccurance(tokens[1], ',');
+        std::vector<std::string> parts = splitPathIntoParts(arguments[1]);
+        std::string filename = popBackAndRemove(parts);
+        std::string folderID = getFolderID(parts);
+        std::string fileID = (folderID == "") ? "" : getFileID(filename, folderID);
+        if (fileID == "")
+        {
+            messageQueryHandler("Invalid");
+        }
+        else
+        {
+            auto suggestions = suggestTags(fileID, std::stoul(arguments[0]));
+            std::size_t size = suggestions.size();
+            if (size == 0)
+            {
+                messageQueryHandler("");
+            }
+            for (std::size_t i = 0; i < size; i++)
+            {
+                bool complete = (i == size - 1);
+                messageQueryHandler(suggestions[i].first + " (found with its tags on "
+                    + std::to_string(suggestions[i].second) + " files)", complete);
+            }
+        }
+    }
+    else if (query == "QH_GET_TAGS")
+    {
+        std::vector<std::string> parts = splitPathIntoParts(tokens[1]);
+        std::string filename = popBackAndRemove(parts);
+        std::string folderID = getFolderID(parts);
+        if (folderID == "")
+        {
+            messageQueryHandler("Invalid");
+        }
+        else
+        {
+            std::string fileID = getFileID(filename, folderID);
+            if (fileID == "")
+            {
+                messageQueryHandler("Invalid");
+            }
+            else
+            {
+                std::vector<std::string> tags = getFileTags(fileID);
+                messageQueryHandler(serializeStrings(tags));
+            }
+        }
+    }
+    return true;
+}
+
+/**************************************************************************************************
+ * Folder methods
+ *************************************************************************************************/
+
+/**
+ * Gets file ID from filename and parent folder's tag ID.
+ *
+ * @param filename filename whose file ID is to be found.
+ * @param parentFolderID parent folder's tag ID.
+ * @return File ID from the database as a string.
+ */
+std::string TFSManager::getFileID(std::string filename, std::string parentFolderID)
+{
+    macro_bind_text(stmts[GET_FILE_ID], filename);
+    macro_bind_int(stmts[GET_FILE_ID], parentFolderID);
+    return dbExecuteSV(stmts[GET_FILE_ID]);
+}
+
+/**
+ * Gets the file IDs for all files inside a folder.
+ *
+ * @param parentFolderID parent folder's tag ID.
+ * @return String vector containing file IDs inside the parent folder.
+ */
+std::vector<std::string> TFSManager::getFileIDsInFolder(std::string parentFolderID)
+{
+    macro_bind_int(stmts[GET_FILE_IDS_IN_FOLDER], parentFolderID);
+    return dbExecuteMV(stmts[GET_FILE_IDS_IN_FOLDER]);
+}
+
+/**
+ * Gets filename associated with the given file ID.
+ *
+ * @param fileID file ID whose filename is to be found.
+ * @return Filename as a string.
+ */
+std::string TFSManager::getFilenameFromID(std::string fileID)
+{
+    macro_bind_int(stmts[GET_FILENAME_FROM_ID], fileID);
+    return dbExecuteSV(stmts[GET_FILENAME_FROM_ID]);
+}
+
+/**
+ * Gets folder's tag ID from folder's name and the parent folder's tag ID.
+ *
+ * @param folderName folder name whose tag ID is to be found.
+ * @param parentFolderID parent folder's tag ID.
+ * @return Folder's tag ID as a string.
+ */
+std::string TFSManager::getFolderID(std::string folderName, std::string parentFolderID)
+{
+    macro_bind_text(stmts[GET_FOLDER_ID], folderName);
+    macro_bind_int(stmts[GET_FOLDER_ID], parentFolderID);
+    return dbExecuteSV(stmts[GET_FOLDER_ID]);
+}
+
+/**
+ * Gets folder's tag ID from the path to the folder.
+ *
+ * @param partsOfPath vector containing parts of the path to the folder.
+ * @return Folder's tag ID as a string.
+ */
+std::string TFSManager::getFolderID(std::vector<std::string> &partsOfPath)
+{
+    std::string folderID;
+    int size = partsOfPath.size();
+    folderID = "1";
+    for (auto i = 0; i < size; i++)
+    {
+        // sql query failed before exhausting path i.e. non-existent path
+        if (folderID == "")
+        {
+            return "";
+        }
+        folderID = getFolderID(partsOfPath[i], folderID);
+    }
+    return folderID;
+}
+
+/**
+ * Gets file's hash value from filename and the parent folder's tag ID.
+ *
+ * @param filename filename of file whose hash value is to be found.
+ * @param parentFolderID parent folder's tag ID.
+ * @return Hash value of the file from the database as a string.
+ */
+std::string TFSManager::getHash(std::string filename, std::string parentFolderID)
+{
+    macro_bind_text(stmts[GET_HASH], filename);
+    macro_bind_int(stmts[GET_HASH], parentFolderID);
+    return dbExecuteSV(stmts[GET_HASH]);
+}
+
+/**
+ * Checks if a folder is empty.
+ *
+ * @param folderID tag ID of the folder to be checked.
+ * @return Boolean indicating if folder is empty or not.
+ */
+bool TFSManager::isFolderEmpty(std::string folderID)
+{
+    macro_bind_int(stmts[IS_FOLDER_EMPTY], folderID);
+    int isFolderEmpty = std::stoi(dbExecuteSV(stmts[IS_FOLDER_EMPTY]));
+    return (isFolderEmpty == 0);
+}
+
+/**
+ * Updates the hash value after a write or a truncate operation with the given hash value.
+ *
+ * @param fileID file ID of the file whose hash value is to be updated.
+ * @param newHash new hash value to be inserted in place of the old value.
+ */
+void TFSManager::updateHash(std::string fileID, std::string newHash)
+{
+    macro_bind_text(stmts[UPDATE_HASH], newHash);
+    macro_bind_int(stmts[UPDATE_HASH], fileID);
+    dbExecuteSV(stmts[UPDATE_HASH]);
+}
+
+/**
+ * Updates the stored size and modification time of a file from its stored copy.
+ *
+ * @param fileID file ID of the file whose attributes are to be updated.
+ * @param hash hash value or temporary filename naming the stored copy of the file.
+ */
+void TFSManager::updateFileAttributes(std::string fileID, std::string hash)
+{
+    struct stat attributes;
+    int64_t size = 0, mtime = time(NULL);
+    if (ChunkStore::getAttributes(getBlobPath(hash), &attributes) == 0)
+    {
+        size = attributes.st_size;
+        mtime = attributes.st_mtime;
+    }
+    macro_bind_int64(stmts[UPDATE_FILE_ATTRIBUTES], size);
+    macro_bind_int64(stmts[UPDATE_FILE_ATTRIBUTES], mtime);
+    macro_bind_int(stmts[UPDATE_FILE_ATTRIBUTES], fileID);
+    dbExecuteSV(stmts[UPDATE_FILE_ATTRIBUTES]);
+    if (memoryBudget != 0) // read from the catalog when needed
+    {
+        return;
+    }
+    uint32_t id = std::stoul(fileID);
+    if (id >= fileAttributes.size())
+    {
+        fileAttributes.resize(id + 1);
+    }
+    fileAttributes[id] = {uint64_t(size), mtime};
+}
+
+/**
+ * Gets the actual path to the file inside the root directory from the mounted path.
+ *
+ * @param relativePath mounted path to file whose actual path is to be found.
+ * @return Actual path to the file specified by the mounted path.
+ */
+std::string TFSManager::getFilePath(std::string relativePath)
+{
+    std::vector<std::string> parts = splitPathIntoParts(relativePath);
+    std::string filename = popBackAndRemove(parts);
+    std::string parentFolderID = getFolderID(parts);
+    if (parentFolderID != "") // parent folder exists
+    {
+        // need not check if file exists, path will be used by mknod
+        return getBlobPath(getHash(filename, parentFolderID));
+    }
+    return "";
+}
+
+/**
+ * Lists contents of the folder specified by the given path.
+ *
+ * @param folderPath path to the folder whose contents are to be listed.
+ * @return String vector containing contents of the folder.
+ */
+std::vector<std::string> TFSManager::listFolder(std::string folderPath)
+{
+    std::vector<std::string> parts = splitPathIntoParts(folderPath);
+    std::string folderID = getFolderID(parts);
+    std::vector<std::string> contents;
+    if (folderID != "") // folder exists
+    {
+        macro_bind_int(stmts[LIST_FOLDER_1], folderID);
+        contents = dbExecuteMV(stmts[LIST_FOLDER_1]);
+        macro_bind_int(stmts[LIST_FOLDER_2], folderID);
+        std::vector<std::string> filenames = dbExecuteMV(stmts[LIST_FOLDER_2]);
+        contents.reserve(contents.size() + filenames.size());
+        contents.insert(contents.end(), filenames.begin(), filenames.end());
+    }
+    return contents;
+}
+
+/**
+ * Creates folder specified by given path by inserting a new row into tags table.
+ *
+ * @param folderPath path specifying where folder is to be created and its name.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::createFolder(std::string folderPath)
+{
+    std::vector<std::string> parts = splitPathIntoParts(folderPath);
+    std::string newFolderName = popBackAndRemove(parts);
+    std::string parentFolderID = getFolderID(parts);
+    if (parentFolderID != "") // parent folder exists
+    {
+        std::string fileID = getFileID(newFolderName, parentFolderID);
+        std::string folderID = getFolderID(newFolderName, parentFolderID);
+        if (fileID == "" && folderID == "") // no conflict
+        {
+            macro_bind_text(stmts[CREATE_FOLDER], newFolderName);
+            macro_bind_int(stmts[CREATE_FOLDER], parentFolderID);
+            dbExecuteSV(stmts[CREATE_FOLDER]);
+            return 0;
+        }
+        return EEXIST; // file/folder with same name exists
+    }
+    return ENOENT; // invalid path to folder to be created
+}
+
+/**
+ * Deletes folder specified by given path by removing its row entry from tags table.
+ *
+ * @param folderPath path specifying folder to be deleted.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::deleteFolder(std::string folderPath)
+{
+    std::vector<std::string> parts = splitPathIntoParts(folderPath);
+    std::string folderID = getFolderID(parts);
+    if (folderID != "") // folder exists
+    {
+        if (isFolderEmpty(folderID) == true) // folder empty, proceed with delete
+        {
+            macro_bind_int(stmts[DELETE_FOLDER], folderID);
+            dbExecuteSV(stmts[DELETE_FOLDER]);
+            addRemovedPath(folderPath);
+            return 0;
+        }
+        return ENOTEMPTY; // folder not empty
+    }
+    return ENOENT; // path invalid
+}
+
+/**
+ * Deletes file specified by given path by removing its row entry from the files table 
+ * and deleting the actual file if there are no futher references to it.
+ *
+ * @param filePath path specifying file to be deleted.
+ * @param savedTagIDs save tag IDs for file replacement.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::deleteFile(std::string filePath, std::vector<std::string> *savedTagIDs)
+{
+    int returnValue = 1;
+    std::vector<std::string> parts = splitPathIntoParts(filePath);
+    std::string filename = popBackAndRemove(parts);
+    std::string parentFolderID = getFolderID(parts);
+    if (parentFolderID != "") // parent folder exists
+    {
+        std::string hash = getHash(filename, parentFolderID);
+        if (hash != "") // file exists
+        {
+            returnValue = 0;
+            macro_bind_text(stmts[COUNT_HASH_GT_1], hash);
+            bool isLastFileWithHash = std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_1])) == 0;
+            if (isLastFileWithHash) // delete actual file if its the last reference
+            {
+                returnValue = removeBlob(hash);
+                if (returnValue == -1)
+                {
+                    returnValue = errno;
+                }
+            }
+            if (returnValue == 0) // either unlink successful or not last reference
+            {
+                // remove all references to file in tags
+                std::string fileID = getFileID(filename, parentFolderID);
+                std::vector<std::string> tagIDs = getFileTagIDs(std::stoul(fileID));
+                for (auto &tagID : tagIDs)
+                {
+                    tagMemberships[tagID].remove(std::stoul(fileID));
+                    updateTagFileIDs(tagID);
+                }
+                updateTagCooccurrences(tagIDs, {}, false);
+                if (savedTagIDs != NULL)
+                {
+                    *savedTagIDs = tagIDs;
+                }
+                macro_bind_int(stmts[DELETE_FILE], fileID);
+                dbExecuteSV(stmts[DELETE_FILE]);
+                allFileIDs.remove(std::stoul(fileID));
+                allFilesGeneration++;
+                if (std::stoul(fileID) < fileAttributes.size())
+                {
+                    fileAttributes[std::stoul(fileID)] = {0, 0};
+                }
+                if (std::stoul(fileID) < fileTagCounts.size())
+                {
+                    fileTagCounts[std::stoul(fileID)] = 0;
+                }
+                untaggedFileIDs.remove(std::stoul(fileID));
+                updateSavedSearches(std::stoul(fileID), "");
+                addRemovedPath(filePath);
+            }
+        }
+    }
+    return returnValue;
+}
+
+/**
+ * Moves file or folder from old path to new path.
+ *
+ * @param oldPath path specifying file/folder to be moved.
+ * @param newPath destination where file/folder is to be moved.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::renamePath(std::string oldPath, std::string newPath)
+{
+    std::vector<std::string> parts = splitPathIntoParts(oldPath);
+    std::string oldName = popBackAndRemove(parts);
+    std::string oldParentFolderID = getFolderID(parts);
+    std::string oldFolderID = "", oldFileID = "";
+    if (oldParentFolderID != "") // source parent folder exists
+    {
+        oldFolderID = getFolderID(oldName, oldParentFolderID);
+        oldFileID = getFileID(oldName, oldParentFolderID);
+    }
+    parts = splitPathIntoParts(std::string(newPath));
+    std::string newName = popBackAndRemove(parts);
+    std::string newParentFolderID = getFolderID(parts);
+    std::string newFolderID = "", newFileID = "";
+    if (newParentFolderID != "") // destination parent folder exists
+    {
+        newFolderID = getFolderID(newName, newParentFolderID);
+        newFileID = getFileID(newName, newParentFolderID);
+    }
+    if (oldFileID != "" && newFolderID == "")
+    {
+        std::vector<std::string> fileTags = getFileTags(oldFileID);
+        for (auto tag : fileTags)
+        {
+            if (getTaggedFileID(getTagID(tag), newName) != "")
+            {
+                return EEXIST;
+            }
+        }
+        // old file exists, replace if new file exists
+        std::vector<std::string> savedTagIDs;
+        if (newFileID != "")
+        {
+            // TODO test if temporary system file beginning with ".goutput" etc.
+            deleteFile(newPath, &savedTagIDs);
+        }
+        int64_t movedAt = time(NULL);
+        macro_bind_text(stmts[RENAME_PATH_1], newName);
+        macro_bind_int(stmts[RENAME_PATH_1], newParentFolderID);
+        macro_bind_int64(stmts[RENAME_PATH_1], movedAt);
+        macro_bind_int(stmts[RENAME_PATH_1], oldFileID);
+        dbExecuteSV(stmts[RENAME_PATH_1]);
+        addRemovedPath(oldPath);
+        std::vector<std::string> otherTagIDs = getFileTagIDs(std::stoul(oldFileID));
+        std::vector<std::string> addedTagIDs;
+        for (auto tagID : savedTagIDs)
+        {
+            if (tagMemberships[tagID].add(std::stoul(oldFileID)))
+            {
+                updateTagFileIDs(tagID);
+                updateFileTagCount(std::stoul(oldFileID), true);
+                updateSavedSearches(std::stoul(oldFileID), tagID);
+                addedTagIDs.push_back(tagID);
+            }
+        }
+        updateTagCooccurrences(addedTagIDs, otherTagIDs, true);
+        if (addedTagIDs.empty() == false)
+        {
+            updateTaggedAt(oldFileID);
+        }
+        return 0;
+    }
+    else if (oldFolderID != "" && newFolderID == "" && newFileID == "")
+    {
+        // folder exists, no replacement
+        macro_bind_text(stmts[RENAME_PATH_2], newName);
+        macro_bind_int(stmts[RENAME_PATH_2], newParentFolderID);
+        macro_bind_int(stmts[RENAME_PATH_2], oldFolderID);
+        dbExecuteSV(stmts[RENAME_PATH_2]);
+        // files under the folder have new paths too
+        int64_t movedAt = time(NULL);
+        macro_bind_int(stmts[MARK_FOLDER_MOVED], oldFolderID);
+        macro_bind_int64(stmts[MARK_FOLDER_MOVED], movedAt);
+        dbExecuteSV(stmts[MARK_FOLDER_MOVED]);
+        addRemovedPath(oldPath);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Truncates specified file or a copy if there are other identical files.
+ *
+ * @param length length to which file is to be truncated.
+ * @param filePath path specifying file to be truncated.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::truncateFile(off_t length, std::string filePath)
+{
+    int returnValue = 1;
+    std::vector<std::string> parts = splitPathIntoParts(filePath);
+    std::string filename = popBackAndRemove(parts);
+    std::string parentFolderID = getFolderID(parts);
+    if (parentFolderID != "") // parent folder exists
+    {
+        std::string hash = getHash(filename, parentFolderID);
+        if (hash != "")
+        {
+            std::string filePath = getBlobPath(hash);
+            bool copyMade = false;
+            int copyError = 0;
+            macro_bind_text(stmts[COUNT_HASH_GT_1], hash);
+            if (access(filePath.c_str(), F_OK) != 0
+                && chunkStore.assemble(filePath, filePath + ".TRUNCATE", length))
+            {
+                // truncate copy of chunked file, chunks are shared with other files
+                filePath += ".TRUNCATE";
+                copyMade = true;
+            }
+            else if (std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_1])) == 1)
+            {
+                // truncate copy of file as other files with same hash exist, only the data
+                // kept is copied
+                copyError = copyFile(filePath, filePath + ".TRUNCATE", length);
+                filePath += ".TRUNCATE";
+                copyMade = true;
+            }
+            returnValue = (copyError != 0) ? -1 : truncate(filePath.c_str(), length);
+            if (returnValue == 0) // update if needed after truncate
+            {
+                std::string newHash = calculateHash(filePath);
+                // avoid renaming temp files
+                if (newHash != hash && newHash != hasher.getEmptyHash())
+                {
+                    storeBlob(filePath, newHash);
+                    std::string fileID = getFileID(filename, parentFolderID);
+                    updateHash(fileID, newHash);
+                    std::string oldHash = hash;
+                    macro_bind_text(stmts[COUNT_HASH_GT_0], oldHash);
+                    if (copyMade && std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_0])) == 0)
+                    {
+                        removeBlob(oldHash); // chunked file copied without other references
+                    }
+                }
+            }
+            else
+            {
+                returnValue = (copyError != 0) ? copyError : errno;
+            }
+            if (copyMade == true)
+            {
+                remove(filePath.c_str());
+            }
+            if (returnValue == 0)
+            {
+                updateFileAttributes(getFileID(filename, parentFolderID),
+                    getHash(filename, parentFolderID));
+            }
+        }
+        else
+        {
+            returnValue = ENOENT;
+        }
+    }
+    return returnValue;
 }
 
 /**
- * Gets folder's tag ID from the path to the folder.
+ * Updates file's value specified by given path after a write or a truncate operation.
  *
- * @param partsOfPath vector containing parts of the path to the folder.
- * @return Folder's tag ID as a string.
+ * @param filePath path specifying file whose hash value is to be updated.
+ * @param newHash hash value of the written file if calculated while it was written, empty if
+ * it has to be calculated.
  */
-std::string TFSManager::getFolderID(std::vector<std::string> &partsOfPath)
+void TFSManager::updateFile(std::string filePath, std::string newHash)
 {
-    std::string folderID;
-    int size = partsOfPath.size();
-    folderID = "1";
-    for (auto i = 0; i < size; i++)
+    std::vector<std::string> parts = splitPathIntoParts(filePath);
+    std::string filename = popBackAndRemove(parts);
+    std::string parentFolderID = getFolderID(parts); // assume path valid, file already open
+    std::string oldHash = getHash(filename, parentFolderID);
+    std::string tempFilePath = getBlobPath(oldHash) + ".WRITE";
+    bool tempExists = (access(tempFilePath.c_str(), F_OK) == 0);
+    if (tempExists)
     {
-        // sql query failed before exhausting path i.e. non-existent path
-        if (folderID == "")
+        // large files are stored under a pending name and hashed in the background, being read
+        // from the pending file in the meantime
+        struct stat attributes;
+        bool isPending = (newHash == "" && lstat(tempFilePath.c_str(), &attributes) == 0
+            && attributes.st_size >= TFS_BACKGROUND_HASH_MIN_SIZE);
+        // a small file rewritten with the same data is left as it is without being hashed, a
+        // large one is recognised once hashed in the background
+        if (newHash == "" && isPending == false
+            && isSameContents(tempFilePath, getBlobPath(oldHash)))
         {
-            return "";
+            newHash = oldHash;
+        }
+        if (isPending)
+        {
+            newHash = TFS_PENDING_HASH_PREFIX + std::to_string(pendingHashNumber++);
+        }
+        else if (newHash == "")
+        {
+            newHash = calculateHash(tempFilePath);
+        }
+        // avoid renaming temp files
+        if (oldHash != newHash && newHash != hasher.getEmptyHash())
+        {
+            if (isPending)
+            {
+                rename(tempFilePath.c_str(), getBlobPath(newHash, true).c_str());
+            }
+            else
+            {
+                storeBlob(tempFilePath, newHash);
+            }
+            std::string fileID = getFileID(filename, parentFolderID);
+            updateHash(fileID, newHash);
+            if (isPending && oldHash.compare(0, std::strlen(TFS_PENDING_HASH_PREFIX),
+                TFS_PENDING_HASH_PREFIX) != 0)
+            {
+                replacedHashes[newHash] = oldHash; // kept until the new hash value is known
+            }
+            else
+            {
+                removeUnusedBlob(oldHash);
+            }
+        }
+        else
+        {
+            remove(tempFilePath.c_str());
+        }
+        updateFileAttributes(getFileID(filename, parentFolderID),
+            getHash(filename, parentFolderID));
+        if (isPending)
+        {
+            hashingPool.hash(getBlobPath(newHash), newHash);
         }
-        folderID = getFolderID(partsOfPath[i], folderID);
     }
-    return folderID;
 }
 
 /**
- * Gets file's hash value from filename and the parent folder's tag ID.
- *
- * @param filename filename of file whose hash value is to be found.
- * @param parentFolderID parent folder's tag ID.
- * @return Hash value of the file from the database as a string.
+ * Queues the files left under pending names when the daemon last stopped to be hashed again.
  */
-std::string TFSManager::getHash(std::string filename, std::string parentFolderID)
+void TFSManager::resumePendingHashes()
 {
-    macro_bind_text(stmts[GET_HASH], filename);
-    macro_bind_int(stmts[GET_HASH], parentFolderID);
-    return dbExecuteSV(stmts[GET_HASH]);
+    for (auto &pendingName : dbExecuteMV(stmts[GET_PENDING_HASHES]))
+    {
+        hashingPool.hash(getBlobPath(pendingName), pendingName);
+    }
 }
 
 /**
- * Checks if a folder is empty.
+ * Stores a file hashed in the background under its hash value in place of its pending name,
+ * taking over the chunks it was split into by the hashing thread if any. Nothing is stored if
+ * the file was written to or deleted while it was being hashed as the pending file was removed
+ * along with the last reference to it, or if it was rewritten with the same data as the stored
+ * file it replaced, which is only removed once the new hash value is known.
  *
- * @param folderID tag ID of the folder to be checked.
- * @return Boolean indicating if folder is empty or not.
+ * @param pendingName name the file was stored under while it was being hashed.
+ * @param newHash hash value of the file, empty if it couldn't be read.
  */
-bool TFSManager::isFolderEmpty(std::string folderID)
+void TFSManager::finishPendingHash(std::string pendingName, std::string newHash)
 {
-    macro_bind_int(stmts[IS_FOLDER_EMPTY], folderID);
-    int isFolderEmpty = std::stoi(dbExecuteSV(stmts[IS_FOLDER_EMPTY]));
-    return (isFolderEmpty == 0);
+    std::string hash = pendingName;
+    macro_bind_text(stmts[GET_FILE_IDS_WITH_HASH], hash);
+    std::vector<std::string> fileIDs = dbExecuteMV(stmts[GET_FILE_IDS_WITH_HASH]);
+    std::string pendingPath = getBlobPath(pendingName);
+    std::string chunkedPath = pendingPath + TFS_PENDING_CHUNKED_SUFFIX;
+    Manifest manifest;
+    bool isChunked = ChunkStore::readManifest(chunkedPath, manifest);
+    std::string tempFilePath = pendingPath + ".WRITE";
+    std::string newTempFilePath = getBlobPath(newHash) + ".WRITE";
+    // a write begun after the file was released can't follow it to a name already being written
+    bool isWriteBlocked = newHash != "" && access(tempFilePath.c_str(), F_OK) == 0
+        && access(newTempFilePath.c_str(), F_OK) == 0;
+    std::string replacedHash = "";
+    auto replaced = replacedHashes.find(pendingName);
+    if (replaced != replacedHashes.end())
+    {
+        replacedHash = replaced->second;
+        replacedHashes.erase(replaced);
+    }
+    bool isUnchanged = (newHash != "" && newHash == replacedHash);
+    if (fileIDs.empty() || newHash == "" || isWriteBlocked || isUnchanged)
+    {
+        if (isChunked)
+        {
+            releaseChunks(manifest);
+            remove(ChunkStore::getManifestPath(chunkedPath).c_str());
+        }
+    }
+    if (fileIDs.empty())
+    {
+        // nothing to store
+    }
+    else if (isWriteBlocked)
+    {
+        // kept under the pending name until the write is released, hashed again on restart
+        log("TFSManager kept " + pendingName + " as " + newHash + " is being written");
+    }
+    else if (newHash == "")
+    {
+        // the file may have been moved by a layout migration after it was queued
+        if (access(pendingPath.c_str(), F_OK) == 0)
+        {
+            hashingPool.hash(pendingPath, pendingName);
+            if (replacedHash != "")
+            {
+                replacedHashes[pendingName] = replacedHash;
+            }
+        }
+        else
+        {
+            log("TFSManager failed to hash " + pendingName + ", file not found");
+        }
+    }
+    else
+    {
+        if (isUnchanged) // the stored file it replaced is kept instead
+        {
+            remove(pendingPath.c_str());
+        }
+        else if (isChunked)
+        {
+            storeChunkedBlob(pendingPath, newHash, manifest);
+        }
+        else // chunked here if the hashing thread didn't
+        {
+            storeBlob(pendingPath, newHash);
+        }
+        // a write begun after the file was released follows it to its new name
+        if (access(tempFilePath.c_str(), F_OK) == 0)
+        {
+            rename(tempFilePath.c_str(), newTempFilePath.c_str());
+        }
+        for (auto &fileID : fileIDs)
+        {
+            updateHash(fileID, newHash);
+            updateFileAttributes(fileID, newHash);
+        }
+    }
+    if (replacedHash != "" && replacedHashes.count(pendingName) == 0)
+    {
+        removeUnusedBlob(replacedHash);
+    }
 }
 
 /**
- * Updates the hash value after a write or a truncate operation with the given hash value.
+ * Removes the stored copy of a file from the root directory if no file refers to it anymore.
  *
- * @param fileID file ID of the file whose hash value is to be updated.
- * @param newHash new hash value to be inserted in place of the old value.
+ * @param oldHash hash value or temporary filename naming the stored copy of the file.
  */
-void TFSManager::updateHash(std::string fileID, std::string newHash)
+void TFSManager::removeUnusedBlob(std::string oldHash)
 {
-    macro_bind_text(stmts[UPDATE_HASH], newHash);
-    macro_bind_int(stmts[UPDATE_HASH], fileID);
-    dbExecuteSV(stmts[UPDATE_HASH]);
+    macro_bind_text(stmts[COUNT_HASH_GT_0], oldHash);
+    if (std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_0])) == 0)
+    {
+        removeBlob(oldHash);
+    }
 }
 
 /**
- * Gets the actual path to the file inside the root directory from the mounted path.
+ * Adds new entry for newly created file to files table pointing to an empty temporary file.
  *
- * @param relativePath mounted path to file whose actual path is to be found.
- * @return Actual path to the file specified by the mounted path.
+ * @param tempFilePath path to file to be created.
+ * @return Actual path the temporary file is to be created at.
  */
-std::string TFSManager::getFilePath(std::string relativePath)
+std::string TFSManager::addTemporaryFile(std::string tempFilePath)
 {
-    std::vector<std::string> parts = splitPathIntoParts(relativePath);
+    std::vector<std::string> args = splitAtFirstOccurance(tempFilePath, ',');
+    std::string tempFilename = args[0];
+    std::vector<std::string> parts = splitPathIntoParts(args[1]);
     std::string filename = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts);
-    if (parentFolderID != "") // parent folder exists
+    std::string parentFolderID = getFolderID(parts); // assume path vaild, path checked before
+    macro_bind_text(stmts[ADD_TEMPORARY_FILE], filename);
+    macro_bind_text(stmts[ADD_TEMPORARY_FILE], tempFilename);
+    macro_bind_int(stmts[ADD_TEMPORARY_FILE], parentFolderID);
+    int64_t addedAt = time(NULL);
+    macro_bind_int64(stmts[ADD_TEMPORARY_FILE], addedAt);
+    dbExecuteSV(stmts[ADD_TEMPORARY_FILE]);
+    std::string fileID = std::to_string(sqlite3_last_insert_rowid(db));
+    allFileIDs.add(std::stoul(fileID));
+    allFilesGeneration++;
+    updateFileAttributes(fileID, tempFilename);
+    if (std::stoul(fileID) < fileTagCounts.size())
     {
-        // need not check if file exists, path will be used by mknod
-        return rootDirectory + "/" + getHash(filename, parentFolderID);
+        fileTagCounts[std::stoul(fileID)] = 0;
     }
-    return "";
+    untaggedFileIDs.add(std::stoul(fileID));
+    updateSavedSearches(std::stoul(fileID), "");
+    return getBlobPath(tempFilename, true);
 }
 
 /**
- * Lists contents of the folder specified by the given path.
+ * Gets the actual path to the stored copy of a file in the root directory. Files of a root
+ * directory using the sharded layout are fanned out into two levels of folders so that no
+ * folder holds more than a small share of millions of files. While the layout is migrated, a
+ * file not moved yet is moved first so that its path is the same before and after.
  *
- * @param folderPath path to the folder whose contents are to be listed.
- * @return String vector containing contents of the folder.
+ * @param hash hash value or temporary filename naming the stored copy of the file.
+ * @param create boolean to create the folders the file is stored in if they don't exist.
+ * @return Actual path to the stored copy of the file.
  */
-std::vector<std::string> TFSManager::listFolder(std::string folderPath)
+std::string TFSManager::getBlobPath(std::string hash, bool create)
 {
-    std::vector<std::string> parts = splitPathIntoParts(folderPath);
-    std::string folderID = getFolderID(parts);
-    std::vector<std::string> contents;
-    if (folderID != "") // folder exists
+    if (layout == "flat")
     {
-        macro_bind_int(stmts[LIST_FOLDER_1], folderID);
-        contents = dbExecuteMV(stmts[LIST_FOLDER_1]);
-        macro_bind_int(stmts[LIST_FOLDER_2], folderID);
-        std::vector<std::string> filenames = dbExecuteMV(stmts[LIST_FOLDER_2]);
-        contents.reserve(contents.size() + filenames.size());
-        contents.insert(contents.end(), filenames.begin(), filenames.end());
+        return rootDirectory + "/" + hash;
     }
-    return contents;
+    if (layout == "migrating")
+    {
+        migrateBlob(hash);
+    }
+    return getShardedPath(rootDirectory, hash, create);
 }
 
 /**
- * Creates folder specified by given path by inserting a new row into tags table.
+ * Starts moving the stored copies of all files of a root directory from a single folder into
+ * the sharded layout along with their manifests and temporary copies, and any chunks stored
+ * in a single folder. Files are moved in batches by migrateLayoutBatch() while no messages are
+ * waiting. The layout is recorded as migrating on disk before any file is moved so that an
+ * interrupted migration is resumed when the daemon starts again.
  *
- * @param folderPath path specifying where folder is to be created and its name.
- * @return 0 if successful or error value indicating the error.
+ * @return Number of files and chunks to be moved.
  */
-int TFSManager::createFolder(std::string folderPath)
+uint64_t TFSManager::migrateLayout()
 {
-    std::vector<std::string> parts = splitPathIntoParts(folderPath);
-    std::string newFolderName = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts);
-    if (parentFolderID != "") // parent folder exists
+    layout = "migrating";
+    setVariable("layout", layout);
+    if (memoryBudget == 0) // in-memory catalog is otherwise only saved at shutdown
     {
-        std::string fileID = getFileID(newFolderName, parentFolderID);
-        std::string folderID = getFolderID(newFolderName, parentFolderID);
-        if (fileID == "" && folderID == "") // no conflict
-        {
-            macro_bind_text(stmts[CREATE_FOLDER], newFolderName);
-            macro_bind_int(stmts[CREATE_FOLDER], parentFolderID);
-            dbExecuteSV(stmts[CREATE_FOLDER]);
-            return 0;
-        }
-        return EEXIST; // file/folder with same name exists
+        saveDBToStorage();
     }
-    return ENOENT; // invalid path to folder to be created
+    migratingHashes = dbExecuteMV(stmts[GET_ALL_HASHES]);
+    migratingChunkHashes = dbExecuteMV(stmts[GET_ALL_CHUNKS]);
+    log("TFSManager migrating " + std::to_string(migratingHashes.size()) + " files and "
+        + std::to_string(migratingChunkHashes.size()) + " chunks to the sharded layout");
+    return migratingHashes.size() + migratingChunkHashes.size();
 }
 
 /**
- * Deletes folder specified by given path by removing its row entry from tags table.
- *
- * @param folderPath path specifying folder to be deleted.
- * @return 0 if successful or error value indicating the error.
+ * Moves the next batch of files or chunks into the sharded layout, recording the layout as
+ * sharded once all are moved.
  */
-int TFSManager::deleteFolder(std::string folderPath)
+void TFSManager::migrateLayoutBatch()
 {
-    std::vector<std::string> parts = splitPathIntoParts(folderPath);
-    std::string folderID = getFolderID(parts);
-    if (folderID != "") // folder exists
+    for (std::size_t i = 0; i < TFS_MIGRATION_BATCH_SIZE && !migratingHashes.empty(); i++)
     {
-        if (isFolderEmpty(folderID) == true) // folder empty, proceed with delete
+        migrateBlob(migratingHashes.back());
+        migratingHashes.pop_back();
+    }
+    for (std::size_t i = 0; i < TFS_MIGRATION_BATCH_SIZE && migratingHashes.empty()
+        && !migratingChunkHashes.empty(); i++)
+    {
+        std::string &chunkHash = migratingChunkHashes.back();
+        std::string flatPath = rootDirectory + "/chunks/" + chunkHash;
+        if (access(flatPath.c_str(), F_OK) == 0)
         {
-            macro_bind_int(stmts[DELETE_FOLDER], folderID);
-            dbExecuteSV(stmts[DELETE_FOLDER]);
-            return 0;
+            rename(flatPath.c_str(), chunkStore.getChunkPath(chunkHash, true).c_str());
         }
-        return ENOTEMPTY; // folder not empty
+        migratingChunkHashes.pop_back();
+    }
+    if (migratingHashes.empty() && migratingChunkHashes.empty())
+    {
+        layout = "sharded";
+        setVariable("layout", layout);
+        if (memoryBudget == 0)
+        {
+            saveDBToStorage();
+        }
+        log("TFSManager finished migrating to the sharded layout");
     }
-    return ENOENT; // path invalid
 }
 
 /**
- * Deletes file specified by given path by removing its row entry from the files table 
- * and deleting the actual file if there are no futher references to it.
+ * Moves the stored copy of a file from a single folder into the sharded layout along with its
+ * manifest and temporary copies if it wasn't moved yet.
  *
- * @param filePath path specifying file to be deleted.
- * @param savedTagIDs save tag IDs for file replacement.
- * @return 0 if successful or error value indicating the error.
+ * @param hash hash value or temporary filename naming the stored copy of the file.
+ * @return Number of files moved.
  */
-int TFSManager::deleteFile(std::string filePath, std::vector<std::string> *savedTagIDs)
+uint64_t TFSManager::migrateBlob(std::string hash)
 {
-    int returnValue = 1;
-    std::vector<std::string> parts = splitPathIntoParts(filePath);
-    std::string filename = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts);
-    if (parentFolderID != "") // parent folder exists
+    uint64_t numberOfMovedFiles = 0;
+    std::string flatPath = rootDirectory + "/" + hash;
+    std::string shardedPath = "";
+    for (std::string suffix : {"", ".manifest", ".WRITE", ".TRUNCATE",
+        TFS_PENDING_CHUNKED_SUFFIX ".manifest"})
     {
-        std::string hash = getHash(filename, parentFolderID);
-        if (hash != "") // file exists
+        if (access((flatPath + suffix).c_str(), F_OK) != 0)
         {
-            returnValue = 0;
-            std::string filePath = rootDirectory + "/" + hash;
-            macro_bind_text(stmts[COUNT_HASH_GT_1], hash);
-            bool isLastFileWithHash = std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_1])) == 0;
-            if (isLastFileWithHash) // delete actual file if its the last reference
-            {
-                returnValue = unlink(filePath.c_str());
-                if (returnValue == -1)
-                {
-                    returnValue = errno;
-                }
-            }
-            if (returnValue == 0) // either unlink successful or not last reference
-            {
-                // remove all references to file in tags
-                std::string fileID = getFileID(filename, parentFolderID);
-                std::vector<std::string> allTagIDs = getAllTagIDs();
-                if (savedTagIDs != NULL)
-                {
-                    savedTagIDs->clear();
-                }
-                for (auto tagID : allTagIDs)
-                {
-                    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-                    auto result = std::find(fileIDs.begin(), fileIDs.end(), fileID);
-                    if (result != fileIDs.end())
-                    {
-                        fileIDs.erase(result);
-                        updateTagFileIDs(tagID, fileIDs);
-                        if (savedTagIDs != NULL)
-                        {
-                            savedTagIDs->push_back(tagID);
-                        }
-                    }
-                }
-                macro_bind_int(stmts[DELETE_FILE], fileID);
-                dbExecuteSV(stmts[DELETE_FILE]);
-            }
+            continue;
+        }
+        if (shardedPath == "")
+        {
+            shardedPath = getShardedPath(rootDirectory, hash, true);
+        }
+        if (rename((flatPath + suffix).c_str(), (shardedPath + suffix).c_str()) == 0)
+        {
+            numberOfMovedFiles++;
         }
     }
-    return returnValue;
+    return numberOfMovedFiles;
 }
 
 /**
- * Moves file or folder from old path to new path.
+ * Moves a written file into the root directory under its hash value. Large files are split into
+ * chunks if chunking is enabled, storing only the chunks not already stored for other files.
  *
- * @param oldPath path specifying file/folder to be moved.
- * @param newPath destination where file/folder is to be moved.
- * @return 0 if successful or error value indicating the error.
+ * @param path path to the written file, removed once stored.
+ * @param hash hash value of the written file.
  */
-int TFSManager::renamePath(std::string oldPath, std::string newPath)
+void TFSManager::storeBlob(std::string path, std::string hash)
 {
-    std::vector<std::string> parts = splitPathIntoParts(oldPath);
-    std::string oldName = popBackAndRemove(parts);
-    std::string oldParentFolderID = getFolderID(parts);
-    std::string oldFolderID = "", oldFileID = "";
-    if (oldParentFolderID != "") // source parent folder exists
-    {
-        oldFolderID = getFolderID(oldName, oldParentFolderID);
-        oldFileID = getFileID(oldName, oldParentFolderID);
-    }
-    parts = splitPathIntoParts(std::string(newPath));
-    std::string newName = popBackAndRemove(parts);
-    std::string newParentFolderID = getFolderID(parts);
-    std::string newFolderID = "", newFileID = "";
-    if (newParentFolderID != "") // destination parent folder exists
+    std::string blobPath = getBlobPath(hash, true);
+    struct stat attributes;
+    // files stored whole before chunking was enabled stay whole
+    if (enableChunking && access(blobPath.c_str(), F_OK) != 0
+        && lstat(path.c_str(), &attributes) == 0
+        && attributes.st_size >= TFS_CHUNKED_FILE_MIN_SIZE)
     {
-        newFolderID = getFolderID(newName, newParentFolderID);
-        newFileID = getFileID(newName, newParentFolderID);
-    }
-    if (oldFileID != "" && newFolderID == "")
-    {
-        std::vector<std::string> fileTags = getFileTags(oldFileID);
-        for (auto tag : fileTags)
+        if (access(ChunkStore::getManifestPath(blobPath).c_str(), F_OK) == 0)
+        {
+            remove(path.c_str()); // same data already stored in chunks
+            return;
+        }
+        std::vector<std::string> chunkHashes;
+        if (chunkStore.storeFile(path, blobPath, hasher, chunkHashes))
         {
-            std::vector<std::string> filenames = getFilenamesUnderTagID(getTagID(tag));
-            auto result = std::find(filenames.begin(), filenames.end(), newName);
-            if (result != filenames.end())
+            for (auto &chunkHash : chunkHashes)
             {
-                return EEXIST;
+                updateChunkReferences(chunkHash, 1);
             }
+            remove(path.c_str());
+            return;
         }
-        // old file exists, replace if new file exists
-        std::vector<std::string> savedTagIDs;
-        if (newFileID != "")
-        {
-            // TODO test if temporary system file beginning with ".goutput" etc.
-            deleteFile(newPath, &savedTagIDs);
-        }
-        macro_bind_text(stmts[RENAME_PATH_1], newName);
-        macro_bind_int(stmts[RENAME_PATH_1], newParentFolderID);
-        macro_bind_int(stmts[RENAME_PATH_1], oldFileID);
-        dbExecuteSV(stmts[RENAME_PATH_1]);
-        for (auto tagID : savedTagIDs)
+        log("TFSManager failed to store " + hash + " in chunks, storing it whole");
+    }
+    rename(path.c_str(), blobPath.c_str());
+}
+
+/**
+ * Stores a file split into chunks by a hashing thread under its hash value, taking the
+ * references to its chunks. The file is stored whole instead if one of its chunks was removed
+ * after the hashing thread found it already stored.
+ *
+ * @param path path to the written file, removed once stored.
+ * @param hash hash value of the written file.
+ * @param manifest manifest of the chunks the file was split into.
+ */
+void TFSManager::storeChunkedBlob(std::string path, std::string hash, const Manifest &manifest)
+{
+    std::string chunkedManifestPath = ChunkStore::getManifestPath(path
+        + TFS_PENDING_CHUNKED_SUFFIX);
+    std::string blobPath = getBlobPath(hash, true);
+    std::string manifestPath = ChunkStore::getManifestPath(blobPath);
+    bool isStored = access(blobPath.c_str(), F_OK) == 0
+        || access(manifestPath.c_str(), F_OK) == 0;
+    bool isComplete = true;
+    for (std::size_t i = 0; isStored == false && isComplete && i < manifest.chunks.size(); i++)
+    {
+        isComplete = access(chunkStore.getChunkPath(manifest.chunks[i].hash).c_str(), F_OK) == 0;
+    }
+    if (isStored == false && isComplete
+        && rename(chunkedManifestPath.c_str(), manifestPath.c_str()) == 0)
+    {
+        for (auto &chunk : manifest.chunks)
         {
-            std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-            fileIDs.push_back(oldFileID);
-            updateTagFileIDs(tagID, fileIDs);
+            updateChunkReferences(chunk.hash, 1);
         }
-        return 0;
+        remove(path.c_str());
+        return;
     }
-    else if (oldFolderID != "" && newFolderID == "" && newFileID == "")
+    releaseChunks(manifest);
+    remove(chunkedManifestPath.c_str());
+    if (isStored) // same data already stored
     {
-        // folder exists, no replacement
-        macro_bind_text(stmts[RENAME_PATH_2], newName);
-        macro_bind_int(stmts[RENAME_PATH_2], newParentFolderID);
-        macro_bind_int(stmts[RENAME_PATH_2], oldFolderID);
-        dbExecuteSV(stmts[RENAME_PATH_2]);
-        return 0;
+        remove(path.c_str());
+    }
+    else
+    {
+        log("TFSManager found a chunk of " + hash + " removed, storing it whole");
+        rename(path.c_str(), blobPath.c_str());
     }
-    return 1;
 }
 
 /**
- * Truncates specified file or a copy if there are other identical files.
+ * Removes the chunks of a manifest not taken over by the daemon which no other manifest refers
+ * to, leaving the references to the other chunks as they are.
  *
- * @param length length to which file is to be truncated.
- * @param filePath path specifying file to be truncated.
- * @return 0 if successful or error value indicating the error.
+ * @param manifest manifest of the chunks.
  */
-int TFSManager::truncateFile(off_t length, std::string filePath)
+void TFSManager::releaseChunks(const Manifest &manifest)
 {
-    int returnValue = 1;
-    std::vector<std::string> parts = splitPathIntoParts(filePath);
-    std::string filename = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts);
-    if (parentFolderID != "") // parent folder exists
+    for (auto &chunk : manifest.chunks)
     {
-        std::string hash = getHash(filename, parentFolderID);
-        if (hash != "")
+        updateChunkReferences(chunk.hash, 1);
+        updateChunkReferences(chunk.hash, -1);
+    }
+}
+
+/**
+ * Removes the stored copy of a file from the root directory once no file refers to it. The
+ * chunks of a chunked file are removed once no other manifest refers to them and the driver
+ * has released the file.
+ *
+ * @param hash hash value of the stored file.
+ * @return Return value from unlink() called on the file or its manifest.
+ */
+int TFSManager::removeBlob(std::string hash)
+{
+    std::string blobPath = getBlobPath(hash);
+    Manifest manifest;
+    if (ChunkStore::readManifest(blobPath, manifest))
+    {
+        int returnValue = unlink(ChunkStore::getManifestPath(blobPath).c_str());
+        if (returnValue == 0)
         {
-            std::string filePath = rootDirectory + "/" + hash;
-            bool copyMade = false;
-            macro_bind_text(stmts[COUNT_HASH_GT_1], hash);
-            if (std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_1])) == 1)
-            {
-                // truncate copy of file as other files with same hash exist
-                std::string command = "cp " + filePath + " " + filePath + ".TRUNCATE";
-                system(command.c_str());
-                filePath += ".TRUNCATE";
-                copyMade = true;
-            }
-            returnValue = truncate(filePath.c_str(), length);
-            if (returnValue == 0) // update if needed after truncate
+            for (auto &chunk : manifest.chunks)
             {
-                std::string newHash = calculateHash(filePath);
-                // avoid renaming temp files
-                if (newHash != hash && newHash != "D41D8CD98F00B204E9800998ECF8427E")
+                if (chunkPins.count(hash) != 0) // still being read, removed on release
                 {
-                    rename(filePath.c_str(), (rootDirectory + "/" + newHash).c_str());
-                    std::string fileID = getFileID(filename, parentFolderID);
-                    updateHash(fileID, newHash);
+                    unpinnedChunks[hash].push_back(chunk.hash);
+                }
+                else
+                {
+                    updateChunkReferences(chunk.hash, -1);
                 }
             }
-            else
-            {
-                returnValue = errno;
-            }
-            if (copyMade == true)
-            {
-                remove(filePath.c_str());
-            }
-        }
-        else
-        {
-            returnValue = ENOENT;
         }
+        return returnValue;
     }
-    return returnValue;
+    return unlink(blobPath.c_str());
 }
 
 /**
- * Updates file's value specified by given path after a write or a truncate operation.
+ * Adds to the number of references to a chunk and removes the chunk once none are left.
  *
- * @param filePath path specifying file whose hash value is to be updated.
+ * @param chunkHash hash value of the chunk.
+ * @param change number of references added, negative if references are removed.
  */
-void TFSManager::updateFile(std::string filePath)
+void TFSManager::updateChunkReferences(std::string chunkHash, int64_t change)
 {
-    std::vector<std::string> parts = splitPathIntoParts(filePath);
-    std::string filename = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts); // assume path valid, file already open
-    std::string oldHash = getHash(filename, parentFolderID);
-    std::string tempFilePath = rootDirectory + "/" + oldHash + ".WRITE";
-    bool tempExists = (access(tempFilePath.c_str(), F_OK) == 0);
-    if (tempExists)
+    if (change > 0)
     {
-        std::string newHash = calculateHash(tempFilePath);
-        // avoid renaming temp files
-        if (oldHash != newHash && newHash != "D41D8CD98F00B204E9800998ECF8427E")
-        {
-            rename(tempFilePath.c_str(), (rootDirectory + "/" + newHash).c_str());
-            std::string fileID = getFileID(filename, parentFolderID);
-            updateHash(fileID, newHash);
-            macro_bind_text(stmts[COUNT_HASH_GT_0], oldHash);
-            if (std::stoi(dbExecuteSV(stmts[COUNT_HASH_GT_0])) == 0)
-            {
-                remove((rootDirectory + "/" + oldHash).c_str());
-            }
-        }
-        else
+        macro_bind_text(stmts[ADD_CHUNK], chunkHash);
+        dbExecuteSV(stmts[ADD_CHUNK]);
+    }
+    macro_bind_int64(stmts[UPDATE_CHUNK_REFERENCES], change);
+    macro_bind_text(stmts[UPDATE_CHUNK_REFERENCES], chunkHash);
+    dbExecuteSV(stmts[UPDATE_CHUNK_REFERENCES]);
+    macro_bind_text(stmts[GET_CHUNK_REFERENCES], chunkHash);
+    std::string references = dbExecuteSV(stmts[GET_CHUNK_REFERENCES]);
+    if (references != "" && std::stoll(references) <= 0)
+    {
+        macro_bind_text(stmts[DELETE_CHUNK], chunkHash);
+        dbExecuteSV(stmts[DELETE_CHUNK]);
+        remove(chunkStore.getChunkPath(chunkHash).c_str());
+        if (layout == "migrating") // not moved yet
         {
-            remove(tempFilePath.c_str());
+            remove((rootDirectory + "/chunks/" + chunkHash).c_str());
         }
     }
 }
 
 /**
- * Adds new entry for newly created file to files table pointing to an empty temporary file.
+ * Releases a chunked file opened by the driver, dropping the references to its chunks once no
+ * handle reads it if it was removed in the meantime.
  *
- * @param tempFilePath path to file to be created.
+ * @param hash hash value of the chunked file.
  */
-void TFSManager::addTemporaryFile(std::string tempFilePath)
+void TFSManager::unpinChunks(std::string hash)
 {
-    std::vector<std::string> args = splitAtFirstOccurance(tempFilePath, ',');
-    std::string tempFilename = args[0];
-    std::vector<std::string> parts = splitPathIntoParts(args[1]);
-    std::string filename = popBackAndRemove(parts);
-    std::string parentFolderID = getFolderID(parts); // assume path vaild, path checked before
-    macro_bind_text(stmts[ADD_TEMPORARY_FILE], filename);
-    macro_bind_text(stmts[ADD_TEMPORARY_FILE], tempFilename);
-    macro_bind_int(stmts[ADD_TEMPORARY_FILE], parentFolderID);
-    dbExecuteSV(stmts[ADD_TEMPORARY_FILE]);
+    auto pins = chunkPins.find(hash);
+    if (pins == chunkPins.end() || --pins->second > 0)
+    {
+        return;
+    }
+    chunkPins.erase(pins);
+    auto chunks = unpinnedChunks.find(hash);
+    if (chunks != unpinnedChunks.end())
+    {
+        for (auto &chunkHash : chunks->second)
+        {
+            updateChunkReferences(chunkHash, -1);
+        }
+        unpinnedChunks.erase(chunks);
+    }
 }
 
 /**************************************************************************************************
@@ -1362,6 +3338,285 @@ std::string formatIDsForSQL(std::vector<std::string> ids)
     return idsFormattedForSQL;
 }
 
+/**
+ * Gets the path of a folder ending with '/' by walking up its parent folders. Paths found are
+ * saved so that folders shared by many files are only resolved once.
+ *
+ * @param folderID tag ID of the folder.
+ * @param folderPaths paths of folders already resolved keyed by their tag IDs.
+ * @return Path of the folder or an empty string if it doesn't exist.
+ */
+std::string TFSManager::getFolderPath(std::string folderID,
+    std::unordered_map<std::string, std::string> &folderPaths)
+{
+    folderPaths.emplace("1", "/");
+    std::vector<std::pair<std::string, std::string>> unresolved; // folder ID and name
+    auto resolved = folderPaths.find(folderID);
+    while (resolved == folderPaths.end())
+    {
+        macro_bind_int(stmts[GET_FOLDER_NAME_AND_PARENT], folderID);
+        std::vector<std::vector<std::string>> rows = dbExecuteMR(stmts[GET_FOLDER_NAME_AND_PARENT]);
+        if (rows.empty() || rows[0][1] == "0") // not a folder
+        {
+            resolved = folderPaths.emplace(folderID, "").first;
+            break;
+        }
+        unresolved.push_back({folderID, rows[0][0]});
+        folderID = rows[0][1];
+        resolved = folderPaths.find(folderID);
+    }
+    std::string path = resolved->second;
+    while (!unresolved.empty())
+    {
+        path = (path == "") ? "" : path + unresolved.back().second + "/";
+        folderPaths[unresolved.back().first] = path;
+        unresolved.pop_back();
+    }
+    return path;
+}
+
+/**
+ * Gets the paths of the given files with a single query, resolving the path of each folder
+ * only once.
+ *
+ * @param fileIDs file IDs of the files.
+ * @param folderPaths paths of folders already resolved keyed by their tag IDs.
+ * @return Paths of the files in the same order as the file IDs.
+ */
+std::vector<std::string> TFSManager::getFilePathsFromIDs(const std::vector<uint32_t> &fileIDs,
+    std::unordered_map<std::string, std::string> &folderPaths)
+{
+    std::vector<std::string> ids;
+    for (auto id : fileIDs)
+    {
+        ids.push_back(std::to_string(id));
+    }
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT file_id, filename, parent_folder FROM files WHERE "
+        "file_id IN (" + formatIDsForSQL(ids) + ");";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        return std::vector<std::string>(fileIDs.size());
+    }
+    std::unordered_map<std::string, std::string> filePaths;
+    for (auto row : dbExecuteMR(stmt))
+    {
+        filePaths[row[0]] = getFolderPath(row[2], folderPaths) + row[1];
+    }
+    sqlite3_finalize(stmt);
+    std::vector<std::string> paths;
+    for (auto id : ids)
+    {
+        paths.push_back(filePaths[id]);
+    }
+    return paths;
+}
+
+/**
+ * Pushes an item into a heap holding at most the given number of the smallest items seen.
+ *
+ * @param heap heap whose top is the largest item kept.
+ * @param item item to be pushed.
+ * @param count maximum number of items kept, 0 to keep all items.
+ */
+template <typename Item>
+void pushBounded(std::priority_queue<Item> &heap, Item item, std::size_t count)
+{
+    if (count == 0 || heap.size() < count)
+    {
+        heap.push(std::move(item));
+    }
+    else if (item < heap.top())
+    {
+        heap.pop();
+        heap.push(std::move(item));
+    }
+}
+
+/**
+ * Moves the items of a heap into a vector from the smallest to the largest.
+ *
+ * @param heap heap whose top is the largest item.
+ * @return File IDs of the items in order.
+ */
+template <typename Item>
+std::vector<uint32_t> drainHeap(std::priority_queue<Item> &heap)
+{
+    std::vector<uint32_t> fileIDs(heap.size());
+    for (std::size_t i = fileIDs.size(); i > 0; i--)
+    {
+        fileIDs[i - 1] = heap.top().second;
+        heap.pop();
+    }
+    return fileIDs;
+}
+
+/**
+ * Gets the sizes and modification times of files, read from the catalog with a memory budget.
+ *
+ * @param fileIDs file IDs of the files.
+ * @return Attributes of the files keyed by their file IDs.
+ */
+std::unordered_map<uint32_t, FileAttributes> TFSManager::getFileAttributes(
+    const std::vector<uint32_t> &fileIDs)
+{
+    std::unordered_map<uint32_t, FileAttributes> attributes;
+    if (memoryBudget == 0)
+    {
+        for (auto id : fileIDs)
+        {
+            if (id < fileAttributes.size())
+            {
+                attributes[id] = fileAttributes[id];
+            }
+        }
+        return attributes;
+    }
+    std::vector<std::string> ids;
+    for (auto id : fileIDs)
+    {
+        ids.push_back(std::to_string(id));
+    }
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT file_id, size, mtime FROM files WHERE file_id IN ("
+        + formatIDsForSQL(ids) + ");";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        return attributes;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        attributes[uint32_t(sqlite3_column_int64(stmt, 0))] = {
+            uint64_t(sqlite3_column_int64(stmt, 1)), sqlite3_column_int64(stmt, 2)};
+    }
+    sqlite3_finalize(stmt);
+    return attributes;
+}
+
+/**
+ * Finds the largest or most recently modified files found by a search by walking the index of
+ * the attribute in the catalog from the top until enough of them were found, along with the
+ * files tied with the last of them so that ties are ordered by file ID as when sorted in memory.
+ *
+ * @param matches file IDs of the files found.
+ * @param sort attribute the files are sorted by, size or modification time.
+ * @param count number of files wanted.
+ * @return File IDs of up to count files in order.
+ */
+std::vector<uint32_t> TFSManager::sortFileIDsByIndex(const Bitmap &matches, SortOrder sort,
+    std::size_t count)
+{
+    std::string column = (sort == SORT_SIZE) ? "size" : "mtime";
+    std::vector<std::pair<int64_t, uint32_t>> found; // negated key and file ID
+    sqlite3_stmt *stmt;
+    const std::string statement = "SELECT " + column + ", file_id FROM files INDEXED BY files_"
+        + column + " ORDER BY " + column + " DESC;";
+    if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log("TFSManager sqlite3_prepare_v2() failed, ERROR: " + std::string(sqlite3_errmsg(db)));
+        return std::vector<uint32_t>();
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int64_t key = sqlite3_column_int64(stmt, 0);
+        if (found.size() >= count && -found[count - 1].first != key)
+        {
+            break;
+        }
+        uint32_t id = sqlite3_column_int64(stmt, 1);
+        if (matches.contains(id))
+        {
+            found.push_back(std::make_pair(-key, id));
+        }
+    }
+    sqlite3_finalize(stmt);
+    std::sort(found.begin(), found.end());
+    std::vector<uint32_t> fileIDs;
+    for (std::size_t i = 0; i < found.size() && i < count; i++)
+    {
+        fileIDs.push_back(found[i].second);
+    }
+    return fileIDs;
+}
+
+/**
+ * Sorts the files found by a search by their stored attributes without accessing the files,
+ * keeping only the requested page in a bounded heap so that the top results of a large search
+ * are found in O(n log k). With a memory budget, a page of a search finding most files is
+ * found by walking the index of the attribute instead.
+ *
+ * @param matches file IDs of the files found.
+ * @param options options of the search specifying the order and the page.
+ * @return File IDs of the page of files in order.
+ */
+std::vector<uint32_t> TFSManager::sortFileIDs(const Bitmap &matches, const SearchOptions &options)
+{
+    std::size_t count = (options.limit == 0) ? 0 : options.offset + options.limit;
+    std::vector<uint32_t> fileIDs;
+    uint64_t next = 0;
+    if (options.sort == SORT_NAME)
+    {
+        std::priority_queue<std::pair<std::string, uint32_t>> heap;
+        while (!(fileIDs = matches.toVector(next, 0, TFS_SORT_BATCH_SIZE)).empty())
+        {
+            next = uint64_t(fileIDs.back()) + 1;
+            std::vector<std::string> ids;
+            for (auto id : fileIDs)
+            {
+                ids.push_back(std::to_string(id));
+            }
+            sqlite3_stmt *stmt;
+            const std::string statement = "SELECT filename, file_id FROM files WHERE "
+                "file_id IN (" + formatIDsForSQL(ids) + ");";
+            if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+            {
+                log("TFSManager sqlite3_prepare_v2() failed, ERROR: "
+                    + std::string(sqlite3_errmsg(db)));
+                return std::vector<uint32_t>();
+            }
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                pushBounded(heap, std::make_pair(std::string(reinterpret_cast<const char *>(
+                    sqlite3_column_text(stmt, 0))), uint32_t(sqlite3_column_int64(stmt, 1))),
+                    count);
+            }
+            sqlite3_finalize(stmt);
+        }
+        fileIDs = drainHeap(heap);
+    }
+    else if (memoryBudget != 0 && count != 0 && count * allFileIDs.cardinality()
+        < matches.cardinality() * matches.cardinality())
+    {
+        // fewer files are read from the index than there are files found
+        fileIDs = sortFileIDsByIndex(matches, options.sort, count);
+    }
+    else
+    {
+        // keys are negated so that the largest and most recent files are the smallest items
+        std::priority_queue<std::pair<int64_t, uint32_t>> heap;
+        while (!(fileIDs = matches.toVector(next, 0, TFS_SORT_BATCH_SIZE)).empty())
+        {
+            next = uint64_t(fileIDs.back()) + 1;
+            std::unordered_map<uint32_t, FileAttributes> attributes = getFileAttributes(fileIDs);
+            for (auto id : fileIDs)
+            {
+                auto found = attributes.find(id);
+                FileAttributes attribute = (found == attributes.end()) ? FileAttributes{0, 0}
+                    : found->second;
+                int64_t key = (options.sort == SORT_SIZE) ? int64_t(attribute.size)
+                    : attribute.mtime;
+                pushBounded(heap, std::make_pair(-key, id), count);
+            }
+        }
+        fileIDs = drainHeap(heap);
+    }
+    fileIDs.erase(fileIDs.begin(), fileIDs.begin() + std::min(fileIDs.size(),
+        std::size_t(options.offset)));
+    return fileIDs;
+}
+
 /**
  * Gets tag ID from the mounted path to the tag in tag view mode.
  *
@@ -1395,32 +3650,130 @@ std::string TFSManager::getTagID(std::string tagPath)
         }
         return tagID;
     }
-    macro_bind_text(stmts[GET_TAG_ID], tag);
-    return dbExecuteSV(stmts[GET_TAG_ID]);
+    auto result = std::lower_bound(tagNameIndex.begin(), tagNameIndex.end(),
+        std::make_pair(tag, std::string()));
+    return (result != tagNameIndex.end() && result->first == tag) ? result->second : "";
+}
+
+/**
+ * Gets tag name from corresponding tag ID.
+ *
+ * @param tagID tag ID whose name is to be found.
+ * @return tag name.
+ */
+std::string TFSManager::getTagNameFromID(std::string tagID)
+{
+    macro_bind_int(stmts[GET_TAG_NAME_FROM_ID], tagID);
+    return dbExecuteSV(stmts[GET_TAG_NAME_FROM_ID]);
+}
+
+/**
+ * Gets parent tag ID of a tag or tagged file specified by path in tag view mode.
+ *
+ * @param tagPath path to tag or tagged file in tag view mode.
+ * @return Tag ID of the parent tag.
+ */
+std::string TFSManager::getParentTagIDFromPath(std::string tagPath)
+{
+    std::string parentTag = tagPath.substr(0, tagPath.find_last_of('/'));
+    return (parentTag == "") ? "0" : getTagID(parentTag);
+}
+
+/**
+ * Adds tag name to the index of tag names.
+ *
+ * @param tag name of the tag.
+ * @param tagID tag ID of the tag.
+ */
+void TFSManager::indexTagName(std::string tag, std::string tagID)
+{
+    auto position = std::lower_bound(tagNameIndex.begin(), tagNameIndex.end(),
+        std::make_pair(tag, std::string()));
+    tagNameIndex.insert(position, std::make_pair(tag, tagID));
+}
+
+/**
+ * Removes tag name from the index of tag names.
+ *
+ * @param tag name of the tag.
+ */
+void TFSManager::unindexTagName(std::string tag)
+{
+    auto position = std::lower_bound(tagNameIndex.begin(), tagNameIndex.end(),
+        std::make_pair(tag, std::string()));
+    if (position != tagNameIndex.end() && position->first == tag)
+    {
+        tagNameIndex.erase(position);
+    }
 }
 
 /**
- * Gets tag name from corresponding tag ID.
+ * Checks if the characters of the pattern appear in the same order in the text ignoring case.
  *
- * @param tagID tag ID whose name is to be found.
- * @return tag name.
+ * @param pattern characters to be found.
+ * @param text text to be searched.
+ * @return Boolean indicating if the pattern was found.
  */
-std::string TFSManager::getTagNameFromID(std::string tagID)
+bool isSubsequence(const std::string &pattern, const std::string &text)
 {
-    macro_bind_int(stmts[GET_TAG_NAME_FROM_ID], tagID);
-    return dbExecuteSV(stmts[GET_TAG_NAME_FROM_ID]);
+    std::size_t i = 0;
+    for (std::size_t j = 0; i < pattern.length() && j < text.length(); j++)
+    {
+        if (tolower(pattern[i]) == tolower(text[j]))
+        {
+            i++;
+        }
+    }
+    return i == pattern.length();
 }
 
 /**
- * Gets parent tag ID of a tag or tagged file specified by path in tag view mode.
+ * Finds tags whose names start with the given prefix or contain its characters in order if
+ * fuzzy, ranked by the number of files tagged with them.
  *
- * @param tagPath path to tag or tagged file in tag view mode.
- * @return Tag ID of the parent tag.
+ * @param prefix prefix of the tag names.
+ * @param limit maximum number of tags to be found.
+ * @param fuzzy boolean to indicate if the characters of the prefix may be apart.
+ * @return Tag names paired with their number of files in descending order of files.
  */
-std::string TFSManager::getParentTagIDFromPath(std::string tagPath)
+std::vector<std::pair<std::string, uint64_t>> TFSManager::completeTag(std::string prefix,
+    std::size_t limit, bool fuzzy)
 {
-    std::string parentTag = tagPath.substr(0, tagPath.find_last_of('/'));
-    return (parentTag == "") ? "0" : getTagID(parentTag);
+    typedef std::pair<uint64_t, const std::string *> Candidate; // number of files and tag name
+    std::vector<Candidate> candidates;
+    if (fuzzy)
+    {
+        for (auto &entry : tagNameIndex)
+        {
+            if (isSubsequence(prefix, entry.first))
+            {
+                candidates.push_back(Candidate(tagMemberships[entry.second].cardinality(),
+                    &entry.first));
+            }
+        }
+    }
+    else
+    {
+        auto entry = std::lower_bound(tagNameIndex.begin(), tagNameIndex.end(),
+            std::make_pair(prefix, std::string()));
+        for (; entry != tagNameIndex.end()
+            && entry->first.compare(0, prefix.length(), prefix) == 0; entry++)
+        {
+            candidates.push_back(Candidate(tagMemberships[entry->second].cardinality(),
+                &entry->first));
+        }
+    }
+    std::size_t size = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + size, candidates.end(),
+        [](const Candidate &a, const Candidate &b) {
+            return (a.first != b.first) ? a.first > b.first : *a.second < *b.second;
+        });
+    std::vector<std::pair<std::string, uint64_t>> completions;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        completions.push_back(std::make_pair(*candidates[i].second, candidates[i].first));
+    }
+    return completions;
 }
 
 /**
@@ -1436,15 +3789,9 @@ std::string TFSManager::getTaggedFileID(std::string parentTagID, std::string fil
     {
         return "";
     }
-    std::vector<std::string> fileIDs = getFileIDsUnderTagID(parentTagID);
-    for (auto fileID : fileIDs)
-    {
-        if (filename == getFilenameFromID(fileID))
-        {
-            return fileID;
-        }
-    }
-    return "";
+    auto result = tagMemberships.find(parentTagID);
+    return (result == tagMemberships.end()) ? ""
+        : findFileIDByFilename(&result->second, filename);
 }
 
 /**
@@ -1497,8 +3844,33 @@ void TFSManager::getAncestorTagIDs(std::string tagID, std::set<std::string> &anc
  */
 std::vector<std::string> TFSManager::getChildTagIDs(std::string tagID)
 {
-    macro_bind_int(stmts[GET_CHILD_TAG_IDS], tagID);
-    return deserializeStrings(dbExecuteSV(stmts[GET_CHILD_TAG_IDS]));
+    auto result = tagChildren.find(tagID);
+    return (result == tagChildren.end()) ? std::vector<std::string>() : result->second;
+}
+
+/**
+ * Gets tag IDs of the given tag and all unique tags nested under it at any depth using the
+ * child tags kept in memory.
+ *
+ * @param tagID tag ID of tag whose descendants' tag IDs are to be found.
+ * @param descendants set where descendants' tag IDs are to be stored.
+ */
+void TFSManager::getDescendantTagIDs(std::string tagID, std::set<std::string> &descendants)
+{
+    std::vector<std::string> pending = {tagID};
+    while (!pending.empty())
+    {
+        std::string id = popBackAndRemove(pending);
+        if (id == "" || descendants.insert(id).second == false) // visited via another parent
+        {
+            continue;
+        }
+        auto children = tagChildren.find(id);
+        if (children != tagChildren.end())
+        {
+            pending.insert(pending.end(), children->second.begin(), children->second.end());
+        }
+    }
 }
 
 /**
@@ -1509,13 +3881,16 @@ std::vector<std::string> TFSManager::getChildTagIDs(std::string tagID)
  */
 std::vector<std::string> TFSManager::getFileIDsUnderTagID(std::string tagID)
 {
-    if (tagID == "")
+    std::vector<std::string> fileIDs;
+    auto result = tagMemberships.find(tagID);
+    if (result != tagMemberships.end())
     {
-        std::vector<std::string> empty;
-        return empty;
+        for (auto id : result->second.toVector())
+        {
+            fileIDs.push_back(std::to_string(id));
+        }
     }
-    macro_bind_int(stmts[GET_FILE_IDS_UNDER_TAG_ID], tagID);
-    return deserializeStrings(dbExecuteSV(stmts[GET_FILE_IDS_UNDER_TAG_ID]));
+    return fileIDs;
 }
 
 /**
@@ -1526,20 +3901,77 @@ std::vector<std::string> TFSManager::getFileIDsUnderTagID(std::string tagID)
  */
 std::vector<std::string> TFSManager::getFilenamesUnderTagID(std::string tagID)
 {
-    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-    if (fileIDs.empty())
+    auto result = tagMemberships.find(tagID);
+    if (result == tagMemberships.end())
     {
-        return fileIDs;
+        return std::vector<std::string>();
     }
+    return getFilenamesFromIDs(result->second.toVector());
+}
+
+/**
+ * Gets the filenames of the given files reading them in batches instead of one query per file.
+ *
+ * @param fileIDs file IDs of the files.
+ * @return Filenames of the files in the same order as the file IDs.
+ */
+std::vector<std::string> TFSManager::getFilenamesFromIDs(const std::vector<uint32_t> &fileIDs)
+{
     std::vector<std::string> filenames;
-    for (auto fileID : fileIDs)
+    filenames.reserve(fileIDs.size());
+    for (std::size_t first = 0; first < fileIDs.size(); first += TFS_FILENAME_BATCH_SIZE)
     {
-        macro_bind_int(stmts[GET_FILENAME_FROM_ID], fileID);
-        filenames.push_back(dbExecuteSV(stmts[GET_FILENAME_FROM_ID]));
+        std::size_t last = std::min(fileIDs.size(), first + TFS_FILENAME_BATCH_SIZE);
+        std::vector<std::string> ids;
+        for (std::size_t i = first; i < last; i++)
+        {
+            ids.push_back(std::to_string(fileIDs[i]));
+        }
+        sqlite3_stmt *stmt;
+        const std::string statement = "SELECT file_id, filename FROM files WHERE file_id IN ("
+            + formatIDsForSQL(ids) + ");";
+        if (sqlite3_prepare_v2(db, statement.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+        {
+            log("TFSManager sqlite3_prepare_v2() failed, ERROR: "
+                + std::string(sqlite3_errmsg(db)));
+            filenames.resize(last);
+            continue;
+        }
+        std::unordered_map<std::string, std::string> filenamesByID;
+        for (auto row : dbExecuteMR(stmt))
+        {
+            filenamesByID[row[0]] = row[1];
+        }
+        sqlite3_finalize(stmt);
+        for (auto &id : ids)
+        {
+            filenames.push_back(filenamesByID[id]);
+        }
     }
     return filenames;
 }
 
+/**
+ * Finds the file with the given filename among the given files by looking up the files with
+ * that filename instead of reading the filename of every given file.
+ *
+ * @param fileIDs file IDs of the files to be searched.
+ * @param filename filename of the file to be found.
+ * @return File ID of the file if found, else empty string.
+ */
+std::string TFSManager::findFileIDByFilename(const Bitmap *fileIDs, std::string filename)
+{
+    macro_bind_text(stmts[GET_FILE_IDS_BY_FILENAME], filename);
+    for (auto fileID : dbExecuteMV(stmts[GET_FILE_IDS_BY_FILENAME]))
+    {
+        if (fileIDs->contains(std::stoul(fileID)))
+        {
+            return fileID;
+        }
+    }
+    return "";
+}
+
 /**
  * Gets actual file path of the tagged file specified by its path in tag view mode.
  *
@@ -1548,33 +3980,84 @@ std::vector<std::string> TFSManager::getFilenamesUnderTagID(std::string tagID)
  */
 std::string TFSManager::getTaggedFilePath(std::string relativePath)
 {
-    std::string tagID = getParentTagIDFromPath(relativePath);
     std::string filename = getFilename(relativePath);
-    if (tagID != "")
+    const Bitmap *matches = getQueryDirectoryFileIDs(
+        relativePath.substr(0, relativePath.find_last_of('/')));
+    std::string fileID = (matches != NULL) ? findFileIDByFilename(matches, filename)
+        : getTaggedFileID(getParentTagIDFromPath(relativePath), filename);
+    if (fileID != "")
+    {
+        macro_bind_int(stmts[GET_TAGGED_FILE_PATH], fileID);
+        return getBlobPath(dbExecuteSV(stmts[GET_TAGGED_FILE_PATH]));
+    }
+    return "";
+}
+
+/**
+ * Gets file IDs of files matching the query written as a directory name directly under the
+ * root in tag view mode eg. "/+project-x+raw-archived". Results are shared with --query through
+ * the search cache. Directories named like "/=inbox" list the files of the saved search inbox
+ * and "/@untagged" lists the files without any tags.
+ *
+ * @param path path to the query directory in tag view mode.
+ * @return Bitmap of matching file IDs valid until the next search, NULL if the path isn't a
+ * valid query directory.
+ */
+const Bitmap *TFSManager::getQueryDirectoryFileIDs(std::string path)
+{
+    if (path.length() < 2 || path[0] != '/' || path.find('/', 1) != std::string::npos)
+    {
+        return NULL;
+    }
+    if (path == std::string("/") + TFS_UNTAGGED_DIRECTORY)
+    {
+        return &untaggedFileIDs;
+    }
+    if (path[1] == '=') // saved search
     {
-        std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-        for (auto fileID : fileIDs)
+        auto result = savedSearches.find(path.substr(2));
+        return (result == savedSearches.end()) ? NULL : &result->second.matches;
+    }
+    if (path[1] != '+')
+    {
+        return NULL;
+    }
+    TagQuery tagQuery;
+    if (tagQuery.parseDirectoryName(path.substr(1)) == false)
+    {
+        return NULL;
+    }
+    const TagQueryNode &root = tagQuery.getRoot();
+    std::vector<TagQueryNode> operands = (root.type == TagQueryNode::AND) ? root.children
+        : std::vector<TagQueryNode>{root};
+    for (auto &operand : operands)
+    {
+        bool isNegated = (operand.type == TagQueryNode::NOT);
+        if (getTagID(isNegated ? operand.children[0].tag : operand.tag) == "")
         {
-            if (filename == getFilenameFromID(fileID))
-            {
-                macro_bind_int(stmts[GET_TAGGED_FILE_PATH], fileID);
-                return rootDirectory + "/" + dbExecuteSV(stmts[GET_TAGGED_FILE_PATH]);
-            }
+            return NULL; // unknown tag
         }
     }
-    return "";
+    std::vector<std::string> plan;
+    return searchQuery(tagQuery, false, plan);
 }
 
 /**
- * Lists files tagged with and tags nested under tag specified by given path in tag view mode.
+ * Lists files tagged with and tags nested under tag specified by given path in tag view mode
+ * or files matching the query directory specified by the path.
  *
- * @param tagPath path to tag in tag view mode or tag name.
+ * @param tagPath path to tag or query directory in tag view mode or tag name.
  * @return String vector containing files and tags under specified tag.
  */
 std::vector<std::string> TFSManager::listTagChildren(std::string tagPath)
 {
-    std::string tagID = getTagID(tagPath);
     std::vector<std::string> contents;
+    const Bitmap *matches = getQueryDirectoryFileIDs(tagPath);
+    if (matches != NULL)
+    {
+        return getFilenamesFromIDs(matches->toVector());
+    }
+    std::string tagID = getTagID(tagPath);
     if (tagID != "")
     {
         std::vector<std::string> childTagIDs = getChildTagIDs(tagID);
@@ -1583,6 +4066,10 @@ std::vector<std::string> TFSManager::listTagChildren(std::string tagPath)
             macro_bind_int(stmts[GET_TAG_NAME_FROM_ID], tagID);
             contents.push_back(dbExecuteSV(stmts[GET_TAG_NAME_FROM_ID]));
         }
+        if (tagID == "0")
+        {
+            contents.push_back(TFS_UNTAGGED_DIRECTORY);
+        }
         std::vector<std::string> filenames = getFilenamesUnderTagID(tagID);
         contents.reserve(contents.size() + filenames.size());
         contents.insert(contents.end(), filenames.begin(), filenames.end());
@@ -1616,6 +4103,8 @@ void TFSManager::updateChildTagIDs(std::string tagID, std::vector<std::string> c
     macro_bind_text(stmts[UPDATE_CHILD_TAG_IDS], serializedIDs);
     macro_bind_int(stmts[UPDATE_CHILD_TAG_IDS], tagID);
     dbExecuteSV(stmts[UPDATE_CHILD_TAG_IDS]);
+    tagChildren[tagID] = childTagIDs;
+    tagGenerations[tagID]++; // descendants used by recursive searches changed
 }
 
 /**
@@ -1634,75 +4123,342 @@ int TFSManager::createTag(std::string tagPath)
     std::string parentTagID = "0";
     if (tag.find_first_of('/') != std::string::npos)
     {
-        std::vector<std::string> parts = splitPathIntoParts(tagPath);
-        tag = popBackAndRemove(parts);
-        if (!parts.empty())
+        std::vector<std::string> parts = splitPathIntoParts(tagPath);
+        tag = popBackAndRemove(parts);
+        if (!parts.empty())
+        {
+            parentTagID = getTagID(parts.back());
+            if (parentTagID == "")
+            {
+                return 1; // invalid parent tag
+            }
+        }
+    }
+    if (tag[0] == '+' || tag[0] == '=' || tag[0] == '@')
+    {
+        return 1; // reserved for query directories, saved searches and untagged files
+    }
+    std::string parentTags = parentTagID + ";";
+    macro_bind_text(stmts[CREATE_TAG], tag);
+    macro_bind_text(stmts[CREATE_TAG], parentTags);
+    dbExecuteSV(stmts[CREATE_TAG]);
+    if (sqlite3_changes(db) != 1)
+    {
+        return 1; // invalid tag
+    }
+    std::string tagID = std::to_string(sqlite3_last_insert_rowid(db));
+    indexTagName(tag, tagID);
+    std::vector<std::string> childTagIDs = getChildTagIDs(parentTagID);
+    childTagIDs.push_back(tagID);
+    updateChildTagIDs(parentTagID, childTagIDs);
+    tagMemberships[tagID] = Bitmap();
+    tagNamesGeneration++;
+    reevaluateSavedSearches(tag);
+    if (parentTagID != "0")
+    {
+        reevaluateSavedSearches(""); // nested under another tag
+    }
+    return 0;
+}
+
+/**
+ * Deletes tag using given tag name or path containing tag name in tag view mode.
+ *
+ * @param tagPath name of tag to be deleted or path in tag view mode containing it.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::deleteTag(std::string tagPath)
+{
+    std::string tagID = getTagID(tagPath);
+    if (tagID == "")
+    {
+        return ENOENT;
+    }
+    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
+    std::vector<std::string> childTagIDs = getChildTagIDs(tagID);
+    if (fileIDs.size() != 0 || childTagIDs.size() != 0)
+    {
+        return ENOTEMPTY;
+    }
+    std::vector<std::string> parentTagIDs = getParentTagIDs(tagID);
+    for (auto parentTagID : parentTagIDs)
+    {
+        childTagIDs = getChildTagIDs(parentTagID);
+        childTagIDs.erase(std::find(childTagIDs.begin(), childTagIDs.end(), tagID));
+        updateChildTagIDs(parentTagID, childTagIDs);
+    }
+    std::string tag = getTagNameFromID(tagID);
+    unindexTagName(tag);
+    macro_bind_int(stmts[DELETE_TAG], tagID);
+    dbExecuteSV(stmts[DELETE_TAG]);
+    tagMemberships.erase(tagID);
+    tagChildren.erase(tagID);
+    tagCooccurrences.erase(tagID);
+    macro_bind_int(stmts[DELETE_TAG_COOCCURRENCES], tagID);
+    dbExecuteSV(stmts[DELETE_TAG_COOCCURRENCES]);
+    tagNamesGeneration++;
+    reevaluateSavedSearches(tag);
+    return 0;
+}
+
+/**
+ * Saves the bitmap of file IDs of tag specified by tag ID after un/tagging operation.
+ *
+ * @param tagID tag ID of tag whose file IDs are to be saved.
+ */
+void TFSManager::updateTagFileIDs(std::string tagID)
+{
+    std::string serializedIDs = tagMemberships[tagID].serialize();
+    macro_bind_blob(stmts[UPDATE_TAG_FILE_IDS], serializedIDs);
+    macro_bind_int(stmts[UPDATE_TAG_FILE_IDS], tagID);
+    dbExecuteSV(stmts[UPDATE_TAG_FILE_IDS]);
+    tagGenerations[tagID]++;
+}
+
+/**
+ * Updates the number of tags of a file after it was tagged or untagged along with the set of
+ * files without any tags. With a memory budget, the tags aren't counted and the tags of an
+ * untagged file are looked up instead.
+ *
+ * @param fileID file ID of the file.
+ * @param isTagged boolean indicating if the file was tagged or untagged.
+ */
+void TFSManager::updateFileTagCount(uint32_t fileID, bool isTagged)
+{
+    if (memoryBudget != 0)
+    {
+        if (isTagged)
+        {
+            untaggedFileIDs.remove(fileID);
+        }
+        else if (getFileTagIDs(fileID).empty())
+        {
+            untaggedFileIDs.add(fileID);
+        }
+        return;
+    }
+    if (fileID >= fileTagCounts.size())
+    {
+        fileTagCounts.resize(fileID + 1, 0);
+    }
+    if (isTagged)
+    {
+        if (fileTagCounts[fileID]++ == 0)
+        {
+            untaggedFileIDs.remove(fileID);
+        }
+    }
+    else if (fileTagCounts[fileID] > 0 && --fileTagCounts[fileID] == 0)
+    {
+        untaggedFileIDs.add(fileID);
+    }
+}
+
+/**
+ * Gets the tag IDs of the tags a file is tagged with.
+ *
+ * @param fileID file ID of the file.
+ * @return Tag IDs of the tags of the file.
+ */
+std::vector<std::string> TFSManager::getFileTagIDs(uint32_t fileID)
+{
+    std::vector<std::string> tagIDs;
+    if ((memoryBudget == 0) ? fileID >= fileTagCounts.size() || fileTagCounts[fileID] == 0
+        : untaggedFileIDs.contains(fileID))
+    {
+        return tagIDs; // untagged, no need to look through the tags
+    }
+    for (auto &membership : tagMemberships)
+    {
+        if (membership.second.contains(fileID))
+        {
+            tagIDs.push_back(membership.first);
+        }
+    }
+    return tagIDs;
+}
+
+/**
+ * Updates the number of files tagged with both tags of each pair after a file was tagged or
+ * untagged with some tags, given the other tags of the file so that they are only looked up
+ * once per operation. The counts are updated in the catalog along with those in memory.
+ *
+ * @param tagIDs tag IDs of the tags the file was un/tagged with.
+ * @param otherTagIDs tag IDs of the other tags of the file.
+ * @param isTagged boolean indicating if the file was tagged or untagged.
+ */
+void TFSManager::updateTagCooccurrences(const std::vector<std::string> &tagIDs,
+    const std::vector<std::string> &otherTagIDs, bool isTagged)
+{
+    auto update = [&](const std::string &a, const std::string &b)
+    {
+        for (auto pair : {std::make_pair(&a, &b), std::make_pair(&b, &a)})
+        {
+            if (memoryBudget != 0) // only kept in the catalog
+            {
+                break;
+            }
+            auto &counts = tagCooccurrences[*pair.first];
+            if (isTagged)
+            {
+                counts[*pair.second]++;
+            }
+            else if (--counts[*pair.second] == 0)
+            {
+                counts.erase(*pair.second);
+            }
+        }
+        saveTagCooccurrence(a, b, isTagged ? 1 : -1);
+    };
+    for (std::size_t i = 0; i < tagIDs.size(); i++)
+    {
+        for (auto &otherTagID : otherTagIDs)
+        {
+            update(tagIDs[i], otherTagID);
+        }
+        for (std::size_t j = i + 1; j < tagIDs.size(); j++)
+        {
+            update(tagIDs[i], tagIDs[j]);
+        }
+    }
+}
+
+/**
+ * Updates the number of files tagged with both tags of a pair in the catalog, removing the pair
+ * once no file is tagged with both.
+ *
+ * @param tagID tag ID of a tag.
+ * @param otherTagID tag ID of the other tag.
+ * @param change number of files added to the count, negative if removed.
+ */
+void TFSManager::saveTagCooccurrence(std::string tagID, std::string otherTagID, int64_t change)
+{
+    if (std::stoul(otherTagID) < std::stoul(tagID))
+    {
+        std::swap(tagID, otherTagID);
+    }
+    macro_bind_int(stmts[UPDATE_TAG_COOCCURRENCE], tagID);
+    macro_bind_int(stmts[UPDATE_TAG_COOCCURRENCE], otherTagID);
+    macro_bind_int64(stmts[UPDATE_TAG_COOCCURRENCE], change);
+    dbExecuteSV(stmts[UPDATE_TAG_COOCCURRENCE]);
+    if (change < 0)
+    {
+        macro_bind_int(stmts[DELETE_EMPTY_TAG_COOCCURRENCE], tagID);
+        macro_bind_int(stmts[DELETE_EMPTY_TAG_COOCCURRENCE], otherTagID);
+        dbExecuteSV(stmts[DELETE_EMPTY_TAG_COOCCURRENCE]);
+    }
+}
+
+/**
+ * Gets the number of files tagged with both given tags, read from the catalog with a memory
+ * budget.
+ *
+ * @param tagID tag ID of a tag.
+ * @param otherTagID tag ID of the other tag.
+ * @return Number of files tagged with both tags.
+ */
+uint64_t TFSManager::getCooccurrence(std::string tagID, std::string otherTagID)
+{
+    if (memoryBudget != 0)
+    {
+        if (std::stoul(otherTagID) < std::stoul(tagID))
         {
-            parentTagID = getTagID(parts.back());
-            if (parentTagID == "")
-            {
-                return 1; // invalid parent tag
-            }
+            std::swap(tagID, otherTagID);
         }
+        macro_bind_int(stmts[GET_TAG_COOCCURRENCE], tagID);
+        macro_bind_int(stmts[GET_TAG_COOCCURRENCE], otherTagID);
+        std::string files = dbExecuteSV(stmts[GET_TAG_COOCCURRENCE]);
+        return (files == "") ? 0 : std::stoull(files);
     }
-    std::string parentTags = parentTagID + ";";
-    macro_bind_text(stmts[CREATE_TAG], tag);
-    macro_bind_text(stmts[CREATE_TAG], parentTags);
-    dbExecuteSV(stmts[CREATE_TAG]);
-    std::string tagID = getTagID(tag);
-    if (tagID == "")
+    auto counts = tagCooccurrences.find(tagID);
+    if (counts == tagCooccurrences.end())
     {
-        return 1; // invalid tag
+        return 0;
     }
-    std::vector<std::string> childTagIDs = getChildTagIDs(parentTagID);
-    childTagIDs.push_back(tagID);
-    updateChildTagIDs(parentTagID, childTagIDs);
-    return 0;
+    auto result = counts->second.find(otherTagID);
+    return (result == counts->second.end()) ? 0 : result->second;
 }
 
 /**
- * Deletes tag using given tag name or path containing tag name in tag view mode.
+ * Gets the number of files tagged with both a tag and each tag it has common files with, read
+ * from the catalog with a memory budget.
  *
- * @param tagPath name of tag to be deleted or path in tag view mode containing it.
- * @return 0 if successful or error value indicating the error.
+ * @param tagID tag ID of the tag.
+ * @return Number of common files keyed by the tag IDs of the other tags.
  */
-int TFSManager::deleteTag(std::string tagPath)
+std::unordered_map<std::string, uint64_t> TFSManager::getTagCooccurrences(std::string tagID)
 {
-    std::string tagID = getTagID(tagPath);
-    if (tagID == "")
+    if (memoryBudget == 0)
     {
-        return ENOENT;
+        auto counts = tagCooccurrences.find(tagID);
+        return (counts == tagCooccurrences.end()) ? std::unordered_map<std::string, uint64_t>()
+            : counts->second;
     }
-    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-    std::vector<std::string> childTagIDs = getChildTagIDs(tagID);
-    if (fileIDs.size() != 0 || childTagIDs.size() != 0)
+    std::unordered_map<std::string, uint64_t> counts;
+    macro_bind_int(stmts[GET_TAG_COOCCURRENCES], tagID);
+    for (auto &row : dbExecuteMR(stmts[GET_TAG_COOCCURRENCES]))
     {
-        return ENOTEMPTY;
+        counts[row[0]] = std::stoull(row[1]);
     }
-    std::vector<std::string> parentTagIDs = getParentTagIDs(tagID);
-    for (auto parentTagID : parentTagIDs)
+    return counts;
+}
+
+/**
+ * Suggests tags for a file which are most often found together with the tags of the file,
+ * scored by the number of files tagged with both summed over the tags of the file.
+ *
+ * @param fileID file ID of the file.
+ * @param limit maximum number of suggestions.
+ * @return Names of the suggested tags paired with their scores, highest first.
+ */
+std::vector<std::pair<std::string, uint64_t>> TFSManager::suggestTags(std::string fileID,
+    std::size_t limit)
+{
+    std::vector<std::string> tagIDs = getFileTagIDs(std::stoul(fileID));
+    std::set<std::string> fileTagIDs(tagIDs.begin(), tagIDs.end());
+    std::unordered_map<std::string, uint64_t> scores;
+    for (auto &tagID : fileTagIDs)
     {
-        childTagIDs = getChildTagIDs(parentTagID);
-        childTagIDs.erase(std::find(childTagIDs.begin(), childTagIDs.end(), tagID));
-        updateChildTagIDs(parentTagID, childTagIDs);
+        for (auto &entry : getTagCooccurrences(tagID))
+        {
+            if (fileTagIDs.count(entry.first) == 0)
+            {
+                scores[entry.first] += entry.second;
+            }
+        }
     }
-    macro_bind_int(stmts[DELETE_TAG], tagID);
-    dbExecuteSV(stmts[DELETE_TAG]);
-    return 0;
+    typedef std::pair<uint64_t, const std::string *> Candidate; // score and tag ID
+    std::vector<Candidate> candidates;
+    for (auto &entry : scores)
+    {
+        candidates.push_back(Candidate(entry.second, &entry.first));
+    }
+    std::size_t size = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + size, candidates.end(),
+        [](const Candidate &a, const Candidate &b) {
+            return (a.first != b.first) ? a.first > b.first
+                : std::stoul(*a.second) < std::stoul(*b.second);
+        });
+    std::vector<std::pair<std::string, uint64_t>> suggestions;
+    for (std::size_t i = 0; i < size; i++)
+    {
+        suggestions.push_back(std::make_pair(getTagNameFromID(*candidates[i].second),
+            candidates[i].first));
+    }
+    return suggestions;
 }
 
 /**
- * Updates file IDs of tag specified by tag ID after un/tagging operation.
+ * Stores the current time as the time the tags of a file last changed.
  *
- * @param tagID tag ID of tag whose file IDs are to be updated.
- * @param fileIDs vector containing tag's file IDs.
+ * @param fileID file ID of the file which was tagged or untagged.
  */
-void TFSManager::updateTagFileIDs(std::string tagID, std::vector<std::string> fileIDs)
+void TFSManager::updateTaggedAt(std::string fileID)
 {
-    std::string serializedIDs = serializeStrings(fileIDs);
-    macro_bind_text(stmts[UPDATE_TAG_FILE_IDS], serializedIDs);
-    macro_bind_int(stmts[UPDATE_TAG_FILE_IDS], tagID);
-    dbExecuteSV(stmts[UPDATE_TAG_FILE_IDS]);
+    int64_t taggedAt = time(NULL);
+    macro_bind_int64(stmts[UPDATE_TAGGED_AT], taggedAt);
+    macro_bind_int(stmts[UPDATE_TAGGED_AT], fileID);
+    dbExecuteSV(stmts[UPDATE_TAGGED_AT]);
 }
 
 /**
@@ -1714,16 +4470,21 @@ void TFSManager::updateTagFileIDs(std::string tagID, std::vector<std::string> fi
  */
 int TFSManager::tagSingleFile(std::string fileID, std::string tagID)
 {
-    std::vector<std::string> filenames = getFilenamesUnderTagID(tagID);
     std::string filename = getFilenameFromID(fileID); // Assume fileID is valid
-    auto result = std::find(filenames.begin(), filenames.end(), filename);
-    if (result != filenames.end())
+    if (getTaggedFileID(tagID, filename) != "")
     {
         return EEXIST; // filename conflict
     }
-    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-    fileIDs.push_back(fileID);
-    updateTagFileIDs(tagID, fileIDs);
+    std::vector<std::string> otherTagIDs = getFileTagIDs(std::stoul(fileID));
+    if (tagMemberships[tagID].add(std::stoul(fileID)) == false)
+    {
+        return 0; // already tagged
+    }
+    updateTagFileIDs(tagID);
+    updateFileTagCount(std::stoul(fileID), true);
+    updateTagCooccurrences({tagID}, otherTagIDs, true);
+    updateTaggedAt(fileID);
+    updateSavedSearches(std::stoul(fileID), tagID);
     return 0;
 }
 
@@ -1783,14 +4544,17 @@ int TFSManager::tagFiles(std::string filePath, std::string tag)
  */
 int TFSManager::untagSingleFile(std::string fileID, std::string tagID)
 {
-    std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-    auto result = std::find(fileIDs.begin(), fileIDs.end(), fileID);
-    if (result == fileIDs.end())
+    auto result = tagMemberships.find(tagID);
+    if (fileID == "" || result == tagMemberships.end()
+        || result->second.remove(std::stoul(fileID)) == false)
     {
         return ENOENT;
     }
-    fileIDs.erase(result);
-    updateTagFileIDs(tagID, fileIDs);
+    updateTagFileIDs(tagID);
+    updateFileTagCount(std::stoul(fileID), false);
+    updateTagCooccurrences({tagID}, getFileTagIDs(std::stoul(fileID)), false);
+    updateTaggedAt(fileID);
+    updateSavedSearches(std::stoul(fileID), tagID);
     return 0;
 }
 
@@ -1834,180 +4598,682 @@ int TFSManager::untagFiles(std::string filePath, std::string tag)
 }
 
 /**
- * Nests given tag inside given parent tag.
+ * Nests given tag inside given parent tag.
+ *
+ * @param tagID tag ID of tag to be nested.
+ * @param parentTagID tag ID of parent tag under which given tag is nested.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::nestTag(std::string tagID, std::string parentTagID)
+{
+    if (tagID == "" || parentTagID == "")
+    {
+        return ENOENT;
+    }
+    std::vector<std::string> childIDs = getChildTagIDs(parentTagID);
+    auto result = std::find(childIDs.begin(), childIDs.end(), tagID);
+    if (result != childIDs.end())
+    {
+        return EEXIST;
+    }
+    else
+    {
+        childIDs.push_back(tagID);
+    }
+    std::vector<std::string> parentIDs = getParentTagIDs(tagID);
+    result = std::find(parentIDs.begin(), parentIDs.end(), parentTagID);
+    if (result != parentIDs.end())
+    {
+        return EEXIST; // should be caught above but just in case
+    }
+    else
+    {
+        parentIDs.push_back(parentTagID);
+    }
+    // cyclic check
+    std::set<std::string> ancestorIDs;
+    getAncestorTagIDs(parentTagID, ancestorIDs);
+    auto setResult = ancestorIDs.find(tagID);
+    if (setResult != ancestorIDs.end())
+    {
+        return 1; // prevent cyclic nesting
+    }
+    updateChildTagIDs(parentTagID, childIDs);
+    updateParentTagIDs(tagID, parentIDs);
+    reevaluateSavedSearches("");
+    return 0;
+}
+
+/**
+ * Unnests given tag from given parent tag.
+ *
+ * @param tagID tag ID of tag to be unnested.
+ * @param parentTagID tag ID of parent tag from which given tag is unnested.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::unnestTag(std::string tagID, std::string parentTagID)
+{
+    if (tagID == "" || parentTagID == "")
+    {
+        return ENOENT;
+    }
+    std::vector<std::string> childIDs = getChildTagIDs(parentTagID);
+    auto result = std::find(childIDs.begin(), childIDs.end(), tagID);
+    if (result == childIDs.end())
+    {
+        return ENOENT;
+    }
+    else
+    {
+        childIDs.erase(result);
+    }
+    std::vector<std::string> parentIDs = getParentTagIDs(tagID);
+    result = std::find(parentIDs.begin(), parentIDs.end(), parentTagID);
+    if (result == parentIDs.end())
+    {
+        return ENOENT;
+    }
+    else
+    {
+        parentIDs.erase(result);
+    }
+    updateChildTagIDs(parentTagID, childIDs);
+    updateParentTagIDs(tagID, parentIDs);
+    reevaluateSavedSearches("");
+    return 0;
+}
+
+/**
+ * Gets all tags associated with file specified by file ID.
+ *
+ * @param fileID file ID of file whose tags are to be found.
+ * @return String vector containing tags associated with given file.
+ */
+std::vector<std::string> TFSManager::getFileTags(std::string fileID)
+{
+    std::vector<std::string> tags;
+    if (getFilenameFromID(fileID) == "")
+    {
+        return tags;
+    }
+    uint32_t id = std::stoul(fileID);
+    std::vector<std::vector<std::string>> results = dbExecuteMR(stmts[GET_FILE_TAGS]);
+    for (auto row : results)
+    {
+        auto membership = tagMemberships.find(row[0]);
+        if (membership != tagMemberships.end() && membership->second.contains(id))
+        {
+            tags.push_back(row[1]);
+        }
+    }
+    return tags;
+}
+
+/**
+ * Intersects or unites the given bitmaps. Bitmaps with many containers are split into ranges
+ * of keys which are combined on the threads of the worker pool, while smaller ones are
+ * combined on the calling thread.
+ *
+ * @param bitmaps bitmaps to be combined, ordered from the smallest if intersected.
+ * @param intersect boolean to indicate if the bitmaps are intersected instead of united.
+ * @return Bitmap containing the combined file IDs.
+ */
+Bitmap TFSManager::combineBitmaps(const std::vector<const Bitmap *> &bitmaps, bool intersect)
+{
+    std::size_t numberOfContainers = 0;
+    const Bitmap *largest = NULL;
+    for (auto bitmap : bitmaps)
+    {
+        numberOfContainers += bitmap->numberOfContainers();
+        if (largest == NULL || bitmap->numberOfContainers() > largest->numberOfContainers())
+        {
+            largest = bitmap;
+        }
+    }
+    if (workerPool.size() == 1 || numberOfContainers < TFS_PARALLEL_MIN_CONTAINERS)
+    {
+        return intersect ? Bitmap::intersectAll(bitmaps) : Bitmap::uniteAll(bitmaps);
+    }
+    // an intersection only has the keys of the smallest bitmap, a union those of all of them
+    std::vector<uint32_t> keys = (intersect ? bitmaps[0] : largest)->splitKeys(
+        workerPool.size());
+    std::vector<Bitmap> parts(keys.size() - 1);
+    workerPool.run(parts.size(), [&](std::size_t i) {
+        parts[i] = intersect ? Bitmap::intersectAll(bitmaps, keys[i], keys[i + 1])
+            : Bitmap::uniteAll(bitmaps, keys[i], keys[i + 1]);
+    });
+    return Bitmap::concatenate(parts);
+}
+
+/**
+ * Finds file IDs of files tagged with all the given tags.
+ *
+ * @param tags tags with which files to be found are tagged with.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @return Bitmap containing matching file IDs.
+ */
+Bitmap TFSManager::findFileIDsWithTags(std::vector<std::string> tags, bool recursive)
+{
+    std::vector<Bitmap> expandedBitmaps;
+    expandedBitmaps.reserve(tags.size()); // keep pointers to expanded bitmaps valid
+    std::vector<const Bitmap *> bitmaps;
+    for (auto tag : tags)
+    {
+        std::string tagID = getTagID(tag);
+        if (tagID == "")
+        {
+            return Bitmap(); // invalid tag
+        }
+        if (recursive)
+        {
+            expandedBitmaps.push_back(getRecursiveTagMembership(tagID));
+            bitmaps.push_back(&expandedBitmaps.back());
+        }
+        else
+        {
+            bitmaps.push_back(&tagMemberships[tagID]);
+        }
+    }
+    if (bitmaps.empty())
+    {
+        return Bitmap();
+    }
+    // intersect smallest bitmaps first to keep intermediate results small
+    std::sort(bitmaps.begin(), bitmaps.end(), [](const Bitmap *a, const Bitmap *b) {
+        return a->cardinality() < b->cardinality();
+    });
+    return combineBitmaps(bitmaps, true);
+}
+
+/**
+ * Finds file IDs of files tagged with any of the given tags.
+ *
+ * @param tags tags with which files to be found may be tagged with.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @return Bitmap containing matching file IDs.
+ */
+Bitmap TFSManager::findFileIDsWithAnyOfTags(std::vector<std::string> tags, bool recursive)
+{
+    std::set<std::string> tagIDs;
+    for (auto tag : tags)
+    {
+        std::string tagID = getTagID(tag);
+        if (tagID == "")
+        {
+            return Bitmap(); // invalid tag
+        }
+        if (recursive)
+        {
+            getDescendantTagIDs(tagID, tagIDs); // shared descendants are united once
+        }
+        else
+        {
+            tagIDs.insert(tagID);
+        }
+    }
+    std::vector<const Bitmap *> bitmaps;
+    for (auto tagID : tagIDs)
+    {
+        bitmaps.push_back(&tagMemberships[tagID]);
+    }
+    return combineBitmaps(bitmaps, false);
+}
+
+/**
+ * Checks if the text matches the given pattern where '*' matches any characters and '?'
+ * matches any single character, ignoring case.
+ *
+ * @param pattern pattern to be matched.
+ * @param text text to be checked.
+ * @return Boolean indicating if the text matches the pattern.
+ */
+bool matchesWildcards(const std::string &pattern, const std::string &text)
+{
+    std::size_t p = 0, t = 0, star = std::string::npos, resume = 0;
+    while (t < text.length())
+    {
+        if (p < pattern.length() && (pattern[p] == '?'
+            || tolower(pattern[p]) == tolower(text[t])))
+        {
+            p++;
+            t++;
+        }
+        else if (p < pattern.length() && pattern[p] == '*')
+        {
+            star = p++;
+            resume = t;
+        }
+        else if (star != std::string::npos) // let the last '*' match one more character
+        {
+            p = star + 1;
+            t = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.length() && pattern[p] == '*')
+    {
+        p++;
+    }
+    return p == pattern.length();
+}
+
+/**
+ * Finds file IDs of files whose names match the given pattern using the full-text index of
+ * filenames if SQLite supports it. Patterns without '*' or '?' match any part of the name,
+ * otherwise the whole name has to match. Matching ignores case.
+ *
+ * @param pattern pattern of the filenames.
+ * @return Bitmap containing matching file IDs.
+ */
+Bitmap TFSManager::findFileIDsByName(std::string pattern)
+{
+    if (pattern.find_first_of("*?") == std::string::npos)
+    {
+        pattern = "*" + pattern + "*";
+    }
+    std::string likePattern = pattern;
+    std::replace(likePattern.begin(), likePattern.end(), '*', '%');
+    std::replace(likePattern.begin(), likePattern.end(), '?', '_');
+    // LIKE ... ESCAPE can't use the trigram index, so '%' and '_' in the pattern are matched
+    // as wildcards by SQLite and the candidates are checked again
+    bool isRecheckNeeded = (pattern.find_first_of("%_") != std::string::npos);
+    macro_bind_text(stmts[FIND_FILES_BY_NAME], likePattern);
+    Bitmap matches;
+    for (auto &row : dbExecuteMR(stmts[FIND_FILES_BY_NAME]))
+    {
+        if (!isRecheckNeeded || matchesWildcards(pattern, row[1]))
+        {
+            matches.add(std::stoul(row[0]));
+        }
+    }
+    return matches;
+}
+
+/**
+ * Gets the bitmap of file IDs tagged with the given tag.
+ *
+ * @param tag tag name.
+ * @return Bitmap of file IDs, empty if tag doesn't exist.
+ */
+const Bitmap &TFSManager::getTagMembership(std::string tag)
+{
+    static const Bitmap empty;
+    std::string tagID = getTagID(tag);
+    auto result = tagMemberships.find(tagID);
+    return (tagID == "" || result == tagMemberships.end()) ? empty : result->second;
+}
+
+/**
+ * Gets the bitmap of file IDs tagged with the given tag or any tag nested under it.
  *
- * @param tagID tag ID of tag to be nested.
- * @param parentTagID tag ID of parent tag under which given tag is nested.
- * @return 0 if successful or error value indicating the error.
+ * @param tagID tag ID of the tag.
+ * @return Bitmap of file IDs, empty if tag doesn't exist.
  */
-int TFSManager::nestTag(std::string tagID, std::string parentTagID)
+Bitmap TFSManager::getRecursiveTagMembership(std::string tagID)
 {
-    if (tagID == "" || parentTagID == "")
-    {
-        return ENOENT;
-    }
-    std::vector<std::string> childIDs = getChildTagIDs(parentTagID);
-    auto result = std::find(childIDs.begin(), childIDs.end(), tagID);
-    if (result != childIDs.end())
-    {
-        return EEXIST;
-    }
-    else
+    std::set<std::string> tagIDs;
+    getDescendantTagIDs(tagID, tagIDs);
+    std::vector<const Bitmap *> bitmaps;
+    for (auto id : tagIDs)
     {
-        childIDs.push_back(tagID);
+        auto result = tagMemberships.find(id);
+        if (result != tagMemberships.end())
+        {
+            bitmaps.push_back(&result->second);
+        }
     }
-    std::vector<std::string> parentIDs = getParentTagIDs(tagID);
-    result = std::find(parentIDs.begin(), parentIDs.end(), parentTagID);
-    if (result != parentIDs.end())
+    return combineBitmaps(bitmaps, false);
+}
+
+/**
+ * Gets tag IDs of the tags a tag query depends on.
+ *
+ * @param node root of the expression tree of the tag query.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @param tagIDs set where the tag IDs are to be stored.
+ * @param usesAllFiles boolean set if the query depends on the set of all files.
+ */
+void TFSManager::getQueryTagIDs(const TagQueryNode &node, bool recursive,
+    std::set<std::string> &tagIDs, bool &usesAllFiles)
+{
+    if (node.type == TagQueryNode::TAG)
     {
-        return EEXIST; // should be caught above but just in case
+        std::string tagID = getTagID(node.tag);
+        if (recursive)
+        {
+            getDescendantTagIDs(tagID, tagIDs);
+        }
+        else if (tagID != "")
+        {
+            tagIDs.insert(tagID);
+        }
     }
-    else
+    else if (node.type == TagQueryNode::NOT)
     {
-        parentIDs.push_back(parentTagID);
+        usesAllFiles = true;
     }
-    // cyclic check
-    std::set<std::string> ancestorIDs;
-    getAncestorTagIDs(parentTagID, ancestorIDs);
-    auto setResult = ancestorIDs.find(tagID);
-    if (setResult != ancestorIDs.end())
+    for (auto &child : node.children)
     {
-        return 1; // prevent cyclic nesting
+        getQueryTagIDs(child, recursive, tagIDs, usesAllFiles);
     }
-    updateChildTagIDs(parentTagID, childIDs);
-    updateParentTagIDs(tagID, parentIDs);
-    return 0;
 }
 
 /**
- * Unnests given tag from given parent tag.
+ * Gets the cached result of a search if none of the tags or files it depends on have changed
+ * since it was cached.
  *
- * @param tagID tag ID of tag to be unnested.
- * @param parentTagID tag ID of parent tag from which given tag is unnested.
- * @return 0 if successful or error value indicating the error.
+ * @param key normalized search.
+ * @return Bitmap of matching file IDs valid until the next search, NULL if not cached.
  */
-int TFSManager::unnestTag(std::string tagID, std::string parentTagID)
+const Bitmap *TFSManager::getCachedSearch(std::string key)
 {
-    if (tagID == "" || parentTagID == "")
-    {
-        return ENOENT;
-    }
-    std::vector<std::string> childIDs = getChildTagIDs(parentTagID);
-    auto result = std::find(childIDs.begin(), childIDs.end(), tagID);
-    if (result == childIDs.end())
+    CachedSearch *cached = searchCache.get(key);
+    bool isValid = (cached != NULL && cached->tagNamesGeneration == tagNamesGeneration
+        && (!cached->usesAllFiles || cached->allFilesGeneration == allFilesGeneration));
+    for (std::size_t i = 0; isValid && i < cached->tagGenerations.size(); i++)
     {
-        return ENOENT;
+        isValid = (tagGenerations[cached->tagGenerations[i].first]
+            == cached->tagGenerations[i].second);
     }
-    else
+    if (isValid == false)
     {
-        childIDs.erase(result);
+        searchCache.remove(key);
+        searchCacheMisses++;
+        return NULL;
     }
-    std::vector<std::string> parentIDs = getParentTagIDs(tagID);
-    result = std::find(parentIDs.begin(), parentIDs.end(), parentTagID);
-    if (result == parentIDs.end())
+    searchCacheHits++;
+    return &cached->matches;
+}
+
+/**
+ * Caches the result of a search along with the current generations of the tags and files it
+ * depends on.
+ *
+ * @param key normalized search.
+ * @param tagIDs tag IDs of the tags the search depends on.
+ * @param usesAllFiles boolean to indicate if the search depends on the set of all files.
+ * @param matches file IDs of matching files, moved into the cache.
+ * @return Bitmap of matching file IDs valid until the next search.
+ */
+const Bitmap *TFSManager::cacheSearch(std::string key, const std::set<std::string> &tagIDs,
+    bool usesAllFiles, Bitmap &matches)
+{
+    CachedSearch entry = {tagNamesGeneration, usesAllFiles, allFilesGeneration, {}, Bitmap()};
+    for (auto tagID : tagIDs)
     {
-        return ENOENT;
+        entry.tagGenerations.push_back(std::make_pair(tagID, tagGenerations[tagID]));
     }
-    else
+    std::size_t cost = matches.memoryUsage() + sizeof(CachedSearch) + key.length()
+        + entry.tagGenerations.size() * (sizeof(std::pair<std::string, uint64_t>) + 8);
+    fitSearchCacheToBudget();
+    if (cost > searchCache.getCapacity()) // too large to be cached
     {
-        parentIDs.erase(result);
+        uncachedSearch = std::move(matches);
+        return &uncachedSearch;
     }
-    updateChildTagIDs(parentTagID, childIDs);
-    updateParentTagIDs(tagID, parentIDs);
-    return 0;
+    entry.matches = std::move(matches);
+    searchCache.put(key, std::move(entry), cost);
+    return &searchCache.get(key)->matches;
 }
 
 /**
- * Gets all tags associated with file specified by file ID.
+ * Finds file IDs of files tagged with any or all of the given tags using the search cache.
  *
- * @param fileID file ID of file whose tags are to be found.
- * @return String vector containing tags associated with given file.
+ * @param tags tags with which files to be found are tagged with.
+ * @param options options of the search.
+ * @return Bitmap of matching file IDs valid until the next search.
  */
-std::vector<std::string> TFSManager::getFileTags(std::string fileID)
+const Bitmap *TFSManager::searchTags(std::vector<std::string> tags, const SearchOptions &options)
 {
-    std::vector<std::string> tags;
-    if (getFilenameFromID(fileID) == "")
+    std::vector<std::string> sortedTags = tags;
+    std::sort(sortedTags.begin(), sortedTags.end());
+    sortedTags.erase(std::unique(sortedTags.begin(), sortedTags.end()), sortedTags.end());
+    std::string key = std::string("TAGS ") + (options.strict ? "ALL" : "ANY")
+        + (options.recursive ? " RECURSIVE " : " ") + serializeStrings(sortedTags);
+    const Bitmap *cached = getCachedSearch(key);
+    if (cached != NULL)
     {
-        return tags;
+        return cached;
     }
-    std::vector<std::vector<std::string>> results = dbExecuteMR(stmts[GET_FILE_TAGS]);
-    for (auto row : results)
+    std::set<std::string> tagIDs;
+    for (auto tag : sortedTags)
     {
-        std::vector<std::string> taggedFileIDs = deserializeStrings(row[2]);
-        for (auto id : taggedFileIDs)
-        {
-            if (id == fileID)
-            {
-                tags.push_back(row[1]);
-            }
-        }
+        TagQueryNode node{TagQueryNode::TAG, tag, {}};
+        bool usesAllFiles = false;
+        getQueryTagIDs(node, options.recursive, tagIDs, usesAllFiles);
     }
-    return tags;
+    Bitmap matches = options.strict ? findFileIDsWithTags(sortedTags, options.recursive)
+        : findFileIDsWithAnyOfTags(sortedTags, options.recursive);
+    return cacheSearch(key, tagIDs, false, matches);
 }
 
 /**
- * Finds file IDs of files tagged with all the given tags.
+ * Evaluates the given tag query using the search cache.
  *
- * @param tags tags with which files to be found are tagged with.
- * @return String vector containing matching files.
+ * @param tagQuery parsed tag query.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @param plan vector to which a description of each evaluation step is appended.
+ * @return Bitmap of matching file IDs valid until the next search.
  */
-std::vector<std::string> TFSManager::findFileIDsWithTags(std::vector<std::string> tags)
+const Bitmap *TFSManager::searchQuery(const TagQuery &tagQuery, bool recursive,
+    std::vector<std::string> &plan)
 {
-    std::vector<std::string> empty;
-    std::string tagID = getTagID(tags[0]);
-    if (tags.size() == 0 || tagID == "")
+    std::string key = std::string("QUERY") + (recursive ? " RECURSIVE " : " ")
+        + tagQuery.toNormalizedString();
+    const Bitmap *cached = getCachedSearch(key);
+    if (cached != NULL)
     {
-        return empty; // invalid tag
+        plan.push_back("CACHED " + key + " -> " + std::to_string(cached->cardinality())
+            + " files");
+        return cached;
     }
-    std::vector<std::string> matches = getFileIDsUnderTagID(tagID);
-    std::vector<std::string> result;
-    std::size_t size = tags.size();
-    for (std::size_t i = 1; i < size; i++)
+    std::set<std::string> tagIDs;
+    bool usesAllFiles = false;
+    getQueryTagIDs(tagQuery.getRoot(), recursive, tagIDs, usesAllFiles);
+    Bitmap matches = evaluateQuery(tagQuery.getRoot(), recursive, plan);
+    return cacheSearch(key, tagIDs, usesAllFiles, matches);
+}
+
+/**
+ * Estimates the number of files matching the given tag query without evaluating it.
+ *
+ * @param node root of the expression tree of the tag query.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @return Estimated number of matching files.
+ */
+uint64_t TFSManager::estimateCardinality(const TagQueryNode &node, bool recursive)
+{
+    uint64_t numberOfFiles = allFileIDs.cardinality();
+    uint64_t estimate = 0;
+    switch (node.type)
     {
-        if ((tagID = getTagID(tags[i])) == "")
+        case TagQueryNode::TAG:
+            if (recursive)
+            {
+                std::set<std::string> tagIDs;
+                getDescendantTagIDs(getTagID(node.tag), tagIDs);
+                for (auto id : tagIDs)
+                {
+                    auto membership = tagMemberships.find(id);
+                    if (membership != tagMemberships.end())
+                    {
+                        estimate += membership->second.cardinality();
+                    }
+                }
+                estimate = std::min(estimate, numberOfFiles);
+            }
+            else
+            {
+                estimate = getTagMembership(node.tag).cardinality();
+            }
+            break;
+        case TagQueryNode::NOT:
+            estimate = estimateCardinality(node.children[0], recursive);
+            estimate = numberOfFiles - std::min(numberOfFiles, estimate);
+            break;
+        case TagQueryNode::OR:
+            for (auto &child : node.children)
+            {
+                estimate += estimateCardinality(child, recursive);
+            }
+            estimate = std::min(estimate, numberOfFiles);
+            break;
+        case TagQueryNode::AND:
         {
-            return empty; // invalid tag
+            estimate = numberOfFiles;
+            std::vector<std::string> tagIDs, negatedTagIDs;
+            for (auto &child : node.children)
+            {
+                if (child.type != TagQueryNode::NOT)
+                {
+                    estimate = std::min(estimate, estimateCardinality(child, recursive));
+                }
+                if (recursive == false && child.type == TagQueryNode::TAG)
+                {
+                    tagIDs.push_back(getTagID(child.tag));
+                }
+                else if (recursive == false && child.type == TagQueryNode::NOT
+                    && child.children[0].type == TagQueryNode::TAG)
+                {
+                    negatedTagIDs.push_back(getTagID(child.children[0].tag));
+                }
+            }
+            if (std::find(tagIDs.begin(), tagIDs.end(), "") != tagIDs.end())
+            {
+                break; // unknown tag, already estimated as empty
+            }
+            // files tagged with both tags of a pair bound the result from above
+            for (std::size_t i = 0; i < tagIDs.size(); i++)
+            {
+                for (std::size_t j = i + 1; j < tagIDs.size(); j++)
+                {
+                    estimate = std::min(estimate, getCooccurrence(tagIDs[i], tagIDs[j]));
+                }
+                auto membership = tagMemberships.find(tagIDs[i]);
+                uint64_t tagged = (membership == tagMemberships.end()) ? 0
+                    : membership->second.cardinality();
+                for (auto &negatedTagID : negatedTagIDs)
+                {
+                    estimate = std::min(estimate,
+                        tagged - std::min(tagged, getCooccurrence(tagIDs[i], negatedTagID)));
+                }
+            }
+            break;
         }
-        std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-        std::sort(matches.begin(), matches.end());
-        std::sort(fileIDs.begin(), fileIDs.end());
-        std::set_intersection(matches.begin(), matches.end(),
-            fileIDs.begin(), fileIDs.end(),
-            std::back_inserter(result));
-        matches = result;
-        result.empty();
     }
-    return matches;
+    return estimate;
 }
 
 /**
- * Finds file IDs of files tagged with any of the given tags.
+ * Evaluates the given tag query. Operands of AND are intersected from the smallest to the
+ * largest estimated number of files and negated operands are subtracted last, stopping as
+ * soon as the result is empty.
  *
- * @param tags tags with which files to be found may be tagged with.
- * @return String vector containing matching files.
+ * @param node root of the expression tree of the tag query.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @param plan vector to which a description of each evaluation step is appended.
+ * @param indent indentation of the description of the steps of this node.
+ * @return Bitmap containing matching file IDs.
  */
-std::vector<std::string> TFSManager::findFileIDsWithAnyOfTags(std::vector<std::string> tags)
+Bitmap TFSManager::evaluateQuery(const TagQueryNode &node, bool recursive,
+    std::vector<std::string> &plan, std::string indent)
 {
-    std::vector<std::string> empty;
-    std::string tagID;
-    if (tags.size() == 0)
-    {
-        return empty; // invalid tag
-    }
-    std::set<std::string> matches;
-    for (auto tag : tags)
+    std::size_t line = plan.size();
+    std::string estimate = " (estimated " + std::to_string(estimateCardinality(node, recursive))
+        + ")";
+    Bitmap result;
+    switch (node.type)
     {
-        if ((tagID = getTagID(tag)) == "")
-        {
-            return empty; // invalid tag
-        }
-        std::vector<std::string> fileIDs = getFileIDsUnderTagID(tagID);
-        for (auto id : fileIDs)
+        case TagQueryNode::TAG:
+            if (recursive)
+            {
+                plan.push_back(indent + "TAG " + node.tag + " AND NESTED TAGS" + estimate);
+                result = getRecursiveTagMembership(getTagID(node.tag));
+            }
+            else
+            {
+                plan.push_back(indent + "TAG " + node.tag + estimate);
+                result = getTagMembership(node.tag);
+            }
+            break;
+        case TagQueryNode::NOT:
+            plan.push_back(indent + "NOT" + estimate);
+            result = Bitmap::subtract(allFileIDs,
+                evaluateQuery(node.children[0], recursive, plan, indent + "  "));
+            break;
+        case TagQueryNode::OR:
+            plan.push_back(indent + "OR" + estimate);
+            for (auto &child : node.children)
+            {
+                result = Bitmap::unite(result,
+                    evaluateQuery(child, recursive, plan, indent + "  "));
+            }
+            break;
+        case TagQueryNode::AND:
         {
-            matches.insert(id);
+            plan.push_back(indent + "AND" + estimate);
+            typedef std::pair<uint64_t, const TagQueryNode *> Operand; // estimate and operand
+            std::vector<Operand> operands, negatedOperands;
+            for (auto &child : node.children)
+            {
+                if (child.type == TagQueryNode::NOT)
+                {
+                    const TagQueryNode *operand = &child.children[0];
+                    uint64_t operandEstimate = estimateCardinality(*operand, recursive);
+                    negatedOperands.push_back(Operand(operandEstimate, operand));
+                }
+                else
+                {
+                    operands.push_back(Operand(estimateCardinality(child, recursive), &child));
+                }
+            }
+            std::sort(operands.begin(), operands.end(),
+                [](const Operand &a, const Operand &b) { return a.first < b.first; });
+            // subtract larger sets first to shrink the result sooner
+            std::sort(negatedOperands.begin(), negatedOperands.end(),
+                [](const Operand &a, const Operand &b) { return a.first > b.first; });
+            std::size_t evaluated = 0;
+            if (operands.empty())
+            {
+                plan.push_back(indent + "  ALL FILES (" + std::to_string(allFileIDs.cardinality())
+                    + ")");
+                result = allFileIDs;
+            }
+            else
+            {
+                result = evaluateQuery(*operands[0].second, recursive, plan, indent + "  ");
+                evaluated++;
+            }
+            for (std::size_t i = 1; i < operands.size() && !result.isEmpty(); i++, evaluated++)
+            {
+                result = Bitmap::intersect(result,
+                    evaluateQuery(*operands[i].second, recursive, plan, indent + "  "));
+            }
+            for (auto operand : negatedOperands)
+            {
+                if (result.isEmpty())
+                {
+                    break;
+                }
+                evaluated++;
+                plan.push_back(indent + "  EXCEPT");
+                result = Bitmap::subtract(result,
+                    evaluateQuery(*operand.second, recursive, plan, indent + "    "));
+            }
+            std::size_t skipped = operands.size() + negatedOperands.size() - evaluated;
+            if (skipped != 0)
+            {
+                plan.push_back(indent + "  empty set, skipped " + std::to_string(skipped)
+                    + " operand(s)");
+            }
+            break;
         }
     }
-    return std::vector<std::string>(matches.begin(), matches.end());
+    plan[line] += " -> " + std::to_string(result.cardinality()) + " files";
+    return result;
 }
 
 /**
@@ -2032,6 +5298,10 @@ int TFSManager::renameTaggedPath(std::string oldPath, std::string newPath)
     std::string newTagID = getTagID(newName);
     std::string oldFileID = getTaggedFileID(oldParentTagID, oldName);
     std::string newFileID = getTaggedFileID(newParentTagID, newName);
+    if (newName[0] == '+' || newName[0] == '=' || newName[0] == '@')
+    {
+        return 1; // reserved for query directories, saved searches and untagged files
+    }
     if (oldFileID != "" && newTagID == "" && newFileID == "")
     {
         if (oldName != newName)
@@ -2058,10 +5328,224 @@ int TFSManager::renameTaggedPath(std::string oldPath, std::string newPath)
             macro_bind_text(stmts[RENAME_TAGGED_PATH], newName);
             macro_bind_int(stmts[RENAME_TAGGED_PATH], oldTagID);
             dbExecuteSV(stmts[RENAME_TAGGED_PATH]);
+            unindexTagName(oldName);
+            indexTagName(newName, oldTagID);
+            tagNamesGeneration++; // searches refer to tags by name
+            reevaluateSavedSearches(oldName);
+            reevaluateSavedSearches(newName);
         }
         return 0;
     }
     return 1;
 }
 
+/**************************************************************************************************
+ * Saved search methods
+ *************************************************************************************************/
+
+/**
+ * Adds the names of the tags used in a tag query to the given set.
+ *
+ * @param node root of the expression tree of the tag query.
+ * @param tagNames set where the tag names are to be stored.
+ */
+void getQueryTagNames(const TagQueryNode &node, std::set<std::string> &tagNames)
+{
+    if (node.type == TagQueryNode::TAG)
+    {
+        tagNames.insert(node.tag);
+    }
+    for (auto &child : node.children)
+    {
+        getQueryTagNames(child, tagNames);
+    }
+}
+
+/**
+ * Finds the tags a saved search depends on, which decide the un/tagging operations after
+ * which its matches have to be updated.
+ *
+ * @param search saved search to be indexed.
+ */
+void TFSManager::indexSavedSearch(SavedSearch &search)
+{
+    search.tagNames.clear();
+    search.tagIDs.clear();
+    search.usesAllFiles = false;
+    getQueryTagNames(search.tagQuery.getRoot(), search.tagNames);
+    getQueryTagIDs(search.tagQuery.getRoot(), search.recursive, search.tagIDs,
+        search.usesAllFiles);
+}
+
+/**
+ * Saves the bitmap of file IDs of the saved search with the given name after its matches
+ * changed.
+ *
+ * @param name name of the saved search.
+ */
+void TFSManager::updateSavedSearchFileIDs(std::string name)
+{
+    std::string serializedIDs = savedSearches[name].matches.serialize();
+    macro_bind_blob(stmts[UPDATE_SAVED_SEARCH_FILE_IDS], serializedIDs);
+    macro_bind_text(stmts[UPDATE_SAVED_SEARCH_FILE_IDS], name);
+    dbExecuteSV(stmts[UPDATE_SAVED_SEARCH_FILE_IDS]);
+}
+
+/**
+ * Saves a tag query under the given name, replacing any search saved with the same name, and
+ * evaluates it once. Its matches are then kept up to date as files change.
+ *
+ * @param name name of the search, also used as the directory "/=name" in tag view mode.
+ * @param serializedQuery tag query in postfix form.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::saveSearch(std::string name, std::string serializedQuery, bool recursive)
+{
+    SavedSearch search;
+    if (name == "" || name.find('/') != std::string::npos
+        || search.tagQuery.parsePostfix(serializedQuery) == false)
+    {
+        return 1;
+    }
+    search.recursive = recursive;
+    indexSavedSearch(search);
+    std::vector<std::string> plan;
+    search.matches = evaluateQuery(search.tagQuery.getRoot(), recursive, plan);
+    serializedQuery = search.tagQuery.serialize();
+    int64_t isRecursive = recursive ? 1 : 0;
+    std::string serializedIDs = search.matches.serialize();
+    macro_bind_text(stmts[SAVE_SEARCH], name);
+    macro_bind_text(stmts[SAVE_SEARCH], serializedQuery);
+    macro_bind_int64(stmts[SAVE_SEARCH], isRecursive);
+    macro_bind_blob(stmts[SAVE_SEARCH], serializedIDs);
+    dbExecuteSV(stmts[SAVE_SEARCH]);
+    savedSearches[name] = std::move(search);
+    return 0;
+}
+
+/**
+ * Deletes the saved search with the given name.
+ *
+ * @param name name of the saved search.
+ * @return 0 if successful or error value indicating the error.
+ */
+int TFSManager::deleteSavedSearch(std::string name)
+{
+    if (savedSearches.erase(name) == 0)
+    {
+        return ENOENT;
+    }
+    macro_bind_text(stmts[DELETE_SAVED_SEARCH], name);
+    dbExecuteSV(stmts[DELETE_SAVED_SEARCH]);
+    return 0;
+}
+
+/**
+ * Checks if a single file matches the given tag query using the tags kept in memory.
+ *
+ * @param node root of the expression tree of the tag query.
+ * @param fileID file ID of the file.
+ * @param recursive boolean to indicate if each tag includes the tags nested under it.
+ * @return Boolean indicating if the file matches.
+ */
+bool TFSManager::matchesQuery(const TagQueryNode &node, uint32_t fileID, bool recursive)
+{
+    switch (node.type)
+    {
+        case TagQueryNode::TAG:
+        {
+            std::set<std::string> tagIDs;
+            if (recursive)
+            {
+                getDescendantTagIDs(getTagID(node.tag), tagIDs);
+            }
+            else
+            {
+                tagIDs.insert(getTagID(node.tag));
+            }
+            for (auto tagID : tagIDs)
+            {
+                auto result = tagMemberships.find(tagID);
+                if (result != tagMemberships.end() && result->second.contains(fileID))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case TagQueryNode::NOT:
+            return !matchesQuery(node.children[0], fileID, recursive);
+        case TagQueryNode::OR:
+            for (auto &child : node.children)
+            {
+                if (matchesQuery(child, fileID, recursive))
+                {
+                    return true;
+                }
+            }
+            return false;
+        case TagQueryNode::AND:
+            for (auto &child : node.children)
+            {
+                if (!matchesQuery(child, fileID, recursive))
+                {
+                    return false;
+                }
+            }
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Updates the matches of the saved searches affected by a change to a single file by checking
+ * only that file against them.
+ *
+ * @param fileID file ID of the file which was tagged, untagged, added or deleted.
+ * @param tagID tag ID of the tag the file was un/tagged with, empty if it was added or deleted.
+ */
+void TFSManager::updateSavedSearches(uint32_t fileID, std::string tagID)
+{
+    for (auto &entry : savedSearches)
+    {
+        SavedSearch &search = entry.second;
+        bool isAffected = (tagID == "") ? search.usesAllFiles || search.matches.contains(fileID)
+            : search.tagIDs.count(tagID) != 0;
+        if (isAffected == false)
+        {
+            continue;
+        }
+        bool isMatch = allFileIDs.contains(fileID)
+            && matchesQuery(search.tagQuery.getRoot(), fileID, search.recursive);
+        if (isMatch ? search.matches.add(fileID) : search.matches.remove(fileID))
+        {
+            updateSavedSearchFileIDs(entry.first);
+        }
+    }
+}
+
+/**
+ * Evaluates again the saved searches affected by a tag being created, deleted or renamed or by
+ * tags being nested as the tags they depend on change.
+ *
+ * @param tag name of the tag which was created, deleted or renamed, empty if tags were un/nested
+ * in which case all recursive searches are evaluated again.
+ */
+void TFSManager::reevaluateSavedSearches(std::string tag)
+{
+    for (auto &entry : savedSearches)
+    {
+        SavedSearch &search = entry.second;
+        if ((tag == "") ? search.recursive == false : search.tagNames.count(tag) == 0)
+        {
+            continue;
+        }
+        indexSavedSearch(search);
+        std::vector<std::string> plan;
+        search.matches = evaluateQuery(search.tagQuery.getRoot(), search.recursive, plan);
+        updateSavedSearchFileIDs(entry.first);
+    }
+}
+
 }
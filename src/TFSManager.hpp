@@ -20,16 +20,76 @@
 
 #include "common.hpp"
 #include "FUSEFileSystem.hpp"
+#include "Bitmap.hpp"
+#include "TagQuery.hpp"
+#include "LRUCache.hpp"
+#include "WorkerPool.hpp"
+#include "HashingPool.hpp"
+#include "Hasher.hpp"
+#include "ChunkStore.hpp"
 #include <sqlite3.h>
-#include <openssl/md5.h>
 #include <fstream>
 #include <iomanip>
 #include <ctime>
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <queue>
+#include <sstream>
 
 namespace TaggableFS
 {
 
+/**
+ * A data type storing the result of a search along with the generations of the tags and files
+ * it was found at, used to check if the result is still valid.
+ */
+struct CachedSearch
+{
+    /** Generation of the tag names when the search was evaluated. */
+    uint64_t tagNamesGeneration;
+    /** Boolean to indicate if the search depends on the set of all files eg. uses NOT. */
+    bool usesAllFiles;
+    /** Generation of the set of all files when the search was evaluated. */
+    uint64_t allFilesGeneration;
+    /** Tag IDs of the tags the search depends on along with their generations. */
+    std::vector<std::pair<std::string, uint64_t>> tagGenerations;
+    /** File IDs of the matching files. */
+    Bitmap matches;
+};
+
+/**
+ * A data type storing a saved search along with its matching files, which are kept up to date
+ * as files are added, deleted, tagged and untagged instead of being found again on every read.
+ */
+struct SavedSearch
+{
+    /** Parsed tag query of the search. */
+    TagQuery tagQuery;
+    /** Boolean to indicate if each tag includes the tags nested under it. */
+    bool recursive;
+    /** Names of the tags used in the query. */
+    std::set<std::string> tagNames;
+    /** Tag IDs of the tags the search depends on. */
+    std::set<std::string> tagIDs;
+    /** Boolean to indicate if the search depends on the set of all files eg. uses NOT. */
+    bool usesAllFiles;
+    /** File IDs of the matching files. */
+    Bitmap matches;
+};
+
+/**
+ * A plain old data type storing the attributes of a file used to sort search results.
+ */
+struct FileAttributes
+{
+    /** Size of the file in bytes. */
+    uint64_t size;
+    /** Time of the last modification of the file in seconds since the epoch. */
+    int64_t mtime;
+};
+
 /**
  * This class handles queries from FUSE operations and command line queries from the user.
  */
@@ -60,6 +120,9 @@ private:
     /** Receiving message queue descriptor. */
     mqd_t rxMQ;
 
+    /** Sending message queue descriptor for the daemon's own queue, used by its threads. */
+    mqd_t txManagerMQ;
+
     /** Buffer to store messages to be sent/received. */
     char buffer[TFS_MQ_MESSAGE_SIZE];
 
@@ -72,10 +135,141 @@ private:
     /** Option to initialize FUSE filesystem in tag view mode. */
     bool tagView;
 
+    /** Memory budget for the catalog in MiB, 0 if the whole catalog is loaded into memory. */
+    std::size_t memoryBudget;
+
+    /** Hash algorithm requested for a new root directory, empty to use the default. */
+    std::string hashAlgorithm;
+
+    /** Hasher naming stored files with the algorithm recorded in the catalog. */
+    Hasher hasher;
+
+    /** Option to store large files in chunks, kept once recorded in the catalog. */
+    bool enableChunking;
+
+    /** Boolean indicating if filenames have a trigram index, else files are found by name
+     * with a scan of the files table. */
+    bool isFilenameIndexed;
+
+    /** Boolean indicating if the tag co-occurrences have to be counted from the bitmaps as the
+     * catalog is from before they were stored. */
+    bool isCooccurrenceCountNeeded;
+
+    /** Store of the chunks of chunked files in the root directory. */
+    ChunkStore chunkStore;
+
+    /** Number of handles of the driver reading each chunked file, by its hash value. */
+    std::unordered_map<std::string, std::size_t> chunkPins;
+
+    /** Chunks of removed chunked files still being read, by their hash values, whose
+     * references are dropped once the files are released. */
+    std::unordered_map<std::string, std::vector<std::string>> unpinnedChunks;
+
+    /** Layout of the stored files recorded in the catalog: flat, sharded or migrating. */
+    std::string layout;
+
+    /** Hash values of the files left to be moved while the layout is migrated. */
+    std::vector<std::string> migratingHashes;
+
+    /** Hash values of the chunks left to be moved while the layout is migrated. */
+    std::vector<std::string> migratingChunkHashes;
+
+    /** Bitmaps of file IDs tagged with each tag keyed by tag ID, kept in sync with database. */
+    std::unordered_map<std::string, Bitmap> tagMemberships;
+
+    /** Tag IDs of child tags nested under each tag keyed by tag ID, kept in sync with database. */
+    std::unordered_map<std::string, std::vector<std::string>> tagChildren;
+
+    /** Tag names paired with their tag IDs sorted by name, used to find tags by prefix. */
+    std::vector<std::pair<std::string, std::string>> tagNameIndex;
+
+    /** Bitmap of the file IDs of all files, used to evaluate NOT in tag queries. */
+    Bitmap allFileIDs;
+
+    /** Attributes of all files indexed by file ID, kept in sync with database. Empty with a
+     * memory budget as they are read from the database instead. */
+    std::vector<FileAttributes> fileAttributes;
+
+    /** Number of tags of each file indexed by file ID, empty with a memory budget. */
+    std::vector<uint32_t> fileTagCounts;
+
+    /** Bitmap of the file IDs of files without any tags, kept in sync with the tag counts. */
+    Bitmap untaggedFileIDs;
+
+    /** Number of files tagged with both tags of each pair of tags with common files. Empty with
+     * a memory budget as they are read from the database instead. */
+    std::unordered_map<std::string, std::unordered_map<std::string, uint64_t>> tagCooccurrences;
+
+    /** Counters keyed by tag ID incremented whenever the tag's files or child tags change. */
+    std::unordered_map<std::string, uint64_t> tagGenerations;
+
+    /** Counter incremented whenever a tag is created, deleted or renamed. */
+    uint64_t tagNamesGeneration;
+
+    /** Counter incremented whenever a file is added or deleted. */
+    uint64_t allFilesGeneration;
+
+    /** Threads sharing the evaluation of searches over many containers. */
+    WorkerPool workerPool;
+
+    /** Threads hashing large written files while the daemon answers other queries. */
+    HashingPool hashingPool;
+
+    /** Counter naming files stored until their hash values are known. */
+    uint64_t pendingHashNumber;
+
+    /** Hash values of the stored files replaced by files being hashed in the background, keyed
+     * by their pending names, removed once the new hash values are known unless the same. */
+    std::unordered_map<std::string, std::string> replacedHashes;
+
+    /** Results of searches and query directories keyed by their normalized queries. */
+    LRUCache<std::string, CachedSearch> searchCache;
+
+    /** Saved searches with their matching files keyed by name, kept in sync with database. */
+    std::map<std::string, SavedSearch> savedSearches;
+
+    /** Result of the last search too large to be cached. */
+    Bitmap uncachedSearch;
+
+    /** Number of searches answered from the search cache. */
+    uint64_t searchCacheHits;
+
+    /** Number of searches which had to be evaluated. */
+    uint64_t searchCacheMisses;
+
+    /** Number of searches answered since the daemon started. */
+    uint64_t numberOfSearches;
+
+    /** Total time taken from receiving a search to sending its first results in microseconds. */
+    uint64_t totalTimeToFirstResult;
+
     void startDaemon();
     void initMQ();
     void loadDBFromStorage();
     void initDB();
+    void configureCatalogMemory();
+    std::size_t getIndexMemoryUsage();
+    void fitSearchCacheToBudget();
+    void upgradeDB();
+    void backfillFileAttributes();
+    void createFilenameIndex();
+    void createChangeIndexes();
+    void createRemovalTracking();
+    void addRemovedPath(std::string path);
+    void createFilenameLookupIndex();
+    void createSizeIndex();
+    void createSavedSearchesTable();
+    void createVariablesTable(std::string hashAlgorithm, std::string layout);
+    void setVariable(std::string name, std::string value);
+    void createChunksTable();
+    void createTagCooccurrencesTable();
+    void loadVariables();
+    void loadTags();
+    void loadAllFileIDs();
+    void countFileTags();
+    void countTagCooccurrences();
+    void loadTagCooccurrences();
+    void loadSavedSearches();
     void prepareStatements();
     void finalizeStatements();
     void initFUSEFileSystem();
@@ -84,9 +278,19 @@ private:
     void run();
     void messageFUSEFileSystem(std::string message, bool complete = true);
     void messageQueryHandler(std::string message, bool complete = true);
+    void sendFacets(const Bitmap &matches, const std::set<std::string> &excludedTagIDs,
+        uint64_t numberOfFacets);
+    std::unordered_map<uint32_t, FileAttributes> getFileAttributes(
+        const std::vector<uint32_t> &fileIDs);
+    std::vector<uint32_t> sortFileIDsByIndex(const Bitmap &matches, SortOrder sort,
+        std::size_t count);
+    std::vector<uint32_t> sortFileIDs(const Bitmap &matches, const SearchOptions &options);
+    void sendSearchResults(const Bitmap &matches, const SearchOptions &options,
+        std::chrono::steady_clock::time_point start);
     bool dispatch(Message m);
 
     std::string calculateHash(std::string path);
+    bool isSameContents(std::string path, std::string blobPath);
     std::string dbExecuteSV(sqlite3_stmt *stmt); // execute and retrive single value
     std::vector<std::string> dbExecuteMV(sqlite3_stmt *stmt); // retrive multiple values
     std::vector<std::vector<std::string>> dbExecuteMR(sqlite3_stmt *stmt); // retrive multiple rows
@@ -104,6 +308,7 @@ private:
     std::string getHash(std::string filename, std::string parentFolderID);
     bool isFolderEmpty(std::string folderID);
     void updateHash(std::string fileID, std::string newHash);
+    void updateFileAttributes(std::string fileID, std::string hash);
     std::string getFilePath(std::string relativePath);
     std::vector<std::string> listFolder(std::string folderPath);
     int createFolder(std::string folderPath);
@@ -111,8 +316,21 @@ private:
     int deleteFile(std::string filePath, std::vector<std::string> *savedTagIDs = NULL);
     int renamePath(std::string oldPath, std::string newPath);
     int truncateFile(off_t length, std::string filePath);
-    void updateFile(std::string filePath);
-    void addTemporaryFile(std::string tempFilePath);
+    void updateFile(std::string filePath, std::string newHash = "");
+    void resumePendingHashes();
+    void finishPendingHash(std::string pendingName, std::string newHash);
+    std::string addTemporaryFile(std::string tempFilePath);
+    std::string getBlobPath(std::string hash, bool create = false);
+    uint64_t migrateLayout();
+    void migrateLayoutBatch();
+    uint64_t migrateBlob(std::string hash);
+    void storeBlob(std::string path, std::string hash);
+    int removeBlob(std::string hash);
+    void updateChunkReferences(std::string chunkHash, int64_t change);
+    void unpinChunks(std::string hash);
+    void storeChunkedBlob(std::string path, std::string hash, const Manifest &manifest);
+    void releaseChunks(const Manifest &manifest);
+    void removeUnusedBlob(std::string oldHash);
 
     /**************************************************************************
      * Tag methods
@@ -122,17 +340,39 @@ private:
     std::string getParentTagIDFromPath(std::string tagPath);
     std::string getTaggedFileID(std::string parentTagID, std::string filename);
     std::string getTagNameFromID(std::string tagID);
+    void indexTagName(std::string tag, std::string tagID);
+    void unindexTagName(std::string tag);
+    std::vector<std::pair<std::string, uint64_t>> completeTag(std::string prefix,
+        std::size_t limit, bool fuzzy);
     std::vector<std::string> getAllTagIDs();
     std::vector<std::string> getParentTagIDs(std::string tagID);
     void getAncestorTagIDs(std::string tagID, std::set<std::string> &ancestors);
     std::vector<std::string> getChildTagIDs(std::string tagID);
+    void getDescendantTagIDs(std::string tagID, std::set<std::string> &descendants);
     std::vector<std::string> getFileIDsUnderTagID(std::string tagID);
+    std::string getFolderPath(std::string folderID,
+        std::unordered_map<std::string, std::string> &folderPaths);
+    std::vector<std::string> getFilePathsFromIDs(const std::vector<uint32_t> &fileIDs,
+        std::unordered_map<std::string, std::string> &folderPaths);
     std::vector<std::string> getFilenamesUnderTagID(std::string tagID);
+    std::vector<std::string> getFilenamesFromIDs(const std::vector<uint32_t> &fileIDs);
+    std::string findFileIDByFilename(const Bitmap *fileIDs, std::string filename);
+    const Bitmap *getQueryDirectoryFileIDs(std::string path);
     std::vector<std::string> listTagChildren(std::string tagID);
     std::string getTaggedFilePath(std::string relativePath);
     int createTag(std::string tagPath);
     int deleteTag(std::string tagPath);
-    void updateTagFileIDs(std::string tagID, std::vector<std::string> fileIDs);
+    void updateTagFileIDs(std::string tagID);
+    void updateFileTagCount(uint32_t fileID, bool isTagged);
+    std::vector<std::string> getFileTagIDs(uint32_t fileID);
+    void updateTagCooccurrences(const std::vector<std::string> &tagIDs,
+        const std::vector<std::string> &otherTagIDs, bool isTagged);
+    void saveTagCooccurrence(std::string tagID, std::string otherTagID, int64_t change);
+    void updateTaggedAt(std::string fileID);
+    uint64_t getCooccurrence(std::string tagID, std::string otherTagID);
+    std::unordered_map<std::string, uint64_t> getTagCooccurrences(std::string tagID);
+    std::vector<std::pair<std::string, uint64_t>> suggestTags(std::string fileID,
+        std::size_t limit);
     void updateParentTagIDs(std::string tagID, std::vector<std::string> parentTagIDs);
     void updateChildTagIDs(std::string tagID, std::vector<std::string> parentTagIDs);
     int tagSingleFile(std::string fileID, std::string tagID);
@@ -142,13 +382,41 @@ private:
     int nestTag(std::string tagID, std::string parentTagID);
     int unnestTag(std::string tagID, std::string parentTagID);
     std::vector<std::string> getFileTags(std::string fileID);
-    std::vector<std::string> findFileIDsWithTags(std::vector<std::string> tags);
-    std::vector<std::string> findFileIDsWithAnyOfTags(std::vector<std::string> tags);
+    Bitmap combineBitmaps(const std::vector<const Bitmap *> &bitmaps, bool intersect);
+    Bitmap findFileIDsWithTags(std::vector<std::string> tags, bool recursive);
+    Bitmap findFileIDsWithAnyOfTags(std::vector<std::string> tags, bool recursive);
+    Bitmap findFileIDsByName(std::string pattern);
+    const Bitmap &getTagMembership(std::string tag);
+    Bitmap getRecursiveTagMembership(std::string tagID);
+    void getQueryTagIDs(const TagQueryNode &node, bool recursive, std::set<std::string> &tagIDs,
+        bool &usesAllFiles);
+    const Bitmap *getCachedSearch(std::string key);
+    const Bitmap *cacheSearch(std::string key, const std::set<std::string> &tagIDs,
+        bool usesAllFiles, Bitmap &matches);
+    const Bitmap *searchTags(std::vector<std::string> tags, const SearchOptions &options);
+    const Bitmap *searchQuery(const TagQuery &tagQuery, bool recursive,
+        std::vector<std::string> &plan);
+    uint64_t estimateCardinality(const TagQueryNode &node, bool recursive);
+    Bitmap evaluateQuery(const TagQueryNode &node, bool recursive,
+        std::vector<std::string> &plan, std::string indent = "");
     int renameTaggedPath(std::string oldPath, std::string newPath);
 
+    /**************************************************************************
+     * Saved search methods
+     *************************************************************************/
+
+    void indexSavedSearch(SavedSearch &search);
+    void updateSavedSearchFileIDs(std::string name);
+    int saveSearch(std::string name, std::string serializedQuery, bool recursive);
+    int deleteSavedSearch(std::string name);
+    bool matchesQuery(const TagQueryNode &node, uint32_t fileID, bool recursive);
+    void updateSavedSearches(uint32_t fileID, std::string tagID);
+    void reevaluateSavedSearches(std::string tag);
+
 public:
     TFSManager(std::string mountPoint, std::string rootDirectory,
-        std::string programName, bool enableLogging, bool tagView);
+        std::string programName, bool enableLogging, bool tagView, std::size_t memoryBudget,
+        std::string hashAlgorithm, bool enableChunking);
     int init();
 };
 
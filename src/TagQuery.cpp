@@ -0,0 +1,540 @@
+/**
+ * @file TagQuery.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the TagQuery class.
+ *
+ * @details This file contains the method definitions for the TagQuery class.
+ */
+
+#include "TagQuery.hpp"
+
+namespace TaggableFS
+{
+
+/**
+ * Constructor for the TagQuery class.
+ */
+TagQuery::TagQuery() : position(0)
+{
+    root.type = TagQueryNode::TAG;
+}
+
+/**
+ * Splits the query into tokens. Parentheses are tokens by themselves and tags containing
+ * spaces, parentheses or named AND, OR or NOT can be given in double quotes.
+ *
+ * @param expression query to be split into tokens.
+ * @return Boolean indicating if the query could be split into tokens.
+ */
+bool TagQuery::tokenize(std::string expression)
+{
+    tokens.clear();
+    tokenSpans.clear();
+    this->expression = expression;
+    std::size_t i = 0, length = expression.length();
+    while (i < length)
+    {
+        char c = expression[i];
+        std::size_t start = i, numberOfTokens = tokens.size();
+        if (isspace(c))
+        {
+            i++;
+        }
+        else if (c == '(' || c == ')')
+        {
+            tokens.push_back(std::string(1, c));
+            i++;
+        }
+        else if (c == '"')
+        {
+            std::size_t end = expression.find('"', i + 1);
+            if (end == std::string::npos || end == i + 1)
+            {
+                error = "Unterminated or empty quoted tag.";
+                return false;
+            }
+            tokens.push_back("#" + expression.substr(i + 1, end - i - 1));
+            i = end + 1;
+        }
+        else
+        {
+            std::size_t end = i;
+            while (end < length && !isspace(expression[end]) && expression[end] != '('
+                && expression[end] != ')' && expression[end] != '"')
+            {
+                end++;
+            }
+            std::string word = expression.substr(i, end - i);
+            bool isOperator = (word == "AND" || word == "OR" || word == "NOT");
+            tokens.push_back(isOperator ? word : "#" + word);
+            i = end;
+        }
+        if (tokens.size() != numberOfTokens)
+        {
+            tokenSpans.emplace_back(start, i - start);
+        }
+        if (!tokens.empty() && tokens.back().find_first_of(";/") != std::string::npos)
+        {
+            error = "Tags can't contain ';' or '/'.";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Describes a token for errors by quoting it as typed along with its position in the query.
+ *
+ * @param index index of the token.
+ * @return Description of the token.
+ */
+std::string TagQuery::describeToken(std::size_t index) const
+{
+    const std::pair<std::size_t, std::size_t> &span = tokenSpans[index];
+    return "'" + expression.substr(span.first, span.second) + "' at position "
+        + std::to_string(span.first + 1);
+}
+
+/**
+ * Parses operands separated by OR.
+ *
+ * @param node node to store the parsed expression in.
+ * @return Boolean indicating if parsing succeeded.
+ */
+bool TagQuery::parseOr(TagQueryNode &node)
+{
+    if (parseAnd(node) == false)
+    {
+        return false;
+    }
+    bool isFirst = true;
+    while (position < tokens.size() && tokens[position] == "OR")
+    {
+        position++;
+        TagQueryNode operand;
+        if (parseAnd(operand) == false)
+        {
+            return false;
+        }
+        if (isFirst)
+        {
+            node = TagQueryNode{TagQueryNode::OR, "", {node}};
+            isFirst = false;
+        }
+        node.children.push_back(operand);
+    }
+    return true;
+}
+
+/**
+ * Parses operands separated by AND.
+ *
+ * @param node node to store the parsed expression in.
+ * @return Boolean indicating if parsing succeeded.
+ */
+bool TagQuery::parseAnd(TagQueryNode &node)
+{
+    if (parseNot(node) == false)
+    {
+        return false;
+    }
+    bool isFirst = true;
+    while (position < tokens.size() && tokens[position] == "AND")
+    {
+        position++;
+        TagQueryNode operand;
+        if (parseNot(operand) == false)
+        {
+            return false;
+        }
+        if (isFirst)
+        {
+            node = TagQueryNode{TagQueryNode::AND, "", {node}};
+            isFirst = false;
+        }
+        node.children.push_back(operand);
+    }
+    return true;
+}
+
+/**
+ * Parses an operand which may be negated with NOT.
+ *
+ * @param node node to store the parsed expression in.
+ * @return Boolean indicating if parsing succeeded.
+ */
+bool TagQuery::parseNot(TagQueryNode &node)
+{
+    if (position < tokens.size() && tokens[position] == "NOT")
+    {
+        position++;
+        TagQueryNode operand;
+        if (parseNot(operand) == false)
+        {
+            return false;
+        }
+        node = TagQueryNode{TagQueryNode::NOT, "", {operand}};
+        return true;
+    }
+    return parsePrimary(node);
+}
+
+/**
+ * Parses a tag or an expression in parentheses.
+ *
+ * @param node node to store the parsed expression in.
+ * @return Boolean indicating if parsing succeeded.
+ */
+bool TagQuery::parsePrimary(TagQueryNode &node)
+{
+    if (position == tokens.size())
+    {
+        error = "Unexpected end of query.";
+        return false;
+    }
+    std::size_t index = position;
+    std::string token = tokens[position++];
+    if (token == "(")
+    {
+        if (parseOr(node) == false)
+        {
+            return false;
+        }
+        if (position == tokens.size() || tokens[position] != ")")
+        {
+            error = "Missing ')'.";
+            return false;
+        }
+        position++;
+        return true;
+    }
+    if (token[0] != '#')
+    {
+        error = "Unexpected " + describeToken(index) + ".";
+        return false;
+    }
+    node = TagQueryNode{TagQueryNode::TAG, token.substr(1), {}};
+    return true;
+}
+
+/**
+ * Simplifies the expression tree by merging nested operators of the same type and removing
+ * double negations.
+ *
+ * @param node root of the expression tree to be simplified.
+ */
+void TagQuery::flatten(TagQueryNode &node)
+{
+    for (auto &child : node.children)
+    {
+        flatten(child);
+    }
+    if (node.type == TagQueryNode::NOT && node.children[0].type == TagQueryNode::NOT)
+    {
+        TagQueryNode operand = node.children[0].children[0];
+        node = operand;
+        return;
+    }
+    if (node.type == TagQueryNode::AND || node.type == TagQueryNode::OR)
+    {
+        std::vector<TagQueryNode> children;
+        for (auto &child : node.children)
+        {
+            if (child.type == node.type)
+            {
+                children.insert(children.end(), child.children.begin(), child.children.end());
+            }
+            else
+            {
+                children.push_back(child);
+            }
+        }
+        node.children = children;
+    }
+}
+
+/**
+ * Converts the expression tree into postfix tokens. Tags are prefixed with '#', AND and OR
+ * are written as '&' and '|' followed by the number of operands and NOT as '!'.
+ *
+ * @param node root of the expression tree.
+ * @param postfix vector to which tokens are appended.
+ */
+void TagQuery::toPostfix(const TagQueryNode &node, std::vector<std::string> &postfix)
+{
+    for (auto &child : node.children)
+    {
+        toPostfix(child, postfix);
+    }
+    switch (node.type)
+    {
+        case TagQueryNode::TAG:
+            postfix.push_back("#" + node.tag);
+            break;
+        case TagQueryNode::AND:
+            postfix.push_back("&" + std::to_string(node.children.size()));
+            break;
+        case TagQueryNode::OR:
+            postfix.push_back("|" + std::to_string(node.children.size()));
+            break;
+        case TagQueryNode::NOT:
+            postfix.push_back("!");
+            break;
+    }
+}
+
+/**
+ * Converts the expression tree into a query which can be parsed again.
+ *
+ * @param node root of the expression tree.
+ * @return Query as a string.
+ */
+std::string TagQuery::toInfix(const TagQueryNode &node)
+{
+    if (node.type == TagQueryNode::TAG)
+    {
+        bool needsQuotes = (node.tag == "AND" || node.tag == "OR" || node.tag == "NOT"
+            || node.tag.find_first_of(" \t()") != std::string::npos);
+        return needsQuotes ? "\"" + node.tag + "\"" : node.tag;
+    }
+    if (node.type == TagQueryNode::NOT)
+    {
+        return "NOT " + toInfix(node.children[0]);
+    }
+    std::string separator = (node.type == TagQueryNode::AND) ? " AND " : " OR ";
+    std::string infix = "(";
+    for (std::size_t i = 0; i < node.children.size(); i++)
+    {
+        infix += ((i == 0) ? "" : separator) + toInfix(node.children[i]);
+    }
+    return infix + ")";
+}
+
+/**
+ * Sorts the operands of AND and OR and removes duplicate operands so that equivalent queries
+ * written in a different order have the same form.
+ *
+ * @param node root of the expression tree to be sorted.
+ */
+void TagQuery::sortOperands(TagQueryNode &node)
+{
+    for (auto &child : node.children)
+    {
+        sortOperands(child);
+    }
+    if (node.type == TagQueryNode::AND || node.type == TagQueryNode::OR)
+    {
+        std::vector<std::pair<std::string, TagQueryNode>> operands;
+        for (auto &child : node.children)
+        {
+            operands.push_back(std::make_pair(toInfix(child), child));
+        }
+        std::sort(operands.begin(), operands.end(),
+            [](const std::pair<std::string, TagQueryNode> &a,
+                const std::pair<std::string, TagQueryNode> &b) { return a.first < b.first; });
+        node.children.clear();
+        for (std::size_t i = 0; i < operands.size(); i++)
+        {
+            if (i == 0 || operands[i].first != operands[i - 1].first)
+            {
+                node.children.push_back(operands[i].second);
+            }
+        }
+        if (node.children.size() == 1)
+        {
+            TagQueryNode operand = node.children[0];
+            node = operand;
+        }
+    }
+}
+
+/**
+ * Parses the given query typed by the user.
+ *
+ * @param expression query to be parsed.
+ * @return Boolean indicating if parsing succeeded, else see getError().
+ */
+bool TagQuery::parse(std::string expression)
+{
+    position = 0;
+    error = "";
+    if (tokenize(expression) == false)
+    {
+        return false;
+    }
+    if (tokens.empty())
+    {
+        error = "Empty query.";
+        return false;
+    }
+    TagQueryNode node;
+    if (parseOr(node) == false)
+    {
+        return false;
+    }
+    if (position != tokens.size())
+    {
+        error = "Unexpected " + describeToken(position) + ".";
+        return false;
+    }
+    flatten(node);
+    root = node;
+    return true;
+}
+
+/**
+ * Parses the given query in postfix form as serialized by serialize().
+ *
+ * @param serializedQuery serialized query.
+ * @return Boolean indicating if parsing succeeded, else see getError().
+ */
+bool TagQuery::parsePostfix(std::string serializedQuery)
+{
+    error = "";
+    std::vector<TagQueryNode> stack;
+    for (auto token : deserializeStrings(serializedQuery))
+    {
+        if (token[0] == '#')
+        {
+            stack.push_back(TagQueryNode{TagQueryNode::TAG, token.substr(1), {}});
+            continue;
+        }
+        std::size_t arity = 1;
+        TagQueryNode node{TagQueryNode::NOT, "", {}};
+        if (token[0] == '&' || token[0] == '|')
+        {
+            node.type = (token[0] == '&') ? TagQueryNode::AND : TagQueryNode::OR;
+            arity = strtoul(token.c_str() + 1, NULL, 10);
+        }
+        else if (token != "!")
+        {
+            error = "Invalid token '" + token + "'.";
+            return false;
+        }
+        if (arity == 0 || arity > stack.size())
+        {
+            error = "Invalid query.";
+            return false;
+        }
+        node.children.assign(stack.end() - arity, stack.end());
+        stack.resize(stack.size() - arity);
+        stack.push_back(node);
+    }
+    if (stack.size() != 1)
+    {
+        error = "Invalid query.";
+        return false;
+    }
+    root = stack[0];
+    return true;
+}
+
+/**
+ * Parses a query written as a directory name in tag view mode where each tag is prefixed with
+ * '+' if files must have it or '-' if files must not have it eg. "+project-x+raw-archived".
+ * Since '+' and '-' separate tags, tags containing them are written with percent encoding
+ * eg. "+project%2Dx".
+ *
+ * @param name directory name starting with '+'.
+ * @return Boolean indicating if parsing succeeded, else see getError().
+ */
+bool TagQuery::parseDirectoryName(std::string name)
+{
+    error = "";
+    if (name.length() < 2 || name[0] != '+')
+    {
+        error = "Query directories start with '+'.";
+        return false;
+    }
+    TagQueryNode node{TagQueryNode::AND, "", {}};
+    std::size_t start = 0;
+    while (start < name.length())
+    {
+        std::size_t end = name.find_first_of("+-", start + 1);
+        end = (end == std::string::npos) ? name.length() : end;
+        std::string tag = "";
+        for (std::size_t i = start + 1; i < end; i++)
+        {
+            if (name[i] == '%' && i + 2 < end && isxdigit(name[i + 1]) && isxdigit(name[i + 2]))
+            {
+                tag += static_cast<char>(std::stoi(name.substr(i + 1, 2), NULL, 16));
+                i += 2;
+            }
+            else
+            {
+                tag += name[i];
+            }
+        }
+        if (tag == "")
+        {
+            error = "Empty tag in query directory.";
+            return false;
+        }
+        TagQueryNode operand{TagQueryNode::TAG, tag, {}};
+        if (name[start] == '-')
+        {
+            operand = TagQueryNode{TagQueryNode::NOT, "", {operand}};
+        }
+        node.children.push_back(operand);
+        start = end;
+    }
+    root = (node.children.size() == 1) ? node.children[0] : node;
+    return true;
+}
+
+/**
+ * Serializes the parsed query in postfix form to be sent to the TaggableFS daemon.
+ *
+ * @return Serialized query.
+ */
+std::string TagQuery::serialize() const
+{
+    std::vector<std::string> postfix;
+    toPostfix(root, postfix);
+    return serializeStrings(postfix);
+}
+
+/**
+ * Converts the parsed query into a string with explicit parentheses.
+ *
+ * @return Query as a string.
+ */
+std::string TagQuery::toString() const
+{
+    return toInfix(root);
+}
+
+/**
+ * Converts the parsed query into a string where the operands of AND and OR are sorted so that
+ * equivalent queries give the same string.
+ *
+ * @return Normalized query as a string.
+ */
+std::string TagQuery::toNormalizedString() const
+{
+    TagQueryNode node = root;
+    sortOperands(node);
+    return toInfix(node);
+}
+
+/**
+ * Gets the description of the error if parsing failed.
+ *
+ * @return Error description.
+ */
+std::string TagQuery::getError() const
+{
+    return error;
+}
+
+/**
+ * Gets the root of the expression tree of the parsed query.
+ *
+ * @return Root node of the expression tree.
+ */
+const TagQueryNode &TagQuery::getRoot() const
+{
+    return root;
+}
+
+}
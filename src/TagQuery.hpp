@@ -0,0 +1,95 @@
+/**
+ * @file TagQuery.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the TagQuery class.
+ *
+ * @details This file contains the class definition for the TagQuery class.
+ * The TagQuery class parses boolean tag queries such as
+ * "(project-x AND raw) AND NOT archived OR urgent" into an expression tree.
+ * QueryHandler parses the query typed by the user and sends it to the
+ * TaggableFS daemon in postfix form which the daemon then evaluates. Queries
+ * can also be written as directory names like "+project-x+raw-archived" in
+ * tag view mode.
+ */
+
+#ifndef TFS_TAGQUERY_HPP
+#define TFS_TAGQUERY_HPP
+
+#include "common.hpp"
+
+namespace TaggableFS
+{
+
+/**
+ * A node of the expression tree of a parsed tag query.
+ */
+struct TagQueryNode
+{
+    /** Types of nodes in the expression tree. */
+    enum Type
+    {
+        TAG,
+        AND,
+        OR,
+        NOT
+    };
+
+    /** Type of the node. */
+    Type type;
+    /** Tag name if the node is a tag. */
+    std::string tag;
+    /** Operands if the node is an operator, NOT has a single operand. */
+    std::vector<TagQueryNode> children;
+};
+
+/**
+ * This class parses boolean tag queries with AND, OR, NOT and parentheses where NOT binds
+ * tighter than AND which binds tighter than OR.
+ */
+class TagQuery
+{
+private:
+    /** Root of the expression tree. */
+    TagQueryNode root;
+
+    /** Tokens of the query being parsed, quoted tags are prefixed with '#'. */
+    std::vector<std::string> tokens;
+
+    /** Query being parsed as typed by the user. */
+    std::string expression;
+
+    /** Offsets and lengths of the tokens in the query as typed, used in errors. */
+    std::vector<std::pair<std::size_t, std::size_t>> tokenSpans;
+
+    /** Position of the next token to be parsed. */
+    std::size_t position;
+
+    /** Description of the error if parsing failed. */
+    std::string error;
+
+    bool tokenize(std::string expression);
+    std::string describeToken(std::size_t index) const;
+    bool parseOr(TagQueryNode &node);
+    bool parseAnd(TagQueryNode &node);
+    bool parseNot(TagQueryNode &node);
+    bool parsePrimary(TagQueryNode &node);
+    static void flatten(TagQueryNode &node);
+    static void toPostfix(const TagQueryNode &node, std::vector<std::string> &postfix);
+    static std::string toInfix(const TagQueryNode &node);
+    static void sortOperands(TagQueryNode &node);
+
+public:
+    TagQuery();
+    bool parse(std::string expression);
+    bool parsePostfix(std::string serializedQuery);
+    bool parseDirectoryName(std::string name);
+    std::string serialize() const;
+    std::string toString() const;
+    std::string toNormalizedString() const;
+    std::string getError() const;
+    const TagQueryNode &getRoot() const;
+};
+
+}
+
+#endif
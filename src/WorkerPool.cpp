@@ -0,0 +1,123 @@
+/**
+ * @file WorkerPool.cpp
+ * @author Santhosh Ranganathan
+ * @brief The source file for the WorkerPool class.
+ *
+ * @details This file contains the method definitions for the WorkerPool class.
+ */
+
+#include "WorkerPool.hpp"
+
+namespace TaggableFS
+{
+
+/**
+ * Constructor for the WorkerPool class. Threads are only started by start() so that the pool
+ * can be created before the daemon forks.
+ */
+WorkerPool::WorkerPool()
+    : numberOfTasks(0), nextTask(0), finishedTasks(0), runNumber(0), isStopping(false)
+{
+}
+
+/**
+ * Destructor for the WorkerPool class. Stops and joins the threads.
+ */
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    runStarted.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * Starts the threads of the pool.
+ *
+ * @param numberOfThreads number of threads to be started besides the calling thread.
+ */
+void WorkerPool::start(std::size_t numberOfThreads)
+{
+    for (std::size_t i = 0; i < numberOfThreads; i++)
+    {
+        threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+/**
+ * Gets the number of threads tasks are run on including the calling thread.
+ *
+ * @return Number of threads.
+ */
+std::size_t WorkerPool::size() const
+{
+    return threads.size() + 1;
+}
+
+/**
+ * Picks up parts of the current run until none are left. The lock is released while a part
+ * is being done.
+ *
+ * @param lock lock held on the mutex of the pool.
+ */
+void WorkerPool::runTasks(std::unique_lock<std::mutex> &lock)
+{
+    while (nextTask < numberOfTasks)
+    {
+        std::size_t part = nextTask++;
+        lock.unlock();
+        task(part);
+        lock.lock();
+        if (++finishedTasks == numberOfTasks)
+        {
+            runFinished.notify_all();
+        }
+    }
+}
+
+/**
+ * Waits for runs and helps with their parts until the pool stops.
+ */
+void WorkerPool::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t lastRun = runNumber;
+    while (true)
+    {
+        runStarted.wait(lock, [&]() { return isStopping || runNumber != lastRun; });
+        if (isStopping)
+        {
+            return;
+        }
+        lastRun = runNumber;
+        runTasks(lock);
+    }
+}
+
+/**
+ * Runs the given task for each part from 0 to the number of tasks on the threads of the pool
+ * and the calling thread and waits for all of them to finish. Without threads the parts run
+ * one after another on the calling thread.
+ *
+ * @param numberOfTasks number of parts.
+ * @param task task to be called with the number of each part.
+ */
+void WorkerPool::run(std::size_t numberOfTasks, std::function<void(std::size_t)> task)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->task = task;
+    this->numberOfTasks = numberOfTasks;
+    nextTask = 0;
+    finishedTasks = 0;
+    runNumber++;
+    runStarted.notify_all();
+    runTasks(lock);
+    runFinished.wait(lock, [&]() { return finishedTasks == this->numberOfTasks; });
+}
+
+}
@@ -0,0 +1,76 @@
+/**
+ * @file WorkerPool.hpp
+ * @author Santhosh Ranganathan
+ * @brief The header file for the WorkerPool class.
+ *
+ * @details This file contains the class definition for the WorkerPool class.
+ * The WorkerPool class keeps a fixed number of threads waiting for work so that
+ * the TaggableFS daemon can split the evaluation of large searches into parts
+ * which are evaluated on all cores without starting threads for every search.
+ */
+
+#ifndef TFS_WORKERPOOL_HPP
+#define TFS_WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TaggableFS
+{
+
+/**
+ * This class runs numbered tasks on a pool of threads and the calling thread, returning once
+ * all of them are done.
+ */
+class WorkerPool
+{
+private:
+    /** Threads of the pool. */
+    std::vector<std::thread> threads;
+
+    /** Mutex guarding the state of the current run. */
+    std::mutex mutex;
+
+    /** Condition variable signalled when a run starts or the pool stops. */
+    std::condition_variable runStarted;
+
+    /** Condition variable signalled when the last task of a run is done. */
+    std::condition_variable runFinished;
+
+    /** Task of the current run called with the number of each part. */
+    std::function<void(std::size_t)> task;
+
+    /** Number of parts of the current run. */
+    std::size_t numberOfTasks;
+
+    /** Number of the next part to be picked up. */
+    std::size_t nextTask;
+
+    /** Number of parts done. */
+    std::size_t finishedTasks;
+
+    /** Counter incremented for every run so threads can tell runs apart. */
+    uint64_t runNumber;
+
+    /** Boolean set when the pool is being destroyed. */
+    bool isStopping;
+
+    void work();
+    void runTasks(std::unique_lock<std::mutex> &lock);
+
+public:
+    WorkerPool();
+    ~WorkerPool();
+    void start(std::size_t numberOfThreads);
+    std::size_t size() const;
+    void run(std::size_t numberOfTasks, std::function<void(std::size_t)> task);
+};
+
+}
+
+#endif
@@ -8,6 +8,15 @@
  */
 
 #include "common.hpp"
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+/** Size in bytes of the reads when a file is copied without copy_file_range(). */
+#define TFS_COPY_BUFFER_SIZE (128 << 10)
 
 namespace TaggableFS
 {
@@ -91,6 +100,119 @@ std::string getFilename(std::string path)
     return path.substr(path.find_last_of('/') + 1);
 }
 
+/**
+ * Gets the path of a file stored in a directory fanned out into two levels of subdirectories
+ * named by the last four characters of the filename eg. DIRECTORY/1C/9E/4A0B1C9E. The last
+ * characters are spread evenly both for hash values and for numbered temporary filenames.
+ *
+ * @param directory directory the file is stored in.
+ * @param name filename of the file.
+ * @param create boolean to create the subdirectories if they don't exist.
+ * @return Path to the file.
+ */
+std::string getShardedPath(std::string directory, std::string name, bool create)
+{
+    if (name.size() < 4)
+    {
+        return directory + "/" + name;
+    }
+    std::string firstLevel = directory + "/" + name.substr(name.size() - 4, 2);
+    std::string secondLevel = firstLevel + "/" + name.substr(name.size() - 2);
+    if (create)
+    {
+        mkdir(firstLevel.c_str(), 0755);
+        mkdir(secondLevel.c_str(), 0755);
+    }
+    return secondLevel + "/" + name;
+}
+
+/**
+ * Writes all of the given data to a file descriptor.
+ *
+ * @param fd file descriptor to write to.
+ * @param data data to be written.
+ * @param size size of the data in bytes.
+ * @return Boolean indicating if all of the data was written.
+ */
+bool writeAll(int fd, const char *data, std::size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t bytesWritten = write(fd, data, size);
+        if (bytesWritten <= 0)
+        {
+            return false;
+        }
+        data += bytesWritten;
+        size -= bytesWritten;
+    }
+    return true;
+}
+
+/**
+ * Copies the start of a file to a new file without leaving the process. The data is shared
+ * with a reflink if the filesystem supports it, else copied inside the kernel with
+ * copy_file_range(), else read and written. Only the given length is copied unless the whole
+ * file is shared, so the copy may have to be truncated afterwards.
+ *
+ * @param sourcePath path to the file to be copied.
+ * @param destinationPath path to the copy, replaced if it exists.
+ * @param length number of bytes from the start of the file to be copied.
+ * @return 0 if successful or error value indicating the error.
+ */
+int copyFile(std::string sourcePath, std::string destinationPath, int64_t length)
+{
+    int source = open(sourcePath.c_str(), O_RDONLY);
+    if (source == -1)
+    {
+        return errno;
+    }
+    struct stat attributes;
+    int destination = -1;
+    if (fstat(source, &attributes) == -1 || (destination = open(destinationPath.c_str(),
+        O_WRONLY | O_CREAT | O_TRUNC, attributes.st_mode & 0777)) == -1)
+    {
+        int error = errno;
+        close(source);
+        return error;
+    }
+    int64_t remaining = std::min<int64_t>(std::max<int64_t>(length, 0), attributes.st_size);
+#ifdef FICLONE
+    if (remaining > 0 && ioctl(destination, FICLONE, source) == 0)
+    {
+        remaining = 0;
+    }
+#endif
+    while (remaining > 0) // advances the offsets of both files
+    {
+        ssize_t bytesCopied = copy_file_range(source, NULL, destination, NULL, remaining, 0);
+        if (bytesCopied <= 0) // unsupported eg. across filesystems, copy the rest below
+        {
+            break;
+        }
+        remaining -= bytesCopied;
+    }
+    int error = 0;
+    std::vector<char> buffer((remaining > 0) ? TFS_COPY_BUFFER_SIZE : 0);
+    while (remaining > 0)
+    {
+        ssize_t bytesRead = read(source, buffer.data(),
+            std::min<int64_t>(buffer.size(), remaining));
+        if (bytesRead <= 0 || writeAll(destination, buffer.data(), bytesRead) == false)
+        {
+            error = (bytesRead == 0) ? 0 : errno;
+            break;
+        }
+        remaining -= bytesRead;
+    }
+    close(source);
+    if (close(destination) == -1 && error == 0)
+    {
+        error = errno;
+    }
+    return error;
+}
+
 /**
  * Splits the given source string at first occurance of the given character.
  *
@@ -158,4 +280,76 @@ std::string popBackAndRemove(std::vector<std::string> &parts)
     return lastElement;
 }
 
+/**
+ * Serializes search options into a string of key=value pairs which contains no commas.
+ *
+ * @param options search options to be serialized.
+ * @return Serialized search options.
+ */
+std::string serializeSearchOptions(const SearchOptions &options)
+{
+    return "strict=" + std::to_string(options.strict)
+        + ";recursive=" + std::to_string(options.recursive)
+        + ";explain=" + std::to_string(options.explain)
+        + ";limit=" + std::to_string(options.limit)
+        + ";offset=" + std::to_string(options.offset)
+        + ";cursor=" + std::to_string(options.cursor)
+        + ";facets=" + std::to_string(options.facets)
+        + ";sort=" + std::to_string(options.sort) + ";";
+}
+
+/**
+ * Deserializes search options serialized by serializeSearchOptions(). Missing or unknown keys
+ * are ignored and missing options are turned off.
+ *
+ * @param serializedOptions serialized search options.
+ * @return Deserialized search options.
+ */
+SearchOptions deserializeSearchOptions(std::string serializedOptions)
+{
+    SearchOptions options = {false, false, false, 0, 0, 0, 0, SORT_NONE};
+    for (auto option : deserializeStrings(serializedOptions))
+    {
+        std::vector<std::string> keyValue = splitAtFirstOccurance(option, '=');
+        if (keyValue.size() != 2)
+        {
+            continue;
+        }
+        if (keyValue[0] == "strict")
+        {
+            options.strict = (keyValue[1] == "1");
+        }
+        else if (keyValue[0] == "recursive")
+        {
+            options.recursive = (keyValue[1] == "1");
+        }
+        else if (keyValue[0] == "explain")
+        {
+            options.explain = (keyValue[1] == "1");
+        }
+        else if (keyValue[0] == "limit")
+        {
+            options.limit = strtoull(keyValue[1].c_str(), NULL, 10);
+        }
+        else if (keyValue[0] == "offset")
+        {
+            options.offset = strtoull(keyValue[1].c_str(), NULL, 10);
+        }
+        else if (keyValue[0] == "cursor")
+        {
+            options.cursor = strtoull(keyValue[1].c_str(), NULL, 10);
+        }
+        else if (keyValue[0] == "facets")
+        {
+            options.facets = strtoull(keyValue[1].c_str(), NULL, 10);
+        }
+        else if (keyValue[0] == "sort")
+        {
+            int sort = atoi(keyValue[1].c_str());
+            options.sort = (sort >= SORT_NONE && sort <= SORT_NAME) ? SortOrder(sort) : SORT_NONE;
+        }
+    }
+    return options;
+}
+
 }
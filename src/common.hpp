@@ -15,6 +15,7 @@
 #include <mqueue.h>
 #include <limits.h>
 #include <algorithm>
+#include <cstdint>
 
 /** Maximum number of messages stored in message queue. */
 #define TFS_MQ_MAX_MESSAGES 10
@@ -36,15 +37,54 @@ struct Message
     char content[TFS_MQ_MESSAGE_SIZE - 16];
 };
 
+/**
+ * An enum listing the orders in which search results can be sent.
+ */
+enum SortOrder
+{
+    SORT_NONE, // by file ID
+    SORT_SIZE, // largest first
+    SORT_MTIME, // most recently modified first
+    SORT_NAME // by filename
+};
+
+/**
+ * A plain old data type storing the options of a search sent from QueryHandler to the daemon.
+ */
+struct SearchOptions
+{
+    /** Boolean to indicate if files must have all of the tags instead of any of them. */
+    bool strict;
+    /** Boolean to indicate if files tagged with descendants of the tags are included. */
+    bool recursive;
+    /** Boolean to indicate if the evaluation plan of a query is sent before the results. */
+    bool explain;
+    /** Maximum number of results to be sent, 0 if all results are sent. */
+    uint64_t limit;
+    /** Number of results to be skipped. */
+    uint64_t offset;
+    /** File ID of the last result of the previous page, results resume after it. */
+    uint64_t cursor;
+    /** Number of most common other tags of the results sent with their counts, 0 if none. */
+    uint64_t facets;
+    /** Order in which the results are sent. */
+    SortOrder sort;
+};
+
 void serializeMessage(const char *content, char (&data)[TFS_MQ_MESSAGE_SIZE], bool complete = true);
 Message deserializeMessage(char (&data)[TFS_MQ_MESSAGE_SIZE]);
 
 std::string serializeStrings(std::vector<std::string> &ids, char separator=';');
 std::vector<std::string> deserializeStrings(std::string serializedIDs, char separator=';');
 std::string getFilename(std::string path);
+std::string getShardedPath(std::string directory, std::string name, bool create = false);
+bool writeAll(int fd, const char *data, std::size_t size);
+int copyFile(std::string sourcePath, std::string destinationPath, int64_t length);
 std::vector<std::string> splitAtFirstOccurance(std::string source, char character=' ');
 std::vector<std::string> splitPathIntoParts(std::string path);
 std::string popBackAndRemove(std::vector<std::string> &parts);
+std::string serializeSearchOptions(const SearchOptions &options);
+SearchOptions deserializeSearchOptions(std::string serializedOptions);
 
 }
 